@@ -0,0 +1,425 @@
+// viamd_bench: Times the per-frame hot paths of VIAMD on synthetic solvated systems
+//
+// A system of N atoms is generated in memory (protein-like chains making up 10% of the atoms, the rest water on a grid)
+// and passed through the same molecule postprocessing as the application. A short trajectory is generated in memory as well.
+// Each stage of interpolate_atomic_properties, the atom colouring of update_representation and the masked histogram
+// is then timed at a number of thread counts. The stages call the same functions as the application (hot_paths, color_utils,
+// histogram) with the same task granularity, only the task setup around them is the bench's own.
+//
+// The results are written as JSON, suitable for tracking over time:
+//   viamd_bench [--sizes 10000,100000,1000000,5000000] [--threads 2,4,8] [--iterations 10] [--out results.json]
+
+#include <task_system.h>
+#include <color_utils.h>
+#include <histogram.h>
+#include <hot_paths.h>
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_arena_allocator.h>
+#include <core/md_array.h>
+#include <core/md_bitfield.h>
+#include <core/md_log.h>
+#include <core/md_os.h>
+#include <core/md_str.h>
+#include <core/md_vec_math.h>
+#include <md_molecule.h>
+#include <md_util.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#define MAX_LIST 16
+
+struct Options {
+    size_t sizes[MAX_LIST] = {10000, 100000, 1000000, 5000000};
+    size_t num_sizes = 4;
+    size_t threads[MAX_LIST] = {};
+    size_t num_threads = 0;
+    int iterations = 10;
+    const char* out_path = NULL;
+};
+
+struct Result {
+    std::string stage;
+    size_t atoms;
+    size_t threads;
+    double min_ms;
+    double median_ms;
+};
+
+static size_t parse_list(size_t* out, const char* str) {
+    size_t count = 0;
+    while (*str && count < MAX_LIST) {
+        char* end = NULL;
+        const long long value = strtoll(str, &end, 10);
+        if (end == str) break;
+        if (value > 0) out[count++] = (size_t)value;
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+static uint32_t xorshift(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (uint32_t)(x >> 32);
+}
+
+static float jitter(uint64_t* state, float amplitude) {
+    return ((float)xorshift(state) / (float)UINT32_MAX * 2.0f - 1.0f) * amplitude;
+}
+
+// Number of residues per protein chain
+static const size_t CHAIN_LENGTH = 64;
+
+// Builds a system of roughly num_atoms atoms: residues of 5 atoms (N, CA, C, O, CB) in chains of CHAIN_LENGTH making up 10% of the atoms,
+// followed by water in a chain of its own. Every residue and water occupies a cell of a cubic grid with the density of liquid water.
+// The fields are filled as the PDB loader fills them, everything else is derived by the same postprocessing as in the application.
+static void build_synthetic_molecule(md_molecule_t* mol, size_t num_atoms, md_allocator_i* alloc) {
+    const size_t num_residues = num_atoms / 10 / 5;
+    const size_t num_waters = (num_atoms - num_residues * 5) / 3;
+    const size_t num_cells = num_residues + num_waters;
+    const size_t num_protein_chains = DIV_UP(num_residues, CHAIN_LENGTH);
+    const size_t num_chains = num_protein_chains + (num_waters > 0 ? 1 : 0);
+    const size_t count = num_residues * 5 + num_waters * 3;
+    const float spacing = 3.1f;
+    size_t dim = 1;
+    while (dim * dim * dim < num_cells) ++dim;
+    const float box = dim * spacing;
+
+    struct AtomTemplate {
+        const char* name;
+        md_element_t element;
+        float x, y, z;
+    };
+    const AtomTemplate residue[5] = {
+        {"N",  7, -1.0f,  0.6f, 0.0f},
+        {"CA", 6,  0.0f,  0.0f, 0.0f},
+        {"C",  6,  1.0f,  0.6f, 0.0f},
+        {"O",  8,  1.2f,  1.8f, 0.0f},
+        {"CB", 6,  0.0f, -0.8f, 1.2f},
+    };
+    const AtomTemplate water[3] = {
+        {"O",  8,  0.0f,  0.0f, 0.0f},
+        {"H1", 1,  0.76f, 0.59f, 0.0f},
+        {"H2", 1, -0.76f, 0.59f, 0.0f},
+    };
+
+    *mol = {};
+    md_array_resize(mol->atom.x, count, alloc);
+    md_array_resize(mol->atom.y, count, alloc);
+    md_array_resize(mol->atom.z, count, alloc);
+    md_array_resize(mol->atom.element, count, alloc);
+    md_array_resize(mol->atom.type, count, alloc);
+    md_array_resize(mol->atom.flags, count, alloc);
+    md_array_resize(mol->atom.res_idx, count, alloc);
+    md_array_resize(mol->atom.chain_idx, count, alloc);
+    md_array_resize(mol->residue.name, num_cells, alloc);
+    md_array_resize(mol->residue.id, num_cells, alloc);
+    md_array_resize(mol->residue.atom_offset, num_cells + 1, alloc);
+    md_array_resize(mol->chain.id, num_chains, alloc);
+    md_array_resize(mol->chain.res_offset, num_chains + 1, alloc);
+    md_array_resize(mol->chain.atom_offset, num_chains + 1, alloc);
+
+    size_t atom = 0;
+    for (size_t cell = 0; cell < num_cells; ++cell) {
+        const float cx = (cell % dim) * spacing + spacing * 0.5f;
+        const float cy = ((cell / dim) % dim) * spacing + spacing * 0.5f;
+        const float cz = (cell / (dim * dim)) * spacing + spacing * 0.5f;
+        const bool is_residue = cell < num_residues;
+        const AtomTemplate* atoms = is_residue ? residue : water;
+        const size_t num_res_atoms = is_residue ? 5 : 3;
+        const size_t chain = is_residue ? cell / CHAIN_LENGTH : num_protein_chains;
+
+        if (is_residue ? (cell % CHAIN_LENGTH == 0) : (cell == num_residues)) {
+            const char chain_id = is_residue ? (char)('A' + chain % 26) : 'W';
+            mol->chain.id[chain] = make_label(str_t{&chain_id, 1});
+            mol->chain.res_offset[chain] = (uint32_t)cell;
+            mol->chain.atom_offset[chain] = (uint32_t)atom;
+        }
+
+        mol->residue.name[cell] = make_label(is_residue ? STR_LIT("ALA") : STR_LIT("HOH"));
+        mol->residue.id[cell] = (md_residue_id_t)((is_residue ? cell % CHAIN_LENGTH : cell - num_residues) + 1);
+        mol->residue.atom_offset[cell] = (uint32_t)atom;
+
+        for (size_t i = 0; i < num_res_atoms; ++i) {
+            mol->atom.x[atom] = cx + atoms[i].x;
+            mol->atom.y[atom] = cy + atoms[i].y;
+            mol->atom.z[atom] = cz + atoms[i].z;
+            mol->atom.element[atom] = atoms[i].element;
+            mol->atom.type[atom] = make_label(str_from_cstr(atoms[i].name));
+            mol->atom.flags[atom] = is_residue ? 0 : MD_FLAG_HETATM;
+            mol->atom.res_idx[atom] = (md_residue_idx_t)cell;
+            mol->atom.chain_idx[atom] = (md_chain_idx_t)chain;
+            atom += 1;
+        }
+    }
+    mol->residue.atom_offset[num_cells] = (uint32_t)atom;
+    mol->chain.res_offset[num_chains] = (uint32_t)num_cells;
+    mol->chain.atom_offset[num_chains] = (uint32_t)atom;
+
+    mol->atom.count = count;
+    mol->residue.count = num_cells;
+    mol->chain.count = num_chains;
+    mol->unit_cell = md_util_unit_cell_from_extent(box, box, box);
+
+    md_util_molecule_postprocess(mol, alloc, MD_UTIL_POSTPROCESS_ALL);
+}
+
+template <typename F>
+static Result time_stage(const char* stage, size_t atoms, size_t threads, int iterations, F&& func) {
+    std::vector<double> ms(iterations);
+    func();  // Warm up
+    for (int i = 0; i < iterations; ++i) {
+        const md_timestamp_t t0 = md_time_current();
+        func();
+        ms[i] = md_time_as_seconds(md_time_current() - t0) * 1000.0;
+    }
+    std::sort(ms.begin(), ms.end());
+    Result res = {stage, atoms, threads, ms[0], ms[iterations / 2]};
+    printf("  %-24s %8zu atoms %3zu threads: %10.3f ms (min %10.3f ms)\n", stage, atoms, threads, res.median_ms, res.min_ms);
+    return res;
+}
+
+static void run_range_task(const char* label, size_t count, task_system::RangeTask func, uint32_t grain_size = 1) {
+    task_system::ID id = task_system::create_pool_task(str_from_cstr(label), (uint32_t)count, func, grain_size);
+    task_system::enqueue_task(id);
+    task_system::task_wait_for(id);
+}
+
+static void run_task(const char* label, task_system::Task func) {
+    task_system::ID id = task_system::create_pool_task(str_from_cstr(label), func);
+    task_system::enqueue_task(id);
+    task_system::task_wait_for(id);
+}
+
+struct System {
+    md_molecule_t mol = {};
+    size_t stride = 0;
+    float* frames[4][3] = {};   // Synthetic trajectory, 4 frames of x, y, z
+    float* src[4][3] = {};      // Frames loaded for interpolation
+    float* values = NULL;       // Property values for the histogram, dim values per frame
+    size_t num_value_frames = 0;
+    md_bitfield_t frame_mask = {};
+    md_bitfield_t atom_mask[2] = {};
+};
+
+static const int HISTOGRAM_DIM = 8;
+
+static void create_system(System* sys, size_t num_atoms, md_allocator_i* alloc) {
+    const md_timestamp_t t0 = md_time_current();
+    build_synthetic_molecule(&sys->mol, num_atoms, alloc);
+    MD_LOG_INFO("System of %zu atoms, %zu residues, %zu chains, %zu bonds, %zu structures (generated in %.2f s)",
+        sys->mol.atom.count, sys->mol.residue.count, sys->mol.chain.count, sys->mol.bond.count, md_index_data_num_ranges(sys->mol.structure),
+        md_time_as_seconds(md_time_current() - t0));
+
+    const size_t count = sys->mol.atom.count;
+    sys->stride = ALIGN_TO(count, 16);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (int f = 0; f < 4; ++f) {
+        for (int c = 0; c < 3; ++c) {
+            const float* base = c == 0 ? sys->mol.atom.x : c == 1 ? sys->mol.atom.y : sys->mol.atom.z;
+            sys->frames[f][c] = (float*)md_alloc(alloc, sys->stride * sizeof(float));
+            sys->src[f][c] = (float*)md_alloc(alloc, sys->stride * sizeof(float));
+            for (size_t i = 0; i < count; ++i) {
+                sys->frames[f][c][i] = base[i] + jitter(&rng, 0.3f);
+            }
+        }
+    }
+
+    // One value per atom and dimension, so the histogram work grows with the system as well
+    sys->num_value_frames = MAX(count / HISTOGRAM_DIM, (size_t)1);
+    sys->values = (float*)md_alloc(alloc, sys->num_value_frames * HISTOGRAM_DIM * sizeof(float));
+    for (size_t i = 0; i < sys->num_value_frames * HISTOGRAM_DIM; ++i) {
+        sys->values[i] = jitter(&rng, 10.0f);
+    }
+    md_bitfield_init(&sys->frame_mask, alloc);
+    md_bitfield_set_range(&sys->frame_mask, 0, sys->num_value_frames / 2);
+
+    // Two overlapping atom selections, like a representation filter and the current selection
+    for (int i = 0; i < 2; ++i) {
+        md_bitfield_init(&sys->atom_mask[i], alloc);
+        for (size_t j = i; j < count; j += 2 + i) {
+            md_bitfield_set_bit(&sys->atom_mask[i], j);
+        }
+    }
+}
+
+static void run_stages(std::vector<Result>& results, System* sys, size_t threads, int iterations, bool measure_serial, md_allocator_i* temp_arena) {
+    md_molecule_t& mol = sys->mol;
+    const size_t count = mol.atom.count;
+    const uint32_t grain_size = hot_paths::ATOM_GRAIN_SIZE;
+    const md_unit_cell_t cell = mol.unit_cell;
+    const float* src_x[4] = {sys->src[0][0], sys->src[1][0], sys->src[2][0], sys->src[3][0]};
+    const float* src_y[4] = {sys->src[0][1], sys->src[1][1], sys->src[2][1], sys->src[3][1]};
+    const float* src_z[4] = {sys->src[0][2], sys->src[1][2], sys->src[2][2], sys->src[3][2]};
+
+    results.push_back(time_stage("load_frames", count, threads, iterations, [&]() {
+        run_range_task("## Load Frame", 4, [sys, count](uint32_t beg, uint32_t end, uint32_t) {
+            for (uint32_t f = beg; f < end; ++f) {
+                for (int c = 0; c < 3; ++c) {
+                    MEMCPY(sys->src[f][c], sys->frames[f][c], count * sizeof(float));
+                }
+            }
+        });
+    }));
+
+    results.push_back(time_stage("interpolate_linear", count, threads, iterations, [&]() {
+        run_range_task("## Interp Coord Data", count, [&](uint32_t beg, uint32_t end, uint32_t) {
+            hot_paths::interpolate_linear(mol.atom.x, mol.atom.y, mol.atom.z, src_x + 1, src_y + 1, src_z + 1, &cell, 0.5f, beg, end);
+        }, grain_size);
+    }));
+
+    results.push_back(time_stage("interpolate_cubic", count, threads, iterations, [&]() {
+        run_range_task("## Interp Coord Data", count, [&](uint32_t beg, uint32_t end, uint32_t) {
+            hot_paths::interpolate_cubic(mol.atom.x, mol.atom.y, mol.atom.z, src_x, src_y, src_z, &cell, 0.5f, 0.5f, beg, end);
+        }, grain_size);
+    }));
+
+    results.push_back(time_stage("apply_pbc", count, threads, iterations, [&]() {
+        run_range_task("## Apply PBC", count, [&](uint32_t beg, uint32_t end, uint32_t) {
+            hot_paths::apply_pbc(mol.atom.x, mol.atom.y, mol.atom.z, &cell, beg, end);
+        });
+    }));
+
+    const size_t num_structures = md_index_data_num_ranges(mol.structure);
+    if (num_structures > 0) {
+        results.push_back(time_stage("unwrap_structures", count, threads, iterations, [&]() {
+            run_range_task("## Unwrap Structures", num_structures, [&](uint32_t beg, uint32_t end, uint32_t) {
+                hot_paths::unwrap_structures(mol.atom.x, mol.atom.y, mol.atom.z, &mol.structure, &cell, beg, end);
+            });
+        }));
+    }
+
+    std::vector<vec3_t> aabb_min(task_system::pool_num_threads(), vec3_set1( FLT_MAX));
+    std::vector<vec3_t> aabb_max(task_system::pool_num_threads(), vec3_set1(-FLT_MAX));
+    results.push_back(time_stage("compute_aabb", count, threads, iterations, [&]() {
+        run_range_task("## Compute AABB", count, [&](uint32_t beg, uint32_t end, uint32_t thread_num) {
+            hot_paths::compute_aabb(&aabb_min[thread_num], &aabb_max[thread_num], mol.atom.x, mol.atom.y, mol.atom.z, mol.atom.radius, beg, end);
+        });
+    }));
+
+    // Bond recalculation runs as a single task in the application, so it is only measured for the first thread count
+    if (measure_serial) {
+        results.push_back(time_stage("recalc_bonds", count, threads, MIN(iterations, 3), [&]() {
+            md_arena_allocator_reset(temp_arena);
+            md_bond_data_t bonds = {};
+            run_task("## Recalc bond task", [&]() {
+                hot_paths::recalc_bonds(&bonds, mol.atom.x, mol.atom.y, mol.atom.z, mol.atom.element, count, &cell, temp_arena);
+            });
+        }));
+    }
+
+    // Colouring in update_representation runs on the main thread
+    uint32_t* colors = (uint32_t*)malloc(count * sizeof(uint32_t));
+    results.push_back(time_stage("color_cpk", count, threads, iterations, [&]() { color_atoms_cpk(colors, count, mol); }));
+    results.push_back(time_stage("color_res_name", count, threads, iterations, [&]() { color_atoms_res_name(colors, count, mol); }));
+    results.push_back(time_stage("color_chain_id", count, threads, iterations, [&]() { color_atoms_chain_id(colors, count, mol); }));
+    results.push_back(time_stage("color_sec_str", count, threads, iterations, [&]() { color_atoms_sec_str(colors, count, mol); }));
+    results.push_back(time_stage("scale_saturation", count, threads, iterations, [&]() { scale_saturation(colors, count, 0.5f); }));
+    results.push_back(time_stage("filter_colors", count, threads, iterations, [&]() { filter_colors(colors, count, &sys->atom_mask[0]); }));
+    free(colors);
+
+    results.push_back(time_stage("bitfield_and_popcount", count, threads, iterations, [&]() {
+        md_arena_allocator_reset(temp_arena);
+        md_bitfield_t tmp = {};
+        md_bitfield_init(&tmp, temp_arena);
+        md_bitfield_and(&tmp, &sys->atom_mask[0], &sys->atom_mask[1]);
+        volatile size_t pop = md_bitfield_popcount(&tmp);
+        (void)pop;
+    }));
+
+    std::vector<float> bins(HISTOGRAM_DIM * 128);
+    results.push_back(time_stage("histogram_masked", count, threads, iterations, [&]() {
+        md_arena_allocator_reset(temp_arena);
+        histogram_compute_masked(bins.data(), 128, -10.0f, 10.0f, sys->values, HISTOGRAM_DIM, &sys->frame_mask, false, NULL, NULL, temp_arena);
+    }));
+}
+
+static bool write_json(const char* path, const std::vector<Result>& results, const Options& opt) {
+    FILE* file = path ? fopen(path, "w") : stdout;
+    if (!file) {
+        MD_LOG_ERROR("Failed to open '%s' for writing", path);
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version\": 1,\n");
+    fprintf(file, "  \"physical_cores\": %zu,\n", task_system::num_physical_cores());
+    fprintf(file, "  \"logical_processors\": %zu,\n", task_system::num_logical_processors());
+    fprintf(file, "  \"iterations\": %d,\n", opt.iterations);
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(file, "    {\"stage\": \"%s\", \"atoms\": %zu, \"threads\": %zu, \"median_ms\": %.4f, \"min_ms\": %.4f}%s\n",
+            r.stage.c_str(), r.atoms, r.threads, r.median_ms, r.min_ms, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+    if (path) fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--sizes") && has_value) {
+            opt.num_sizes = parse_list(opt.sizes, argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            opt.num_threads = parse_list(opt.threads, argv[++i]);
+        } else if (!strcmp(argv[i], "--iterations") && has_value) {
+            opt.iterations = MAX(atoi(argv[++i]), 1);
+        } else if (!strcmp(argv[i], "--out") && has_value) {
+            opt.out_path = argv[++i];
+        } else {
+            printf("usage: viamd_bench [--sizes N,N,...] [--threads N,N,...] [--iterations N] [--out results.json]\n");
+            return 1;
+        }
+    }
+
+    // Default to doubling thread counts up to the number of logical processors
+    if (opt.num_threads == 0) {
+        const size_t max_threads = MAX(task_system::num_logical_processors(), (size_t)2);
+        for (size_t t = 2; opt.num_threads < MAX_LIST; t *= 2) {
+            opt.threads[opt.num_threads++] = MIN(t, max_threads);
+            if (t >= max_threads) break;
+        }
+    }
+
+    task_system::initialize(opt.threads[0]);
+
+    std::vector<Result> results;
+    bool success = true;
+    for (size_t s = 0; s < opt.num_sizes && success; ++s) {
+        md_allocator_i* alloc = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(64));
+        md_allocator_i* temp_arena = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(16));
+        System sys;
+        create_system(&sys, opt.sizes[s], alloc);
+        for (size_t t = 0; t < opt.num_threads; ++t) {
+            // Results recorded under the wrong thread count would be silently misleading, so the run is aborted instead
+            if (!task_system::reinitialize(opt.threads[t]) || task_system::pool_num_threads() != opt.threads[t]) {
+                MD_LOG_ERROR("Failed to run with %zu threads (the pool has %zu)", opt.threads[t], task_system::pool_num_threads());
+                success = false;
+                break;
+            }
+            run_stages(results, &sys, task_system::pool_num_threads(), opt.iterations, t == 0, temp_arena);
+        }
+        md_arena_allocator_destroy(temp_arena);
+        md_arena_allocator_destroy(alloc);
+    }
+
+    task_system::shutdown();
+    if (!success) {
+        return 1;
+    }
+    return write_json(opt.out_path, results, opt) ? 0 : 1;
+}
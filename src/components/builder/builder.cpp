@@ -6,8 +6,10 @@
 #ifdef VIAMD_ENABLE_RDKIT
 #include <GraphMol/GraphMol.h>
 #include <GraphMol/SmilesParse/SmilesParse.h>
+#include <GraphMol/SmilesParse/SmilesWrite.h>
 #include <GraphMol/DistGeomHelpers/Embedder.h>
 #include <GraphMol/ForceFieldHelpers/UFF/UFF.h>
+#include <GraphMol/ForceFieldHelpers/MMFF/MMFF.h>
 #include <GraphMol/MolOps.h>
 #include <GraphMol/AtomIterators.h>
 #include <GraphMol/BondIterators.h>
@@ -24,6 +26,8 @@
 #include <core/md_vec_math.h>
 #include <core/md_array.h>
 #include <core/md_bitfield.h>
+#include <core/md_str.h>
+#include <core/md_os.h>
 #include <md_molecule.h>
 #include <md_util.h>
 #include <md_gl.h>
@@ -31,6 +35,8 @@
 #include <imgui_widgets.h>
 #include <imgui.h>
 #include <loader.h>
+#include <task_system.h>
+#include <memory_budget.h>
 
 #ifdef VIAMD_ENABLE_OPENMM
 #include "../openmm/openmm_interface.h"
@@ -41,10 +47,110 @@
 #include <vector>
 #include <cstring>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <cmath>
+#include <algorithm>
 
 namespace builder {
 
+#ifdef VIAMD_ENABLE_RDKIT
+// Parameters which determine the embedded geometry, these are part of the cache key
+enum EmbedForceField : int {
+    EmbedForceField_UFF = 0,
+    EmbedForceField_MMFF94,     // Falls back to UFF for molecules MMFF94 cannot fully parameterize
+};
+
+struct EmbedParams {
+    int  random_seed = 42;
+    bool optimize = true;
+    int  force_field = EmbedForceField_UFF;
+    int  max_iters = 1000;
+    int  num_conformers = 1;
+    int  num_threads = 1;       // RDKit threads per molecule, set when a build is launched and not part of the cache key
+};
+
+// Embedded molecule, immutable once built so that it can be shared through the cache
+struct EmbeddedMolecule {
+    std::unique_ptr<RDKit::ROMol> mol;  // With explicit hydrogens and one or more 3D conformers
+    std::vector<int> conf_ids;          // Conformer ids in order of increasing energy (when optimized)
+    std::vector<double> energies;       // Force field energy per entry in conf_ids (kcal/mol), empty if not optimized
+};
+
+// Outcome of embedding a single SMILES on the task pool
+struct BuildResult {
+    std::shared_ptr<const EmbeddedMolecule> embedded;
+    std::string name;
+    std::string error;
+};
+#endif
+
+// Conformer ensemble of the built molecule, exposed to VIAMD as a trajectory with one frame per conformer.
+// Frame times are the conformer indices.
+struct ConformerEnsemble {
+    std::vector<float> x;   // [num_frames * atom_count]
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<double> frame_times;
+    std::vector<double> energies;
+    size_t atom_count = 0;
+    size_t num_frames = 0;
+
+    md_trajectory_i view = {};
+    bool attached = false;
+};
+
+static bool ensemble_traj_get_header(struct md_trajectory_o* inst, md_trajectory_header_t* header) {
+    const ConformerEnsemble* ens = (const ConformerEnsemble*)inst;
+    ASSERT(ens);
+    if (header) {
+        MEMSET(header, 0, sizeof(md_trajectory_header_t));
+        header->num_frames  = ens->num_frames;
+        header->num_atoms   = ens->atom_count;
+        header->frame_times = ens->frame_times.data();
+        return true;
+    }
+    return false;
+}
+
+static bool ensemble_traj_load_frame(struct md_trajectory_o* inst, int64_t idx, md_trajectory_frame_header_t* header, float* x, float* y, float* z) {
+    const ConformerEnsemble* ens = (const ConformerEnsemble*)inst;
+    ASSERT(ens);
+    if (idx < 0 || (size_t)idx >= ens->num_frames) {
+        MD_LOG_ERROR("Conformer ensemble: frame index out of range");
+        return false;
+    }
+
+    if (header) {
+        MEMSET(header, 0, sizeof(md_trajectory_frame_header_t));
+        header->num_atoms = ens->atom_count;
+        header->index     = idx;
+        header->timestamp = ens->frame_times[idx];
+    }
+
+    const size_t offset = idx * ens->atom_count;
+    const size_t bytes  = ens->atom_count * sizeof(float);
+    if (x) MEMCPY(x, ens->x.data() + offset, bytes);
+    if (y) MEMCPY(y, ens->y.data() + offset, bytes);
+    if (z) MEMCPY(z, ens->z.data() + offset, bytes);
+
+    return true;
+}
+
+// Called by the loader when VIAMD closes the trajectory, the ensemble itself is owned by the builder
+static void ensemble_traj_destroy(md_trajectory_i* traj) {
+    ConformerEnsemble* ens = (ConformerEnsemble*)traj->inst;
+    if (ens) {
+        ens->attached = false;
+    }
+}
+
+static md_trajectory_loader_i* ensemble_traj_loader() {
+    static md_trajectory_loader_i loader = {};
+    loader.destroy = ensemble_traj_destroy;
+    return &loader;
+}
+
 struct MoleculeBuilder : viamd::EventHandler {
     bool show_window = false;
     bool rdkit_available = false;
@@ -65,8 +171,43 @@ struct MoleculeBuilder : viamd::EventHandler {
         std::string formula;
     } built_molecule;
 
+    // Ensemble of the built molecule (empty for a single conformer) and the one currently attached to VIAMD
+    ConformerEnsemble built_ensemble;
+    ConformerEnsemble loaded_ensemble;
+
+#ifdef VIAMD_ENABLE_RDKIT
+    EmbedParams embed_params;
+
+    // Embedded molecules keyed by canonical SMILES and embedding parameters, shared between builds
+    struct {
+        std::unordered_map<std::string, std::shared_ptr<const EmbeddedMolecule>> entries;
+        std::mutex mutex;
+        size_t hits = 0;
+        size_t misses = 0;
+    } cache;
+
+    // Build in flight on the task pool, results are picked up by the UI thread once the task has completed
+    struct {
+        task_system::ID task = task_system::INVALID_ID;
+        std::vector<std::string> smiles;
+        std::vector<std::string> names;
+        std::vector<BuildResult> results;   // One per input, written by the task
+        EmbedParams params;
+        bool batch = false;
+        md_timestamp_t start = 0;
+    } pending;
+
+    char batch_path[1024] = "";
+    float batch_spacing = 3.0f;    // Ångström between the bounding spheres of neighbouring molecules
+#endif
+
     MoleculeBuilder() { 
-        viamd::event_system_register_handler(*this);
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdWindowDrawMenu,
+        }, "Builder");
         
 #ifdef VIAMD_ENABLE_RDKIT
         rdkit_available = true;
@@ -84,17 +225,25 @@ struct MoleculeBuilder : viamd::EventHandler {
             switch (e.type) {
             case viamd::EventType_ViamdInitialize: {
                 app_state = (ApplicationState*)e.payload;
-                arena = md_arena_allocator_create(app_state->allocator.persistent, MEGABYTES(1));
+                arena = md_arena_allocator_create(memory_budget::create_allocator("Builder", app_state->allocator.persistent), MEGABYTES(1));
                 MD_LOG_INFO("Molecule Builder component initialized");
                 break;
             }
             case viamd::EventType_ViamdShutdown:
+#ifdef VIAMD_ENABLE_RDKIT
+                task_system::task_wait_for(pending.task);
+#endif
                 if (arena) {
                     cleanup_built_molecule();
                     md_arena_allocator_destroy(arena);
                 }
                 break;
             case viamd::EventType_ViamdFrameTick:
+#ifdef VIAMD_ENABLE_RDKIT
+                if (pending.task != task_system::INVALID_ID && !task_system::task_is_running(pending.task)) {
+                    finish_pending_build();
+                }
+#endif
                 draw_window();
                 break;
             case viamd::EventType_ViamdWindowDrawMenu: {
@@ -165,51 +314,263 @@ struct MoleculeBuilder : viamd::EventHandler {
     }
 
 #ifdef VIAMD_ENABLE_RDKIT
-    bool build_molecule_from_smiles(const char* smiles) {
-        if (!smiles || strlen(smiles) == 0) {
-            strcpy(error_message, "Please enter a SMILES string");
-            return false;
-        }
+    static std::string cache_key(const std::string& canonical_smiles, const EmbedParams& params) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "|%d|%d|%d|%d|%d", params.random_seed, params.optimize ? 1 : 0, params.force_field, params.max_iters, params.num_conformers);
+        return canonical_smiles + buf;
+    }
 
+    // Parses, embeds and optimizes a single SMILES. Safe to call from any thread, RDKit operates on separate molecules.
+    // Multiple conformers are embedded and optimized with params.num_threads RDKit threads, which run next to the task pool.
+    BuildResult embed_smiles(const std::string& smiles, const EmbedParams& params) {
+        BuildResult res;
         try {
             // Parse SMILES
             std::unique_ptr<RDKit::RWMol> mol(RDKit::SmilesToMol(smiles));
             if (!mol) {
-                snprintf(error_message, sizeof(error_message), "Invalid SMILES: %s", smiles);
-                return false;
+                res.error = "Invalid SMILES: " + smiles;
+                return res;
+            }
+
+            const std::string key = cache_key(RDKit::MolToSmiles(*mol), params);
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                auto it = cache.entries.find(key);
+                if (it != cache.entries.end()) {
+                    cache.hits += 1;
+                    res.embedded = it->second;
+                    return res;
+                }
+                cache.misses += 1;
             }
 
             // Add hydrogens
             RDKit::MolOps::addHs(*mol);
+
+            auto embedded = std::make_shared<EmbeddedMolecule>();
             
             // Generate 3D coordinates
-            auto confId = RDKit::DGeomHelpers::EmbedMolecule(*mol);
-            if (confId == -1) {
-                strcpy(error_message, "Failed to generate 3D coordinates");
-                return false;
+            if (params.num_conformers > 1) {
+                RDKit::DGeomHelpers::EmbedParameters ep(RDKit::DGeomHelpers::ETKDGv3);
+                ep.randomSeed = params.random_seed;
+                ep.numThreads = params.num_threads;
+                embedded->conf_ids = RDKit::DGeomHelpers::EmbedMultipleConfs(*mol, (unsigned int)params.num_conformers, ep);
+            } else {
+                auto confId = RDKit::DGeomHelpers::EmbedMolecule(*mol, 0, params.random_seed);
+                if (confId != -1) embedded->conf_ids.push_back(confId);
             }
-
-            // Optimize geometry with UFF
-            try {
-                RDKit::UFF::UFFOptimizeMolecule(*mol);
-            } catch (...) {
-                // UFF optimization failed, but we can still use the molecule
-                MD_LOG_DEBUG("UFF optimization failed, using unoptimized geometry");
+            if (embedded->conf_ids.empty()) {
+                res.error = "Failed to generate 3D coordinates for " + smiles;
+                return res;
             }
 
-            // Convert RDKit molecule to VIAMD format
-            return convert_rdkit_to_viamd(*mol);
+            // Optimize geometry with the selected force field, MMFF94 falls back to UFF when the molecule is not fully parameterized
+            if (params.optimize) {
+                try {
+                    std::vector<std::pair<int, double>> opt;
+                    if (params.force_field == EmbedForceField_MMFF94 && RDKit::MMFF::MMFFHasAllMoleculeParams(*mol)) {
+                        RDKit::MMFF::MMFFOptimizeMoleculeConfs(*mol, opt, params.num_threads, params.max_iters);
+                    } else {
+                        if (params.force_field == EmbedForceField_MMFF94) {
+                            MD_LOG_DEBUG("MMFF94 parameters missing for %s, optimizing with UFF", smiles.c_str());
+                        }
+                        RDKit::UFF::UFFOptimizeMoleculeConfs(*mol, opt, params.num_threads, params.max_iters);
+                    }
+
+                    // opt follows the conformer order of the molecule, reorder by increasing energy
+                    std::vector<std::pair<double, int>> order;
+                    size_t k = 0;
+                    for (auto it = mol->beginConformers(); it != mol->endConformers() && k < opt.size(); ++it, ++k) {
+                        order.emplace_back(opt[k].second, (int)(*it)->getId());
+                    }
+                    std::sort(order.begin(), order.end());
+                    embedded->conf_ids.clear();
+                    for (const auto& o : order) {
+                        embedded->energies.push_back(o.first);
+                        embedded->conf_ids.push_back(o.second);
+                    }
+                } catch (...) {
+                    // Optimization failed, but we can still use the molecule
+                    MD_LOG_DEBUG("Force field optimization failed, using unoptimized geometry");
+                    embedded->energies.clear();
+                }
+            }
 
+            embedded->mol.reset(mol.release());
+            res.embedded = embedded;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.entries.emplace(key, res.embedded);
         } catch (const std::exception& e) {
-            snprintf(error_message, sizeof(error_message), "RDKit error: %s", e.what());
-            return false;
+            res.error = std::string("RDKit error: ") + e.what();
         } catch (...) {
-            strcpy(error_message, "Unknown error in RDKit processing");
+            res.error = "Unknown error in RDKit processing";
+        }
+        return res;
+    }
+
+    bool build_pending() const {
+        return pending.task != task_system::INVALID_ID;
+    }
+
+    // Embeds the SMILES strings on the task pool, the result is converted once the task has completed
+    void launch_build(std::vector<std::string> smiles, std::vector<std::string> names, bool batch) {
+        if (build_pending()) return;
+
+        pending.smiles = std::move(smiles);
+        pending.names  = std::move(names);
+        pending.results.clear();
+        pending.results.resize(pending.smiles.size());
+        pending.params = embed_params;
+        // RDKit spawns its own threads inside the pool task. A single molecule may use as many as the pool has workers,
+        // a batch already keeps the pool busy with one molecule per task so each molecule runs single threaded.
+        pending.params.num_threads = 1;
+        if (batch) {
+            // Batches are laid out as a single system, only the lowest energy conformer is used
+            pending.params.num_conformers = 1;
+        } else if (pending.smiles.size() == 1) {
+            pending.params.num_threads = (int)MAX((size_t)1, task_system::pool_num_threads());
+        }
+        pending.batch = batch;
+        pending.start = md_time_current();
+
+        pending.task = task_system::create_pool_task(STR_LIT("Build Molecules"), (uint32_t)pending.smiles.size(), [this](uint32_t beg, uint32_t end, uint32_t) {
+            for (uint32_t i = beg; i < end; ++i) {
+                pending.results[i] = embed_smiles(pending.smiles[i], pending.params);
+                if (i < pending.names.size()) {
+                    pending.results[i].name = pending.names[i];
+                }
+            }
+        });
+        task_system::enqueue_task(pending.task);
+        error_message[0] = '\0';
+        snprintf(info_message, sizeof(info_message), "Building %zu molecule(s)...", pending.smiles.size());
+    }
+
+    bool build_molecule_from_smiles(const char* smiles) {
+        if (!smiles || strlen(smiles) == 0) {
+            strcpy(error_message, "Please enter a SMILES string");
             return false;
         }
+        launch_build({smiles}, {}, false);
+        return true;
     }
 
-    bool convert_rdkit_to_viamd(const RDKit::RWMol& rdkit_mol) {
+    // Reads a SMILES file (one 'SMILES [name]' per line, '#' starts a comment) and builds all entries in parallel
+    bool build_batch_from_file(const char* path) {
+        str_t txt = load_textfile(str_from_cstr(path), app_state->allocator.frame);
+        if (str_empty(txt)) {
+            snprintf(error_message, sizeof(error_message), "Failed to read SMILES file: %s", path);
+            return false;
+        }
+
+        std::vector<std::string> smiles;
+        std::vector<std::string> names;
+        str_t line;
+        while (str_extract_line(&line, &txt)) {
+            line = str_trim(line);
+            if (str_empty(line) || line.ptr[0] == '#') continue;
+            size_t len = 0;
+            while (len < line.len && line.ptr[len] != ' ' && line.ptr[len] != '\t') ++len;
+            smiles.emplace_back(line.ptr, len);
+            str_t name = str_trim(str_substr(line, len, SIZE_MAX));
+            names.emplace_back(name.ptr ? name.ptr : "", name.len);
+        }
+
+        if (smiles.empty()) {
+            snprintf(error_message, sizeof(error_message), "No SMILES entries found in %s", path);
+            return false;
+        }
+        launch_build(std::move(smiles), std::move(names), true);
+        return true;
+    }
+
+    void finish_pending_build() {
+        const double elapsed = md_time_as_seconds(md_time_current() - pending.start);
+        pending.task = task_system::INVALID_ID;
+
+        std::vector<const RDKit::ROMol*> mols;
+        std::vector<int> conf_ids;
+        size_t num_failed = 0;
+        for (const auto& res : pending.results) {
+            if (res.embedded) {
+                mols.push_back(res.embedded->mol.get());
+                conf_ids.push_back(res.embedded->conf_ids[0]);
+            } else {
+                num_failed += 1;
+                MD_LOG_ERROR("Molecule builder: %s", res.error.c_str());
+            }
+        }
+
+        if (mols.empty()) {
+            snprintf(error_message, sizeof(error_message), "%s", pending.results.empty() ? "Nothing to build" : pending.results[0].error.c_str());
+            info_message[0] = '\0';
+        } else if (!pending.batch) {
+            convert_rdkit_to_viamd(*pending.results[0].embedded);
+        } else {
+            convert_rdkit_to_viamd(mols.data(), conf_ids.data(), mols.size(), batch_spacing);
+            if (num_failed > 0) {
+                snprintf(error_message, sizeof(error_message), "%zu of %zu SMILES failed to build, see log", num_failed, pending.results.size());
+            }
+        }
+        MD_LOG_INFO("Molecule builder: built %zu molecule(s) in %.3f s (cache: %zu hits, %zu misses)", mols.size(), elapsed, cache.hits, cache.misses);
+
+        // The cache keeps the molecules alive, the per-build results can be dropped
+        pending.results.clear();
+        pending.smiles.clear();
+        pending.names.clear();
+    }
+
+    void clear_cache() {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.entries.clear();
+        cache.hits = 0;
+        cache.misses = 0;
+    }
+
+    // The topology takes the lowest energy conformer, all conformers are stored in the ensemble
+    bool convert_rdkit_to_viamd(const EmbeddedMolecule& embedded) {
+        const RDKit::ROMol& rdkit_mol = *embedded.mol;
+        const RDKit::ROMol* mols[] = {&rdkit_mol};
+        if (!convert_rdkit_to_viamd(mols, embedded.conf_ids.data(), 1, 0.0f)) {
+            return false;
+        }
+        built_molecule.formula = RDKit::Descriptors::calcMolFormula(rdkit_mol);
+
+        if (embedded.conf_ids.size() > 1) {
+            const size_t atom_count = rdkit_mol.getNumAtoms();
+            const size_t num_frames = embedded.conf_ids.size();
+            built_ensemble.atom_count = atom_count;
+            built_ensemble.num_frames = num_frames;
+            built_ensemble.x.resize(num_frames * atom_count);
+            built_ensemble.y.resize(num_frames * atom_count);
+            built_ensemble.z.resize(num_frames * atom_count);
+            built_ensemble.frame_times.resize(num_frames);
+            built_ensemble.energies = embedded.energies;
+            for (size_t f = 0; f < num_frames; ++f) {
+                const auto& conf = rdkit_mol.getConformer(embedded.conf_ids[f]);
+                for (size_t i = 0; i < atom_count; ++i) {
+                    const auto& pos = conf.getAtomPos((unsigned int)i);
+                    // Same scale as the topology coordinates
+                    built_ensemble.x[f * atom_count + i] = (float)(pos.x * 0.1);
+                    built_ensemble.y[f * atom_count + i] = (float)(pos.y * 0.1);
+                    built_ensemble.z[f * atom_count + i] = (float)(pos.z * 0.1);
+                }
+                built_ensemble.frame_times[f] = (double)f;
+            }
+            snprintf(info_message, sizeof(info_message), 
+                     "Built molecule: %s (%d atoms, %d bonds, %zu conformers)", 
+                     built_molecule.formula.c_str(), built_molecule.num_atoms, built_molecule.num_bonds, num_frames);
+        } else {
+            snprintf(info_message, sizeof(info_message), 
+                     "Built molecule: %s (%d atoms, %d bonds)", 
+                     built_molecule.formula.c_str(), built_molecule.num_atoms, built_molecule.num_bonds);
+        }
+        return true;
+    }
+
+    // Converts one or more molecules into a single system. Multiple molecules are laid out on a cubic grid,
+    // with cells sized by the largest bounding sphere plus 'spacing' (Ångström).
+    bool convert_rdkit_to_viamd(const RDKit::ROMol* const* mols, const int* conf_ids, size_t num_mols, float spacing) {
         cleanup_built_molecule();
 
         if (!app_state || !app_state->mold.mol_alloc) {
@@ -219,10 +580,26 @@ struct MoleculeBuilder : viamd::EventHandler {
 
         // Initialize VIAMD molecule structure - zero initialize
         built_molecule.mol = {};
-
-        const auto& conf = rdkit_mol.getConformer();
-        unsigned int num_atoms = rdkit_mol.getNumAtoms();
-        unsigned int num_bonds = rdkit_mol.getNumBonds();
+        built_ensemble = {};
+
+        // Per molecule centroid and bounding radius, to place them on the grid
+        std::vector<RDGeom::Point3D> centers(num_mols);
+        double max_radius = 0.0;
+        unsigned int num_atoms = 0;
+        unsigned int num_bonds = 0;
+        for (size_t m = 0; m < num_mols; ++m) {
+            const auto& conf = mols[m]->getConformer(conf_ids[m]);
+            const unsigned int n = mols[m]->getNumAtoms();
+            RDGeom::Point3D c(0, 0, 0);
+            for (unsigned int i = 0; i < n; ++i) c += conf.getAtomPos(i);
+            if (n > 0) c /= (double)n;
+            for (unsigned int i = 0; i < n; ++i) max_radius = std::max(max_radius, (conf.getAtomPos(i) - c).length());
+            centers[m] = c;
+            num_atoms += n;
+            num_bonds += mols[m]->getNumBonds();
+        }
+        const int grid_dim = (int)std::ceil(std::cbrt((double)num_mols));
+        const double cell = 2.0 * max_radius + spacing;
 
         // Use the same allocator that will manage the molecule in VIAMD
         md_allocator_i* mol_alloc = app_state->mold.mol_alloc;
@@ -236,45 +613,60 @@ struct MoleculeBuilder : viamd::EventHandler {
         md_array_resize(built_molecule.mol.atom.radius, num_atoms, mol_alloc);
         md_array_resize(built_molecule.mol.atom.mass, num_atoms, mol_alloc);
         md_array_resize(built_molecule.mol.atom.flags, num_atoms, mol_alloc);
-
-        // Convert atoms
-        for (unsigned int i = 0; i < num_atoms; ++i) {
-            const auto* atom = rdkit_mol.getAtomWithIdx(i);
-            const auto& pos = conf.getAtomPos(i);
-
-            // Position (convert from Angstrom to nanometers)
-            built_molecule.mol.atom.x[i] = (float)(pos.x * 0.1);
-            built_molecule.mol.atom.y[i] = (float)(pos.y * 0.1);
-            built_molecule.mol.atom.z[i] = (float)(pos.z * 0.1);
-
-            // Element
-            built_molecule.mol.atom.element[i] = (uint8_t)atom->getAtomicNum();
-
-            // Atom type (use element symbol)
-            str_t element_name = md_util_element_symbol(atom->getAtomicNum());
-            // Convert str_t to md_label_t by copying the string data
-            size_t copy_len = MIN(element_name.len, sizeof(built_molecule.mol.atom.type[i].buf) - 1);
-            memcpy(built_molecule.mol.atom.type[i].buf, element_name.ptr, copy_len);
-            built_molecule.mol.atom.type[i].buf[copy_len] = '\0';
-
-            // Properties
-            built_molecule.mol.atom.radius[i] = md_util_element_vdw_radius(atom->getAtomicNum());
-            built_molecule.mol.atom.mass[i] = (float)md_util_element_atomic_mass(atom->getAtomicNum());
-            built_molecule.mol.atom.flags[i] = 0;
-        }
-
-        built_molecule.mol.atom.count = num_atoms;
-
-        // Convert bonds
         if (num_bonds > 0) {
             md_array_resize(built_molecule.mol.bond.pairs, num_bonds, mol_alloc);
             md_array_resize(built_molecule.mol.bond.order, num_bonds, mol_alloc);
+        }
+
+        unsigned int atom_offset = 0;
+        unsigned int bond_offset = 0;
+        for (size_t m = 0; m < num_mols; ++m) {
+            const RDKit::ROMol& rdkit_mol = *mols[m];
+            const auto& conf = rdkit_mol.getConformer(conf_ids[m]);
+
+            // Single molecules keep their coordinates, batches are centered in their grid cell
+            RDGeom::Point3D shift(0, 0, 0);
+            if (num_mols > 1) {
+                const int gx = (int)(m % grid_dim);
+                const int gy = (int)((m / grid_dim) % grid_dim);
+                const int gz = (int)(m / ((size_t)grid_dim * grid_dim));
+                shift = RDGeom::Point3D(gx * cell, gy * cell, gz * cell) - centers[m];
+            }
+
+            // Convert atoms
+            for (unsigned int j = 0; j < rdkit_mol.getNumAtoms(); ++j) {
+                const unsigned int i = atom_offset + j;
+                const auto* atom = rdkit_mol.getAtomWithIdx(j);
+                const auto pos = conf.getAtomPos(j) + shift;
+
+                // Position (convert from Angstrom to nanometers)
+                built_molecule.mol.atom.x[i] = (float)(pos.x * 0.1);
+                built_molecule.mol.atom.y[i] = (float)(pos.y * 0.1);
+                built_molecule.mol.atom.z[i] = (float)(pos.z * 0.1);
+
+                // Element
+                built_molecule.mol.atom.element[i] = (uint8_t)atom->getAtomicNum();
+
+                // Atom type (use element symbol)
+                str_t element_name = md_util_element_symbol(atom->getAtomicNum());
+                // Convert str_t to md_label_t by copying the string data
+                size_t copy_len = MIN(element_name.len, sizeof(built_molecule.mol.atom.type[i].buf) - 1);
+                memcpy(built_molecule.mol.atom.type[i].buf, element_name.ptr, copy_len);
+                built_molecule.mol.atom.type[i].buf[copy_len] = '\0';
+
+                // Properties
+                built_molecule.mol.atom.radius[i] = md_util_element_vdw_radius(atom->getAtomicNum());
+                built_molecule.mol.atom.mass[i] = (float)md_util_element_atomic_mass(atom->getAtomicNum());
+                built_molecule.mol.atom.flags[i] = 0;
+            }
 
-            for (unsigned int i = 0; i < num_bonds; ++i) {
-                const auto* bond = rdkit_mol.getBondWithIdx(i);
+            // Convert bonds
+            for (unsigned int j = 0; j < rdkit_mol.getNumBonds(); ++j) {
+                const unsigned int i = bond_offset + j;
+                const auto* bond = rdkit_mol.getBondWithIdx(j);
                 
-                built_molecule.mol.bond.pairs[i].idx[0] = bond->getBeginAtomIdx();
-                built_molecule.mol.bond.pairs[i].idx[1] = bond->getEndAtomIdx();
+                built_molecule.mol.bond.pairs[i].idx[0] = atom_offset + bond->getBeginAtomIdx();
+                built_molecule.mol.bond.pairs[i].idx[1] = atom_offset + bond->getEndAtomIdx();
                 
                 // Convert bond order
                 switch (bond->getBondType()) {
@@ -295,18 +687,25 @@ struct MoleculeBuilder : viamd::EventHandler {
                     break;
                 }
             }
-            built_molecule.mol.bond.count = num_bonds;
+
+            atom_offset += rdkit_mol.getNumAtoms();
+            bond_offset += rdkit_mol.getNumBonds();
         }
 
+        built_molecule.mol.atom.count = num_atoms;
+        built_molecule.mol.bond.count = num_bonds;
+
         // Set molecule info
         built_molecule.num_atoms = num_atoms;
         built_molecule.num_bonds = num_bonds;
-        built_molecule.formula = RDKit::Descriptors::calcMolFormula(rdkit_mol);
         built_molecule.valid = true;
 
+        char formula[64];
+        snprintf(formula, sizeof(formula), "%zu molecules", num_mols);
+        built_molecule.formula = formula;
         snprintf(info_message, sizeof(info_message), 
-                 "Built molecule: %s (%d atoms, %d bonds)", 
-                 built_molecule.formula.c_str(), num_atoms, num_bonds);
+                 "Built %zu molecules on a %d^3 grid (%d atoms, %d bonds)", 
+                 num_mols, grid_dim, num_atoms, num_bonds);
 
         error_message[0] = '\0';  // Clear any previous errors
         return true;
@@ -360,6 +759,10 @@ struct MoleculeBuilder : viamd::EventHandler {
             app_state->mold.traj = nullptr;
         }
 
+        // The previous ensemble is no longer referenced once the trajectory is closed
+        loaded_ensemble = std::move(built_ensemble);
+        built_ensemble = {};
+
         snprintf(info_message, sizeof(info_message), 
                  "Molecule loaded successfully: %s", built_molecule.formula.c_str());
         
@@ -367,6 +770,12 @@ struct MoleculeBuilder : viamd::EventHandler {
         
         // Broadcast topology initialization event to recreate GL resources
         viamd::event_system_broadcast_event(viamd::EventType_ViamdTopologyInit, viamd::EventPayloadType_ApplicationState, app_state);
+
+        if (loaded_ensemble.num_frames > 1) {
+            // Conformers are already optimized, attach them as a trajectory instead of minimizing
+            attach_loaded_ensemble();
+            return;
+        }
         
         // Perform energy minimization with UFF after loading
 #ifdef VIAMD_ENABLE_OPENMM
@@ -374,6 +783,52 @@ struct MoleculeBuilder : viamd::EventHandler {
 #endif
     }
 
+    void attach_loaded_ensemble() {
+        ConformerEnsemble& ens = loaded_ensemble;
+        ens.view = {};
+        ens.view.inst = (md_trajectory_o*)&ens;
+        ens.view.get_header = ensemble_traj_get_header;
+        ens.view.load_frame = ensemble_traj_load_frame;
+
+        md_trajectory_i* traj = load::traj::open_trajectory(&ens.view, ensemble_traj_loader(), &app_state->mold.mol, app_state->allocator.persistent, LoadTrajectoryFlag_InMemory);
+        if (!traj) {
+            strcpy(error_message, "Failed to attach conformer ensemble as trajectory");
+            return;
+        }
+        ens.attached = true;
+
+        MD_LOG_INFO("Molecule builder: attached %zu conformers as trajectory", ens.num_frames);
+
+        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryReplace, viamd::EventPayloadType_Trajectory, traj);
+        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryInit, viamd::EventPayloadType_ApplicationState, app_state);
+    }
+
+    void draw_ensemble_energies() {
+        const ConformerEnsemble& ens = loaded_ensemble;
+        if (!ens.attached || ens.energies.empty()) return;
+
+        ImGui::Separator();
+        ImGui::Text("Conformers (kcal/mol relative to lowest):");
+        const int current = (int)app_state->animation.frame;
+        if (ImGui::BeginTable("##conformers", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV, ImVec2(-1, 150))) {
+            ImGui::TableSetupColumn("Frame");
+            ImGui::TableSetupColumn("Energy");
+            ImGui::TableHeadersRow();
+            for (size_t i = 0; i < ens.energies.size(); ++i) {
+                char lbl[32];
+                snprintf(lbl, sizeof(lbl), "%zu", i);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                if (ImGui::Selectable(lbl, current == (int)i, ImGuiSelectableFlags_SpanAllColumns)) {
+                    app_state->animation.frame = (double)i;
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", ens.energies[i] - ens.energies[0]);
+            }
+            ImGui::EndTable();
+        }
+    }
+
     void draw_example_buttons() {
         const char* examples[][2] = {
             {"Water", "O"},
@@ -435,9 +890,59 @@ struct MoleculeBuilder : viamd::EventHandler {
                 
                 // Build button
 #ifdef VIAMD_ENABLE_RDKIT
+                ImGui::BeginDisabled(build_pending());
                 if (ImGui::Button("Build Molecule", ImVec2(-1, 0))) {
                     build_molecule_from_smiles(smiles_input);
                 }
+                ImGui::EndDisabled();
+                if (build_pending()) {
+                    ImGui::ProgressBar(task_system::task_fraction_complete(pending.task), ImVec2(-1, 0));
+                }
+
+                if (ImGui::CollapsingHeader("Embedding")) {
+                    ImGui::InputInt("Random seed", &embed_params.random_seed);
+                    if (ImGui::SliderInt("Conformers", &embed_params.num_conformers, 1, 500)) {
+                        embed_params.num_conformers = CLAMP(embed_params.num_conformers, 1, 500);
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("More than one conformer produces an ensemble which is loaded as a trajectory (one frame per conformer)");
+                    }
+                    ImGui::Checkbox("Force field optimization", &embed_params.optimize);
+                    if (embed_params.optimize) {
+                        const char* force_fields[] = { "UFF", "MMFF94" };
+                        ImGui::Combo("Force field", &embed_params.force_field, force_fields, IM_ARRAYSIZE(force_fields));
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip("MMFF94 falls back to UFF for molecules it cannot fully parameterize");
+                        }
+                        ImGui::SliderInt("Max iterations", &embed_params.max_iters, 100, 5000);
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(cache.mutex);
+                        ImGui::Text("Cache: %zu entries (%zu hits, %zu misses)", cache.entries.size(), cache.hits, cache.misses);
+                    }
+                    ImGui::SameLine();
+                    ImGui::BeginDisabled(build_pending());
+                    if (ImGui::SmallButton("Clear")) {
+                        clear_cache();
+                    }
+                    ImGui::EndDisabled();
+                }
+
+                if (ImGui::CollapsingHeader("Batch")) {
+                    ImGui::TextWrapped("Builds every SMILES in a file (one 'SMILES [name]' per line) in parallel and lays them out on a grid.");
+                    ImGui::SetNextItemWidth(-80);
+                    ImGui::InputText("##batch_path", batch_path, sizeof(batch_path));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Browse...")) {
+                        application::file_dialog(batch_path, sizeof(batch_path), application::FileDialogFlag_Open, STR_LIT("smi,txt"));
+                    }
+                    ImGui::SliderFloat("Spacing (Å)", &batch_spacing, 0.0f, 20.0f);
+                    ImGui::BeginDisabled(build_pending() || batch_path[0] == '\0');
+                    if (ImGui::Button("Build Batch", ImVec2(-1, 0))) {
+                        build_batch_from_file(batch_path);
+                    }
+                    ImGui::EndDisabled();
+                }
 #else
                 ImGui::BeginDisabled();
                 ImGui::Button("Build Molecule (RDKit required)", ImVec2(-1, 0));
@@ -478,7 +983,12 @@ struct MoleculeBuilder : viamd::EventHandler {
                     ImGui::BulletText("Formula: %s", built_molecule.formula.c_str());
                     ImGui::BulletText("Atoms: %d", built_molecule.num_atoms);
                     ImGui::BulletText("Bonds: %d", built_molecule.num_bonds);
+                    if (built_ensemble.num_frames > 1) {
+                        ImGui::BulletText("Conformers: %zu", built_ensemble.num_frames);
+                    }
                 }
+
+                draw_ensemble_energies();
             }
         }
         ImGui::End();
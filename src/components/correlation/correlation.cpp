@@ -12,12 +12,16 @@
 
 #include <viamd.h>
 #include <serialization_utils.h>
+#include <memory_budget.h>
 #include <imgui_widgets.h>
 #include <implot_widgets.h>
 #include <implot_internal.h>
 
+#include "correlation_stats.h"
+
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 struct PropertyInfo {
     char name[64] = "";
@@ -34,11 +38,56 @@ struct ScatterSeries {
     md_array(int) frame_indices = 0;
     char name[64] = "";
     ImVec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    // Correlation coefficients over the filter window, computed on the task pool
+    float pearson  = 0.0f;
+    float spearman = 0.0f;
+};
+
+struct PropertyName {
+    char str[64];
+};
+
+// Timeline filter state which statistics were computed for, the fingerprint is only updated while the filter is enabled
+struct FilterKey {
+    uint64_t fingerprint = 0;
+    bool enabled = false;
+
+    bool operator==(const FilterKey& other) const { return fingerprint == other.fingerprint && enabled == other.enabled; }
+};
+
+enum PlotMode {
+    PlotMode_Scatter,
+    PlotMode_Density,
+    PlotMode_Count,
+};
+
+static const char* plot_mode_lbl[] = {
+    "Scatter",
+    "Density",
 };
 
+// Upper limit of points drawn per series in scatter mode, larger series are decimated
+#define MAX_SCATTER_POINTS 100000
+// Upper bound for the partial density grids which are summed after binning
+#define DENSITY_PARTIAL_BUDGET MEGABYTES(32)
+
+// Maps an offset from the lower extent to a bin index in [0, bins - 1]
+// The comparisons are done in float since casting a NaN or out of range float to int is undefined behaviour
+static inline int density_bin(float offset, float scale, int bins) {
+    const float f = offset * scale;
+    if (!(f > 0.0f)) return 0;  // Also catches NaN
+    if (f >= (float)(bins - 1)) return bins - 1;
+    return (int)f;
+}
+
 struct Correlation : viamd::EventHandler {
     char error[256] = "";
     bool show_window = false;
+
+    // Display mode, scatter for individual points and density for binned counts (which scales to millions of frames)
+    PlotMode plot_mode = PlotMode_Scatter;
+    int density_bins = 128;
     
     // Property selection
     int x_property_idx = -1;
@@ -51,6 +100,52 @@ struct Correlation : viamd::EventHandler {
     
     // Scatter plot data
     md_array(ScatterSeries) series = 0;
+
+    // Copies of the selected property values, which the fill task reads from.
+    // The script evaluation which owns the property data may be recreated while the task is running.
+    md_array(float) x_source = 0;
+    md_array(float) y_source = 0;
+
+    // Per thread extents of the scatter data, written by the fill task and reduced by the density task
+    md_array(vec2_t) thread_min = 0;
+    md_array(vec2_t) thread_max = 0;
+
+    // Binned density of all series, stored row major with the first row at the top (as ImPlot::PlotHeatmap expects)
+    // The points are split into chunks, each chunk bins into its own slice of 'partial_density' which is then summed into 'density'
+    md_array(float) density = 0;
+    md_array(float) partial_density = 0;
+    int    density_dim = 0;
+    vec2_t density_min = {0, 0};
+    vec2_t density_max = {0, 0};
+    float  density_max_count = 0;
+    bool   density_valid = false;
+    uint32_t density_generation = 0;   // Used to discard results of superseded density tasks
+
+    task_system::ID fill_task    = 0;
+    task_system::ID density_task = 0;
+    task_system::ID stats_task   = 0;
+
+    // Frame window [beg, end) which the statistics are computed over (the timeline filter if enabled)
+    size_t stats_beg = 0;
+    size_t stats_end = 0;
+    bool   stats_valid = false;
+    FilterKey stats_filter = {};
+
+    // Time-lagged cross-correlation for each series, num_series rows of (2 * max_lag + 1) values
+    int    max_lag = 100;
+    int    lag_dim = 0;
+    md_array(float) lag_values = 0;
+    md_array(float) lag_axis = 0;
+
+    // Correlation matrix over all scalar properties within the filter window
+    bool   matrix_rank = false;    // Use ranks (Spearman) instead of values (Pearson)
+    bool   matrix_valid = false;
+    size_t matrix_dim = 0;
+    FilterKey matrix_filter = {};
+    md_array(PropertyName) matrix_labels = 0;
+    md_array(float) matrix_buffer = 0;     // Copy of the property values, then standardized values or ranks, one row per property
+    md_array(float) matrix = 0;
+    task_system::ID matrix_task = 0;
     
     // Interaction
     int hovered_point = -1;
@@ -59,7 +154,16 @@ struct Correlation : viamd::EventHandler {
     md_allocator_i* arena = 0;
     ApplicationState* app_state = 0;
 
-    Correlation() { viamd::event_system_register_handler(*this); }
+    Correlation() {
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdWindowDrawMenu,
+            viamd::EventType_ViamdDeserialize,
+            viamd::EventType_ViamdSerialize,
+        }, "Correlation");
+    }
 
     void process_events(const viamd::Event* events, size_t num_events) final {
         for (size_t i = 0; i < num_events; ++i) {
@@ -68,10 +172,21 @@ struct Correlation : viamd::EventHandler {
             switch (e.type) {
             case viamd::EventType_ViamdInitialize: {
                 app_state = (ApplicationState*)e.payload;
-                arena = md_arena_allocator_create(app_state->allocator.persistent, MEGABYTES(1));
+                arena = md_arena_allocator_create(memory_budget::create_allocator("Correlation", app_state->allocator.persistent), MEGABYTES(1));
                 break;
             }
             case viamd::EventType_ViamdShutdown:
+                task_system::task_interrupt_and_wait_for(matrix_task);
+                task_system::task_interrupt_and_wait_for(stats_task);
+                task_system::task_interrupt_and_wait_for(density_task);
+                task_system::task_interrupt_and_wait_for(fill_task);
+                md_array_free(x_source, md_get_heap_allocator());
+                md_array_free(y_source, md_get_heap_allocator());
+                md_array_free(matrix_labels, md_get_heap_allocator());
+                md_array_free(matrix_buffer, md_get_heap_allocator());
+                md_array_free(matrix, md_get_heap_allocator());
+                md_array_free(lag_values, md_get_heap_allocator());
+                md_array_free(lag_axis, md_get_heap_allocator());
                 md_arena_allocator_destroy(arena);
                 break;
             case viamd::EventType_ViamdFrameTick:
@@ -87,6 +202,12 @@ struct Correlation : viamd::EventHandler {
                     while (viamd::next_entry(ident, arg, state)) {
                         if (str_eq(ident, STR_LIT("show_window"))) {
                             viamd::extract_bool(show_window, arg);
+                        } else if (str_eq(ident, STR_LIT("density_bins"))) {
+                            viamd::extract_int(density_bins, arg);
+                            density_bins = CLAMP(density_bins, 8, 1024);
+                        } else if (str_eq(ident, STR_LIT("max_lag"))) {
+                            viamd::extract_int(max_lag, arg);
+                            max_lag = MAX(max_lag, 1);
                         }
                     }
                 }
@@ -96,6 +217,8 @@ struct Correlation : viamd::EventHandler {
                 viamd::serialization_state_t& state = *(viamd::serialization_state_t*)e.payload;
                 viamd::write_section_header(state, STR_LIT("Correlation"));
                 viamd::write_bool(state, STR_LIT("show_window"), show_window);
+                viamd::write_int(state, STR_LIT("density_bins"), density_bins);
+                viamd::write_int(state, STR_LIT("max_lag"), max_lag);
                 break;
             }
             default:
@@ -147,6 +270,14 @@ struct Correlation : viamd::EventHandler {
             return;
         }
         
+        // Make sure no task is still accessing the series before they are released
+        task_system::task_interrupt_and_wait_for(stats_task);
+        task_system::task_interrupt_and_wait_for(density_task);
+        task_system::task_interrupt_and_wait_for(fill_task);
+        stats_valid = false;
+        density_valid = false;
+        density_generation += 1;
+
         // Clear existing series
         for (size_t i = 0; i < md_array_size(series); ++i) {
             md_array_free(series[i].x_data, arena);
@@ -156,68 +287,474 @@ struct Correlation : viamd::EventHandler {
         md_array_resize(series, 0, arena);
         
         const size_t num_frames = x_prop.num_frames;
-        
-        if (x_prop.is_array || y_prop.is_array) {
-            // Handle array properties - create multiple series
-            const size_t x_values_per_frame = x_prop.is_array ? (x_prop.num_values / x_prop.num_frames) : 1;
-            const size_t y_values_per_frame = y_prop.is_array ? (y_prop.num_values / y_prop.num_frames) : 1;
-            
-            const size_t max_series = ImMax(x_values_per_frame, y_values_per_frame);
-            
-            for (size_t s = 0; s < max_series; ++s) {
-                ScatterSeries scatter = {};
+        if (num_frames == 0) {
+            return;
+        }
+
+        // For array properties each element forms its own series, a series only exists if both properties have the element
+        const size_t x_values_per_frame = x_prop.is_array ? (x_prop.num_values / x_prop.num_frames) : 1;
+        const size_t y_values_per_frame = y_prop.is_array ? (y_prop.num_values / y_prop.num_frames) : 1;
+        size_t num_series = 1;
+        if (x_prop.is_array && y_prop.is_array) {
+            num_series = ImMin(x_values_per_frame, y_values_per_frame);
+        } else if (x_prop.is_array) {
+            num_series = x_values_per_frame;
+        } else if (y_prop.is_array) {
+            num_series = y_values_per_frame;
+        }
+
+        for (size_t s = 0; s < num_series; ++s) {
+            ScatterSeries scatter = {};
+            if (x_prop.is_array || y_prop.is_array) {
                 snprintf(scatter.name, sizeof(scatter.name), "%s[%zu] vs %s[%zu]", 
                     x_prop.name, x_prop.is_array ? s : 0,
                     y_prop.name, y_prop.is_array ? s : 0);
-                
-                // Assign a color based on series index
-                scatter.color = ImPlot::GetColormapColor((int)s);
-                
-                for (size_t f = 0; f < num_frames; ++f) {
-                    float x_val, y_val;
-                    
-                    if (x_prop.is_array) {
-                        if (s < x_values_per_frame) {
-                            x_val = x_prop.data[f * x_values_per_frame + s];
-                        } else {
-                            continue; // Skip this series if x doesn't have enough values
-                        }
-                    } else {
-                        x_val = x_prop.data[f];
+            } else {
+                snprintf(scatter.name, sizeof(scatter.name), "%s vs %s", x_prop.name, y_prop.name);
+            }
+            // Assign a color based on series index
+            scatter.color = ImPlot::GetColormapColor((int)s);
+
+            // Size the arrays up front so the fill task can write into them in parallel
+            md_array_resize(scatter.x_data, num_frames, arena);
+            md_array_resize(scatter.y_data, num_frames, arena);
+            md_array_resize(scatter.frame_indices, num_frames, arena);
+            md_array_push(series, scatter, arena);
+        }
+
+        const size_t num_threads = task_system::pool_num_threads();
+        md_array_resize(thread_min, num_threads, arena);
+        md_array_resize(thread_max, num_threads, arena);
+        for (size_t i = 0; i < num_threads; ++i) {
+            thread_min[i] = vec2_t{ FLT_MAX,  FLT_MAX};
+            thread_max[i] = vec2_t{-FLT_MAX, -FLT_MAX};
+        }
+
+        // The property values are copied on the main thread, the fill task then only touches component owned memory
+        const size_t x_num_values = num_frames * x_values_per_frame;
+        const size_t y_num_values = num_frames * y_values_per_frame;
+        md_array_resize(x_source, x_num_values, md_get_heap_allocator());
+        md_array_resize(y_source, y_num_values, md_get_heap_allocator());
+        MEMCPY(x_source, x_prop.data, x_num_values * sizeof(float));
+        MEMCPY(y_source, y_prop.data, y_num_values * sizeof(float));
+
+        struct Payload {
+            const float* x_data;
+            const float* y_data;
+            size_t x_stride;
+            size_t y_stride;
+            bool x_array;
+            bool y_array;
+        };
+        Payload payload = {
+            .x_data = x_source,
+            .y_data = y_source,
+            .x_stride = x_values_per_frame,
+            .y_stride = y_values_per_frame,
+            .x_array = x_prop.is_array,
+            .y_array = y_prop.is_array,
+        };
+
+        const uint32_t grain_size = 4096;
+        fill_task = task_system::create_pool_task(STR_LIT("Correlation Scatter"), (uint32_t)num_frames, [corr = this, payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
+            vec2_t min_val = corr->thread_min[thread_num];
+            vec2_t max_val = corr->thread_max[thread_num];
+            for (size_t s = 0; s < md_array_size(corr->series); ++s) {
+                ScatterSeries& scatter = corr->series[s];
+                const float* x_src = payload.x_data + (payload.x_array ? s : 0);
+                const float* y_src = payload.y_data + (payload.y_array ? s : 0);
+                for (uint32_t f = range_beg; f < range_end; ++f) {
+                    const float x_val = x_src[f * payload.x_stride];
+                    const float y_val = y_src[f * payload.y_stride];
+                    scatter.x_data[f] = x_val;
+                    scatter.y_data[f] = y_val;
+                    scatter.frame_indices[f] = (int)f;
+                    // Non-finite values are kept in the series but must not affect the extent
+                    if (isfinite(x_val) && isfinite(y_val)) {
+                        min_val = {ImMin(min_val.x, x_val), ImMin(min_val.y, y_val)};
+                        max_val = {ImMax(max_val.x, x_val), ImMax(max_val.y, y_val)};
                     }
-                    
-                    if (y_prop.is_array) {
-                        if (s < y_values_per_frame) {
-                            y_val = y_prop.data[f * y_values_per_frame + s];
-                        } else {
-                            continue; // Skip this series if y doesn't have enough values
-                        }
-                    } else {
-                        y_val = y_prop.data[f];
+                }
+            }
+            corr->thread_min[thread_num] = min_val;
+            corr->thread_max[thread_num] = max_val;
+        }, grain_size);
+
+        if (plot_mode == PlotMode_Density) {
+            compute_density(fill_task);
+        }
+        compute_series_statistics(fill_task);
+        task_system::enqueue_task(fill_task);
+    }
+
+    FilterKey current_filter() const {
+        return {app_state->timeline.filter.fingerprint, app_state->timeline.filter.enabled};
+    }
+
+    // Frame window which statistics are computed over
+    void get_filter_window(size_t* beg, size_t* end, size_t num_frames) const {
+        *beg = 0;
+        *end = num_frames;
+        if (app_state->timeline.filter.enabled) {
+            *beg = (size_t)CLAMP(app_state->timeline.filter.beg_frame, 0.0, (double)num_frames);
+            *end = (size_t)CLAMP(app_state->timeline.filter.end_frame, (double)*beg, (double)num_frames);
+        }
+    }
+
+    // Pearson, Spearman and lagged cross-correlation for each plotted series, one series per task range
+    void compute_series_statistics(task_system::ID dependency = task_system::INVALID_ID) {
+        task_system::task_interrupt_and_wait_for(stats_task);
+        stats_valid = false;
+
+        const size_t num_series = md_array_size(series);
+        if (num_series == 0) {
+            return;
+        }
+
+        stats_filter = current_filter();
+        get_filter_window(&stats_beg, &stats_end, md_array_size(series[0].x_data));
+        const size_t n = stats_end - stats_beg;
+        lag_dim = (int)MIN((size_t)max_lag, n > 0 ? n - 1 : 0);
+        const size_t num_lags = 2 * (size_t)lag_dim + 1;
+        md_array_resize(lag_values, num_series * num_lags, md_get_heap_allocator());
+        md_array_resize(lag_axis, num_lags, md_get_heap_allocator());
+        for (size_t i = 0; i < num_lags; ++i) {
+            lag_axis[i] = (float)((int)i - lag_dim);
+        }
+
+        stats_task = task_system::create_pool_task(STR_LIT("Correlation Statistics"), (uint32_t)num_series, [corr = this, num_lags](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
+            (void)thread_num;
+            md_allocator_i* alloc = md_get_heap_allocator();
+            const size_t beg = corr->stats_beg;
+            const size_t n = corr->stats_end - corr->stats_beg;
+            // Pearson and Spearman are computed over the pairs where both values are finite
+            const size_t bytes = 2 * n * sizeof(float);
+            float* pairs = (float*)md_alloc(alloc, bytes);
+            defer { md_free(alloc, pairs, bytes); };
+            for (uint32_t s = range_beg; s < range_end; ++s) {
+                ScatterSeries& scatter = corr->series[s];
+                const float* x = scatter.x_data + beg;
+                const float* y = scatter.y_data + beg;
+                const size_t count = compact_finite_pairs(pairs, pairs + n, x, y, n);
+                scatter.pearson  = (float)pearson_correlation(pairs, pairs + n, count);
+                scatter.spearman = (float)spearman_correlation(pairs, pairs + n, count, alloc);
+                cross_correlation_fft(corr->lag_values + num_lags * s, x, y, n, (size_t)corr->lag_dim, alloc);
+            }
+        });
+
+        task_system::ID done_task = task_system::create_main_task(STR_LIT("##Correlation Statistics Done"), [corr = this, id = stats_task]() {
+            if (id == corr->stats_task) {
+                corr->stats_valid = true;
+            }
+        });
+        task_system::set_task_dependency(done_task, stats_task);
+
+        if (dependency != task_system::INVALID_ID) {
+            task_system::set_task_dependency(stats_task, dependency);
+        } else {
+            task_system::enqueue_task(stats_task);
+        }
+    }
+
+    // Correlation matrix between all scalar properties within the filter window.
+    // The property values are copied on the main thread, since the script evaluation which owns them may be recreated at any time.
+    // Only frames where every property is finite are copied, so all entries are computed over the same set of frames.
+    // Each row is then standardized (or ranked) in parallel, after which the matrix entries reduce to dot products.
+    void compute_matrix() {
+        task_system::task_interrupt_and_wait_for(matrix_task);
+        matrix_valid = false;
+        matrix_dim = 0;
+        matrix_filter = current_filter();
+        md_array_shrink(matrix_labels, 0);
+
+        // Indices into 'properties' of the scalar properties which share the frame count of the first one
+        md_array(int) rows = 0;
+        size_t num_frames = 0;
+        for (size_t i = 0; i < md_array_size(properties); ++i) {
+            const PropertyInfo& prop = properties[i];
+            if (!prop.data || prop.is_array || prop.num_frames == 0) continue;
+            if (num_frames == 0) num_frames = prop.num_frames;
+            if (prop.num_frames != num_frames) continue;
+            md_array_push(rows, (int)i, md_get_temp_allocator());
+        }
+
+        const size_t dim = md_array_size(rows);
+        if (dim == 0) {
+            return;
+        }
+
+        size_t beg, end;
+        get_filter_window(&beg, &end, num_frames);
+        // The window can span millions of frames, so the frame list is kept on the heap rather than in temp memory
+        md_array(uint32_t) frames = 0;
+        defer { md_array_free(frames, md_get_heap_allocator()); };
+        md_array_ensure(frames, end - beg, md_get_heap_allocator());
+        for (size_t f = beg; f < end; ++f) {
+            size_t i = 0;
+            while (i < dim && isfinite(properties[rows[i]].data[f])) ++i;
+            if (i == dim) {
+                md_array_push(frames, (uint32_t)f, md_get_heap_allocator());
+            }
+        }
+        const size_t n = md_array_size(frames);
+        md_array_resize(matrix_buffer, dim * n, md_get_heap_allocator());
+        md_array_resize(matrix, dim * dim, md_get_heap_allocator());
+        for (size_t i = 0; i < dim; ++i) {
+            const PropertyInfo& prop = properties[rows[i]];
+            PropertyName name;
+            str_copy_to_char_buf(name.str, sizeof(name.str), str_from_cstr(prop.name));
+            md_array_push(matrix_labels, name, md_get_heap_allocator());
+            float* dst = matrix_buffer + n * i;
+            for (size_t j = 0; j < n; ++j) {
+                dst[j] = prop.data[frames[j]];
+            }
+        }
+        matrix_dim = dim;
+
+        task_system::ID standardize_task = task_system::create_pool_task(STR_LIT("Correlation Matrix Standardize"), (uint32_t)dim, [corr = this, n](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
+            (void)thread_num;
+            md_allocator_i* alloc = md_get_heap_allocator();
+            for (uint32_t i = range_beg; i < range_end; ++i) {
+                float* row = corr->matrix_buffer + n * i;
+                if (corr->matrix_rank) {
+                    // The ranks replace the values, so the values are moved to a temporary row first
+                    float*    src = (float*)md_alloc(alloc, n * sizeof(float));
+                    uint32_t* tmp = (uint32_t*)md_alloc(alloc, n * sizeof(uint32_t));
+                    MEMCPY(src, row, n * sizeof(float));
+                    compute_ranks(row, src, tmp, n);
+                    md_free(alloc, tmp, n * sizeof(uint32_t));
+                    md_free(alloc, src, n * sizeof(float));
+                }
+                double mean = 0;
+                for (size_t j = 0; j < n; ++j) mean += row[j];
+                mean /= (double)MAX(n, 1);
+                double var = 0;
+                for (size_t j = 0; j < n; ++j) var += (row[j] - mean) * (row[j] - mean);
+                const double scl = var > 0.0 ? 1.0 / sqrt(var) : 0.0;
+                for (size_t j = 0; j < n; ++j) {
+                    row[j] = (float)((row[j] - mean) * scl);
+                }
+            }
+        });
+
+        matrix_task = task_system::create_pool_task(STR_LIT("Correlation Matrix"), (uint32_t)(dim * dim), [corr = this, dim, n](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
+            (void)thread_num;
+            for (uint32_t idx = range_beg; idx < range_end; ++idx) {
+                const size_t i = idx / dim;
+                const size_t j = idx % dim;
+                if (j < i) continue;    // Symmetric, the lower triangle is written together with the upper
+                const float* a = corr->matrix_buffer + n * i;
+                const float* b = corr->matrix_buffer + n * j;
+                double dot = 0;
+                for (size_t k = 0; k < n; ++k) dot += (double)a[k] * b[k];
+                corr->matrix[i * dim + j] = (float)dot;
+                corr->matrix[j * dim + i] = (float)dot;
+            }
+        }, 16);
+
+        task_system::ID done_task = task_system::create_main_task(STR_LIT("##Correlation Matrix Done"), [corr = this, id = matrix_task]() {
+            if (id == corr->matrix_task) {
+                corr->matrix_valid = true;
+            }
+        });
+
+        task_system::set_task_dependency(done_task, matrix_task);
+        task_system::set_task_dependency(matrix_task, standardize_task);
+        task_system::enqueue_task(standardize_task);
+    }
+
+    void draw_statistics() {
+        if (!stats_valid) {
+            if (task_system::task_is_running(stats_task)) {
+                ImGui::Text("Computing statistics...");
+            }
+            return;
+        }
+        if (ImGui::BeginTable("##Statistics", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY, ImVec2(-1, ImGui::GetTextLineHeightWithSpacing() * (float)MIN(md_array_size(series) + 1, 6)))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Series");
+            ImGui::TableSetupColumn("Pearson");
+            ImGui::TableSetupColumn("Spearman");
+            ImGui::TableHeadersRow();
+            for (size_t s = 0; s < md_array_size(series); ++s) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextColored(series[s].color, "%s", series[s].name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", series[s].pearson);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", series[s].spearman);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void draw_lag() {
+        if (ImGui::InputInt("Max Lag (frames)", &max_lag)) {
+            max_lag = MAX(max_lag, 1);
+        }
+        if (ImGui::IsItemDeactivatedAfterEdit() && !task_system::task_is_running(fill_task)) {
+            compute_series_statistics();
+        }
+        if (!stats_valid || lag_dim == 0) {
+            ImGui::Text("Generate a plot to compute the cross-correlation of the selected properties");
+            return;
+        }
+
+        const size_t num_series = md_array_size(series);
+        const int num_lags = 2 * lag_dim + 1;
+        const float plot_height = num_series > 1 ? ImGui::GetContentRegionAvail().y * 0.5f : -1.0f;
+
+        if (ImPlot::BeginPlot("Cross-Correlation", ImVec2(-1, plot_height))) {
+            ImPlot::SetupAxes("Lag (frames)", "Correlation");
+            ImPlot::SetupAxisLimits(ImAxis_Y1, -1.0, 1.0, ImGuiCond_Once);
+            for (size_t s = 0; s < num_series; ++s) {
+                ImPlot::PushStyleColor(ImPlotCol_Line, series[s].color);
+                ImPlot::PlotLine(series[s].name, lag_axis, lag_values + num_lags * s, num_lags);
+                ImPlot::PopStyleColor();
+            }
+            ImPlot::EndPlot();
+        }
+
+        // For multiple series, show all of them against lag as a heatmap
+        if (num_series > 1) {
+            ImPlot::PushColormap(ImPlotColormap_RdBu);
+            if (ImPlot::BeginPlot("##Cross-Correlation Heatmap", ImVec2(-1, -1))) {
+                ImPlot::SetupAxes("Lag (frames)", "Series");
+                ImPlot::PlotHeatmap("##Lag", lag_values, (int)num_series, num_lags, -1.0, 1.0, NULL,
+                    ImPlotPoint(-lag_dim, 0), ImPlotPoint(lag_dim, (double)num_series));
+                ImPlot::EndPlot();
+            }
+            ImPlot::PopColormap();
+        }
+    }
+
+    void draw_matrix() {
+        if (ImGui::Checkbox("Rank (Spearman)", &matrix_rank)) {
+            matrix_valid = false;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Compute Matrix")) {
+            compute_matrix();
+        }
+        if (task_system::task_is_running(matrix_task)) {
+            ImGui::SameLine();
+            ImGui::Text("Computing...");
+            return;
+        }
+        if (!matrix_valid || matrix_dim == 0) {
+            return;
+        }
+
+        const int dim = (int)matrix_dim;
+        const bool show_values = dim <= 16;
+        ImPlot::PushColormap(ImPlotColormap_RdBu);
+        if (ImPlot::BeginPlot("##Correlation Matrix", ImVec2(-1, -1), ImPlotFlags_Equal | ImPlotFlags_NoLegend)) {
+            md_array(const char*) labels = 0;
+            for (int i = 0; i < dim; ++i) {
+                md_array_push(labels, matrix_labels[i].str, md_get_temp_allocator());
+            }
+            // Heatmap rows are drawn from the top, so the y ticks run in reverse
+            md_array(double) x_ticks = 0;
+            md_array(double) y_ticks = 0;
+            for (int i = 0; i < dim; ++i) {
+                md_array_push(x_ticks, (double)i + 0.5, md_get_temp_allocator());
+                md_array_push(y_ticks, (double)(dim - i) - 0.5, md_get_temp_allocator());
+            }
+            ImPlot::SetupAxes(NULL, NULL, ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_NoTickMarks, ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_NoTickMarks);
+            ImPlot::SetupAxisTicks(ImAxis_X1, x_ticks, dim, labels);
+            ImPlot::SetupAxisTicks(ImAxis_Y1, y_ticks, dim, labels);
+            ImPlot::PlotHeatmap("##Matrix", matrix, dim, dim, -1.0, 1.0, show_values ? "%.2f" : NULL, ImPlotPoint(0, 0), ImPlotPoint(dim, dim));
+            ImPlot::EndPlot();
+        }
+        ImPlot::PopColormap();
+    }
+
+    void reduce_extent(vec2_t* out_min, vec2_t* out_max) const {
+        vec2_t min_val = thread_min[0];
+        vec2_t max_val = thread_max[0];
+        for (size_t i = 1; i < md_array_size(thread_min); ++i) {
+            min_val = {ImMin(min_val.x, thread_min[i].x), ImMin(min_val.y, thread_min[i].y)};
+            max_val = {ImMax(max_val.x, thread_max[i].x), ImMax(max_val.y, thread_max[i].y)};
+        }
+        *out_min = min_val;
+        *out_max = max_val;
+    }
+
+    // Bins all series into a 2D histogram on the task pool, optionally after the completion of the task 'dependency'
+    void compute_density(task_system::ID dependency = task_system::INVALID_ID) {
+        task_system::task_interrupt_and_wait_for(density_task);
+        density_valid = false;
+
+        if (md_array_size(series) == 0) {
+            return;
+        }
+
+        const size_t num_points  = md_array_size(series[0].x_data);
+        const size_t num_bins    = (size_t)density_bins * density_bins;
+
+        // One partial grid per chunk of points, the number of chunks is bounded by the thread count and by a memory budget
+        // (a grid of 1024 x 1024 bins is 4 MB, so one per thread does not scale with the core count)
+        const size_t grain_size  = 4096;
+        const size_t max_chunks  = MAX((size_t)1, DENSITY_PARTIAL_BUDGET / (num_bins * sizeof(float)));
+        const size_t num_chunks  = CLAMP(DIV_UP(num_points, grain_size), (size_t)1, MIN(task_system::pool_num_threads(), max_chunks));
+        const size_t chunk_size  = DIV_UP(num_points, num_chunks);
+
+        md_array_resize(density, num_bins, arena);
+        md_array_resize(partial_density, num_bins * num_chunks, arena);
+        MEMSET(partial_density, 0, md_array_bytes(partial_density));
+
+        density_dim = density_bins;
+        density_task = task_system::create_pool_task(STR_LIT("Correlation Density"), (uint32_t)num_chunks, [corr = this, bins = density_dim, num_points, chunk_size](uint32_t range_beg, uint32_t range_end, uint32_t) {
+            // The extent reduction is tiny (one entry per thread), so each range simply recomputes it
+            vec2_t min_val, max_val;
+            corr->reduce_extent(&min_val, &max_val);
+            const vec2_t ext = max_val - min_val;
+            const vec2_t scl = {ext.x > 0 ? bins / ext.x : 0.0f, ext.y > 0 ? bins / ext.y : 0.0f};
+
+            for (uint32_t chunk = range_beg; chunk < range_end; ++chunk) {
+                float* dst = corr->partial_density + (size_t)bins * bins * chunk;
+                const size_t beg = chunk * chunk_size;
+                const size_t end = MIN(beg + chunk_size, num_points);
+                for (size_t s = 0; s < md_array_size(corr->series); ++s) {
+                    const float* x = corr->series[s].x_data;
+                    const float* y = corr->series[s].y_data;
+                    for (size_t i = beg; i < end; ++i) {
+                        if (!isfinite(x[i]) || !isfinite(y[i])) continue;
+                        const int bx = density_bin(x[i] - min_val.x, scl.x, bins);
+                        const int by = density_bin(y[i] - min_val.y, scl.y, bins);
+                        dst[(bins - 1 - by) * bins + bx] += 1.0f;
                     }
-                    
-                    md_array_push(scatter.x_data, x_val, arena);
-                    md_array_push(scatter.y_data, y_val, arena);
-                    md_array_push(scatter.frame_indices, (int)f, arena);
                 }
-                
-                if (md_array_size(scatter.x_data) > 0) {
-                    md_array_push(series, scatter, arena);
+            }
+        });
+
+        density_generation += 1;
+        task_system::ID reduce_task = task_system::create_main_task(STR_LIT("##Reduce Correlation Density"), [corr = this, generation = density_generation]() {
+            if (generation != corr->density_generation) return;
+            const size_t num_bins = md_array_size(corr->density);
+            const size_t num_slices = md_array_size(corr->partial_density) / num_bins;
+            MEMSET(corr->density, 0, md_array_bytes(corr->density));
+            for (size_t t = 0; t < num_slices; ++t) {
+                const float* src = corr->partial_density + num_bins * t;
+                for (size_t i = 0; i < num_bins; ++i) {
+                    corr->density[i] += src[i];
                 }
             }
-        } else {
-            // Simple case - single series
-            ScatterSeries scatter = {};
-            snprintf(scatter.name, sizeof(scatter.name), "%s vs %s", x_prop.name, y_prop.name);
-            scatter.color = ImPlot::GetColormapColor(0);
-            
-            for (size_t f = 0; f < num_frames; ++f) {
-                md_array_push(scatter.x_data, x_prop.data[f], arena);
-                md_array_push(scatter.y_data, y_prop.data[f], arena);
-                md_array_push(scatter.frame_indices, (int)f, arena);
+            float max_count = 0;
+            for (size_t i = 0; i < num_bins; ++i) {
+                max_count = ImMax(max_count, corr->density[i]);
             }
-            
-            md_array_push(series, scatter, arena);
+            corr->reduce_extent(&corr->density_min, &corr->density_max);
+            corr->density_max_count = max_count;
+            corr->density_valid = true;
+        });
+
+        task_system::set_task_dependency(reduce_task, density_task);
+        if (dependency != task_system::INVALID_ID) {
+            task_system::set_task_dependency(density_task, dependency);
+        } else {
+            task_system::enqueue_task(density_task);
         }
     }
 
@@ -226,6 +763,14 @@ struct Correlation : viamd::EventHandler {
         
         if (ImGui::Begin("Correlation Plot", &show_window)) {
             update_properties();
+
+            // Statistics and the matrix are computed over the filter window, so they follow changes of the timeline filter
+            if (!(current_filter() == stats_filter) && md_array_size(series) > 0 && !task_system::task_is_running(fill_task)) {
+                compute_series_statistics();
+            }
+            if (!(current_filter() == matrix_filter) && matrix_dim > 0) {
+                compute_matrix();
+            }
             
             // Property selection UI
             ImGui::Text("X-Axis Property:");
@@ -258,73 +803,129 @@ struct Correlation : viamd::EventHandler {
                 ImGui::EndCombo();
             }
             
-            if (x_property_idx >= 0 && y_property_idx >= 0) {
-                if (ImGui::Button("Generate Plot")) {
-                    update_scatter_data();
-                }
-                
-                // Display scatter plot
-                if (md_array_size(series) > 0) {
-                    if (ImPlot::BeginPlot("Property Correlation", ImVec2(-1, -1))) {
+            if (ImGui::BeginTabBar("##Correlation Tabs")) {
+                if (ImGui::BeginTabItem("Plot")) {
+                    if (ImGui::BeginCombo("Mode", plot_mode_lbl[plot_mode])) {
+                        for (int i = 0; i < (int)PlotMode_Count; ++i) {
+                            if (ImGui::Selectable(plot_mode_lbl[i], (int)plot_mode == i)) {
+                                plot_mode = (PlotMode)i;
+                                if (plot_mode == PlotMode_Density && !density_valid && !task_system::task_is_running(fill_task)) {
+                                    compute_density();
+                                }
+                            }
+                        }
+                        ImGui::EndCombo();
+                    }
+                    if (plot_mode == PlotMode_Density) {
+                        if (ImGui::SliderInt("Bins", &density_bins, 8, 1024)) {
+                            density_bins = CLAMP(density_bins, 8, 1024);
+                        }
+                        if (ImGui::IsItemDeactivatedAfterEdit() && !task_system::task_is_running(fill_task)) {
+                            compute_density();
+                        }
+                    }
+
+                    if (x_property_idx >= 0 && y_property_idx >= 0) {
+                        if (ImGui::Button("Generate Plot")) {
+                            update_scatter_data();
+                        }
+
+                        const bool busy = task_system::task_is_running(fill_task) || task_system::task_is_running(density_task);
+                        if (busy) {
+                            ImGui::SameLine();
+                            ImGui::Text("Computing...");
+                        }
+
+                        draw_statistics();
+
+                        // Display density plot
+                        if (!busy && plot_mode == PlotMode_Density && density_valid) {
+                            if (ImPlot::BeginPlot("Property Correlation", ImVec2(-1, -1))) {
+                                ImPlot::PlotHeatmap("##Density", density, density_dim, density_dim, 0.0, density_max_count, NULL,
+                                    ImPlotPoint(density_min.x, density_min.y), ImPlotPoint(density_max.x, density_max.y));
+                                ImPlot::EndPlot();
+                            }
+                        }
+                        // Display scatter plot
+                        else if (!busy && md_array_size(series) > 0) {
+                            if (ImPlot::BeginPlot("Property Correlation", ImVec2(-1, -1))) {
                         
-                        for (size_t s = 0; s < md_array_size(series); ++s) {
-                            const ScatterSeries& scatter = series[s];
-                            if (md_array_size(scatter.x_data) > 0) {
-                                ImPlot::PushStyleColor(ImPlotCol_MarkerFill, scatter.color);
-                                ImPlot::PlotScatter(scatter.name, 
-                                    scatter.x_data, scatter.y_data, 
-                                    (int)md_array_size(scatter.x_data));
-                                ImPlot::PopStyleColor();
+                                for (size_t s = 0; s < md_array_size(series); ++s) {
+                                    const ScatterSeries& scatter = series[s];
+                                    if (md_array_size(scatter.x_data) > 0) {
+                                        // Decimate large series through a stride, both for drawing and for the hover search
+                                        const size_t num_points = md_array_size(scatter.x_data);
+                                        const size_t step = DIV_UP(num_points, MAX_SCATTER_POINTS);
+                                        const int plot_count = (int)DIV_UP(num_points, step);
+
+                                        ImPlot::PushStyleColor(ImPlotCol_MarkerFill, scatter.color);
+                                        ImPlot::PlotScatter(scatter.name, 
+                                            scatter.x_data, scatter.y_data, 
+                                            plot_count, 0, 0, (int)(step * sizeof(float)));
+                                        ImPlot::PopStyleColor();
                                 
-                                // Check for hover/click on points
-                                if (ImPlot::IsPlotHovered()) {
-                                    // Find closest point in screen space
-                                    float min_dist_sq = FLT_MAX;
-                                    int closest_point = -1;
+                                        // Check for hover/click on points
+                                        if (ImPlot::IsPlotHovered()) {
+                                            // Find closest point in screen space
+                                            float min_dist_sq = FLT_MAX;
+                                            int closest_point = -1;
                                     
-                                    for (size_t p = 0; p < md_array_size(scatter.x_data); ++p) {
-                                        // Convert plot coordinates to screen space for distance calculation
-                                        ImVec2 screen_pos = ImPlot::PlotToPixels(scatter.x_data[p], scatter.y_data[p]);
-                                        ImPlotPoint mouse_plot = ImPlot::GetPlotMousePos();
-                                        ImVec2 mouse_pixel = ImPlot::PlotToPixels(mouse_plot.x, mouse_plot.y);
+                                            for (size_t p = 0; p < num_points; p += step) {
+                                                // Convert plot coordinates to screen space for distance calculation
+                                                ImVec2 screen_pos = ImPlot::PlotToPixels(scatter.x_data[p], scatter.y_data[p]);
+                                                ImPlotPoint mouse_plot = ImPlot::GetPlotMousePos();
+                                                ImVec2 mouse_pixel = ImPlot::PlotToPixels(mouse_plot.x, mouse_plot.y);
                                         
-                                        float dx = screen_pos.x - mouse_pixel.x;
-                                        float dy = screen_pos.y - mouse_pixel.y;
-                                        float dist_sq = dx * dx + dy * dy;
+                                                float dx = screen_pos.x - mouse_pixel.x;
+                                                float dy = screen_pos.y - mouse_pixel.y;
+                                                float dist_sq = dx * dx + dy * dy;
                                         
-                                        if (dist_sq < min_dist_sq) {
-                                            min_dist_sq = dist_sq;
-                                            closest_point = (int)p;
-                                        }
-                                    }
+                                                if (dist_sq < min_dist_sq) {
+                                                    min_dist_sq = dist_sq;
+                                                    closest_point = (int)p;
+                                                }
+                                            }
                                     
-                                    // Check if close enough to hover (within 10 pixels)
-                                    if (closest_point >= 0 && min_dist_sq < 100.0f) {
-                                        hovered_point = closest_point;
+                                            // Check if close enough to hover (within 10 pixels)
+                                            if (closest_point >= 0 && min_dist_sq < 100.0f) {
+                                                hovered_point = closest_point;
                                         
-                                        // Show tooltip
-                                        ImGui::BeginTooltip();
-                                        ImGui::Text("Frame: %d", scatter.frame_indices[closest_point]);
-                                        ImGui::Text("X: %.3f", scatter.x_data[closest_point]);
-                                        ImGui::Text("Y: %.3f", scatter.y_data[closest_point]);
-                                        ImGui::Text("Click to jump to this frame");
-                                        ImGui::EndTooltip();
+                                                // Show tooltip
+                                                ImGui::BeginTooltip();
+                                                ImGui::Text("Frame: %d", scatter.frame_indices[closest_point]);
+                                                ImGui::Text("X: %.3f", scatter.x_data[closest_point]);
+                                                ImGui::Text("Y: %.3f", scatter.y_data[closest_point]);
+                                                ImGui::Text("Click to jump to this frame");
+                                                ImGui::EndTooltip();
                                         
-                                        // Handle click to jump to frame
-                                        if (ImGui::IsMouseClicked(0)) {
-                                            clicked_frame = scatter.frame_indices[closest_point];
-                                            app_state->animation.frame = (double)clicked_frame;
+                                                // Handle click to jump to frame
+                                                if (ImGui::IsMouseClicked(0)) {
+                                                    clicked_frame = scatter.frame_indices[closest_point];
+                                                    app_state->animation.frame = (double)clicked_frame;
+                                                }
+                                            }
                                         }
                                     }
                                 }
+                        
+                                ImPlot::EndPlot();
                             }
                         }
-                        
-                        ImPlot::EndPlot();
                     }
+            
+                    ImGui::EndTabItem();
+                }
+                if (ImGui::BeginTabItem("Lag")) {
+                    draw_lag();
+                    ImGui::EndTabItem();
+                }
+                if (ImGui::BeginTabItem("Matrix")) {
+                    draw_matrix();
+                    ImGui::EndTabItem();
                 }
+                ImGui::EndTabBar();
             }
-            
+
             // Show error messages if any
             if (strlen(error) > 0) {
                 ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error: %s", error);
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+
+// Correlation statistics of the correlation window, kept in a header so test_correlation_stats.cpp exercises the same code.
+// Property series may contain non-finite values (e.g. undefined angles), these are excluded from every statistic.
+
+// Copies the pairs (x[i], y[i]) where both values are finite into dst_x / dst_y, returns the number of pairs written
+static inline size_t compact_finite_pairs(float* dst_x, float* dst_y, const float* x, const float* y, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (isfinite(x[i]) && isfinite(y[i])) {
+            dst_x[count] = x[i];
+            dst_y[count] = y[i];
+            count += 1;
+        }
+    }
+    return count;
+}
+
+// Pearson correlation coefficient, accumulated in double precision (two-pass for numerical stability). The values have to be finite
+static inline double pearson_correlation(const float* x, const float* y, size_t n) {
+    if (n < 2) return 0.0;
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < n; ++i) {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= (double)n;
+    my /= (double)n;
+
+    double sxy = 0, sxx = 0, syy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double dx = x[i] - mx;
+        const double dy = y[i] - my;
+        sxy += dx * dy;
+        sxx += dx * dx;
+        syy += dy * dy;
+    }
+    const double den = sqrt(sxx * syy);
+    return den > 0.0 ? sxy / den : 0.0;
+}
+
+// Writes the ranks (starting at 1) of the values in 'x' into 'ranks', tied values receive their average rank.
+// 'tmp' has to hold n indices. The values have to be finite, NaN breaks the strict weak ordering std::sort relies on
+static inline void compute_ranks(float* ranks, const float* x, uint32_t* tmp, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        tmp[i] = (uint32_t)i;
+    }
+    std::sort(tmp, tmp + n, [x](uint32_t a, uint32_t b) { return x[a] < x[b]; });
+    size_t i = 0;
+    while (i < n) {
+        size_t j = i + 1;
+        while (j < n && x[tmp[j]] == x[tmp[i]]) ++j;
+        const float rank = 0.5f * (float)(i + j - 1) + 1.0f;
+        for (size_t k = i; k < j; ++k) {
+            ranks[tmp[k]] = rank;
+        }
+        i = j;
+    }
+}
+
+// Spearman rank correlation coefficient, the Pearson correlation of the ranks. The values have to be finite
+static inline double spearman_correlation(const float* x, const float* y, size_t n, md_allocator_i* alloc) {
+    if (n < 2) return 0.0;
+    const size_t bytes = n * (2 * sizeof(float) + sizeof(uint32_t));
+    void* mem = md_alloc(alloc, bytes);
+    defer { md_free(alloc, mem, bytes); };
+    float* rx = (float*)mem;
+    float* ry = rx + n;
+    uint32_t* tmp = (uint32_t*)(ry + n);
+    compute_ranks(rx, x, tmp, n);
+    compute_ranks(ry, y, tmp, n);
+    return pearson_correlation(rx, ry, n);
+}
+
+// In-place iterative radix-2 FFT, n has to be a power of two
+static inline void fft(double* re, double* im, size_t n, bool inverse) {
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double t;
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        const double ang = (inverse ? 2.0 : -2.0) * 3.14159265358979323846 / (double)len;
+        const double w_re = cos(ang);
+        const double w_im = sin(ang);
+        for (size_t i = 0; i < n; i += len) {
+            double u_re = 1.0, u_im = 0.0;
+            for (size_t k = 0; k < len / 2; ++k) {
+                const size_t a = i + k;
+                const size_t b = i + k + len / 2;
+                const double v_re = re[b] * u_re - im[b] * u_im;
+                const double v_im = re[b] * u_im + im[b] * u_re;
+                re[b] = re[a] - v_re;
+                im[b] = im[a] - v_im;
+                re[a] += v_re;
+                im[a] += v_im;
+                const double t = u_re * w_re - u_im * w_im;
+                u_im = u_re * w_im + u_im * w_re;
+                u_re = t;
+            }
+        }
+    }
+    if (inverse) {
+        const double scl = 1.0 / (double)n;
+        for (size_t i = 0; i < n; ++i) {
+            re[i] *= scl;
+            im[i] *= scl;
+        }
+    }
+}
+
+// Normalized cross-correlation c(tau) = sum_t (x_t - mean x)(y_{t+tau} - mean y) / (n sd_x sd_y) for tau in [-max_lag, max_lag].
+// Computed through the FFT with zero padding to avoid circular wrap around, out has to hold 2 * max_lag + 1 values.
+// Frames where x or y is non-finite are treated as missing: the means and deviations only include the finite pairs and the
+// missing frames contribute zero. The frames are not compacted, since that would shift every later frame to a different lag
+static inline void cross_correlation_fft(float* out, const float* x, const float* y, size_t n, size_t max_lag, md_allocator_i* alloc) {
+    const size_t num_out = 2 * max_lag + 1;
+    MEMSET(out, 0, num_out * sizeof(float));
+
+    double mx = 0, my = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (isfinite(x[i]) && isfinite(y[i])) {
+            mx += x[i];
+            my += y[i];
+            count += 1;
+        }
+    }
+    if (count < 2) {
+        return;
+    }
+    mx /= (double)count;
+    my /= (double)count;
+
+    size_t len = 1;
+    while (len < 2 * n) len <<= 1;
+
+    const size_t bytes = len * 4 * sizeof(double);
+    double* mem = (double*)md_alloc(alloc, bytes);
+    defer { md_free(alloc, mem, bytes); };
+    MEMSET(mem, 0, bytes);
+    double* x_re = mem + len * 0;
+    double* x_im = mem + len * 1;
+    double* y_re = mem + len * 2;
+    double* y_im = mem + len * 3;
+
+    double sxx = 0, syy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (isfinite(x[i]) && isfinite(y[i])) {
+            x_re[i] = x[i] - mx;
+            y_re[i] = y[i] - my;
+            sxx += x_re[i] * x_re[i];
+            syy += y_re[i] * y_re[i];
+        }
+    }
+
+    fft(x_re, x_im, len, false);
+    fft(y_re, y_im, len, false);
+
+    // conj(X) * Y
+    for (size_t i = 0; i < len; ++i) {
+        const double re = x_re[i] * y_re[i] + x_im[i] * y_im[i];
+        const double im = x_re[i] * y_im[i] - x_im[i] * y_re[i];
+        x_re[i] = re;
+        x_im[i] = im;
+    }
+    fft(x_re, x_im, len, true);
+
+    const double den = sqrt(sxx * syy);
+    const double scl = den > 0.0 ? 1.0 / den : 0.0;
+    for (size_t i = 0; i < num_out; ++i) {
+        const int64_t lag = (int64_t)i - (int64_t)max_lag;
+        if ((size_t)llabs(lag) >= n) {
+            continue;
+        }
+        const size_t idx = lag >= 0 ? (size_t)lag : len + lag;
+        out[i] = (float)(x_re[idx] * scl);
+    }
+}
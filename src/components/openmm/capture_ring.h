@@ -0,0 +1,214 @@
+#pragma once
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_log.h>
+#include <md_molecule.h>
+#include <md_trajectory.h>
+
+#include <stddef.h>
+
+// Capture ring for simulation frames and the snapshot VIAMD reads from when the frames are attached as its trajectory.
+// Kept in a header so test_capture_ring.cpp exercises the same code as the OpenMM component.
+
+// Frozen copy of the capture ring in logical order (oldest frame first).
+// The simulation keeps overwriting ring slots and advancing the head while VIAMD reads the attached trajectory,
+// so the view must never read the ring itself. The snapshot is immutable until the view is closed.
+struct CaptureSnapshot {
+    float*  x = nullptr;            // [num_frames * atom_count]
+    float*  y = nullptr;            // [num_frames * atom_count]
+    float*  z = nullptr;            // [num_frames * atom_count]
+    double* frame_times = nullptr;  // [num_frames]
+    md_unit_cell_t unit_cell = {};
+    size_t atom_count = 0;
+    size_t num_frames = 0;
+    md_allocator_i* alloc = nullptr;
+};
+
+static inline void free_capture_snapshot(CaptureSnapshot* snap) {
+    if (snap->alloc && snap->x) {
+        const size_t bytes = snap->num_frames * snap->atom_count * sizeof(float);
+        md_free(snap->alloc, snap->x, bytes);
+        md_free(snap->alloc, snap->y, bytes);
+        md_free(snap->alloc, snap->z, bytes);
+        md_free(snap->alloc, snap->frame_times, snap->num_frames * sizeof(double));
+    }
+    *snap = {};
+}
+
+// Internal trajectory storage for OpenMM simulation
+// Frames are kept in a fixed ring of max_frames slots, each coordinate component stored contiguously (SoA).
+// Slot (head + i) % max_frames holds the i:th oldest frame, so capturing a frame never moves existing data.
+// Frame times are mirrored into [capacity, 2 * capacity) so that frame_times + head is always in logical order.
+struct InternalTrajectoryStorage {
+    float*  x = nullptr;            // [max_frames * atom_count]
+    float*  y = nullptr;            // [max_frames * atom_count]
+    float*  z = nullptr;            // [max_frames * atom_count]
+    double* frame_times = nullptr;  // [2 * max_frames]
+    md_unit_cell_t unit_cell = {};
+    size_t atom_count = 0;  // Number of atoms per frame
+    size_t capacity = 0;    // Number of slots currently allocated
+    size_t head = 0;        // Slot of the oldest stored frame
+    size_t count = 0;       // Number of stored frames
+    int max_frames = 1000;  // Maximum frames to store
+    bool enabled = true;    // Whether to capture frames
+
+    // Trajectory view handed to VIAMD, reads from a snapshot of the ring taken when it was attached
+    md_trajectory_i view = {};
+    CaptureSnapshot snapshot = {};
+
+    inline size_t slot(size_t frame_idx) const { return (head + frame_idx) % capacity; }
+    inline const float* frame_x(size_t frame_idx) const { return x + slot(frame_idx) * atom_count; }
+    inline const float* frame_y(size_t frame_idx) const { return y + slot(frame_idx) * atom_count; }
+    inline const float* frame_z(size_t frame_idx) const { return z + slot(frame_idx) * atom_count; }
+    inline double frame_time(size_t frame_idx) const { return frame_times[head + frame_idx]; }
+    // The snapshot is released when VIAMD closes the view, so the view is attached for as long as the snapshot holds frames
+    inline bool view_attached() const { return snapshot.num_frames > 0; }
+};
+
+// Allocates the slots of an empty ring
+static inline void capture_ring_allocate(InternalTrajectoryStorage* ring, size_t atom_count, size_t capacity, md_allocator_i* alloc) {
+    ASSERT(!ring->x);
+    const size_t bytes = capacity * atom_count * sizeof(float);
+    ring->x = (float*)md_alloc(alloc, bytes);
+    ring->y = (float*)md_alloc(alloc, bytes);
+    ring->z = (float*)md_alloc(alloc, bytes);
+    ring->frame_times = (double*)md_alloc(alloc, 2 * capacity * sizeof(double));
+    ring->atom_count = atom_count;
+    ring->capacity   = capacity;
+    ring->head  = 0;
+    ring->count = 0;
+}
+
+// Releases the slots, the snapshot is owned by the view and released separately
+static inline void capture_ring_free(InternalTrajectoryStorage* ring, md_allocator_i* alloc) {
+    if (ring->x) {
+        const size_t bytes = ring->capacity * ring->atom_count * sizeof(float);
+        md_free(alloc, ring->x, bytes);
+        md_free(alloc, ring->y, bytes);
+        md_free(alloc, ring->z, bytes);
+        md_free(alloc, ring->frame_times, 2 * ring->capacity * sizeof(double));
+    }
+    ring->x = nullptr;
+    ring->y = nullptr;
+    ring->z = nullptr;
+    ring->frame_times = nullptr;
+    ring->atom_count = 0;
+    ring->capacity = 0;
+    ring->head = 0;
+    ring->count = 0;
+}
+
+// Stores a frame of atom_count atoms. When full, the new frame overwrites the oldest slot and the head advances
+static inline void capture_ring_push(InternalTrajectoryStorage* ring, const float* x, const float* y, const float* z, double time) {
+    size_t dst;
+    if (ring->count < ring->capacity) {
+        dst = ring->slot(ring->count);
+        ring->count += 1;
+    } else {
+        dst = ring->head;
+        ring->head = (ring->head + 1) % ring->capacity;
+    }
+
+    const size_t offset = dst * ring->atom_count;
+    const size_t bytes  = ring->atom_count * sizeof(float);
+    MEMCPY(ring->x + offset, x, bytes);
+    MEMCPY(ring->y + offset, y, bytes);
+    MEMCPY(ring->z + offset, z, bytes);
+    ring->frame_times[dst] = time;
+    ring->frame_times[dst + ring->capacity] = time;
+}
+
+// md_trajectory_i implementation over a capture snapshot. Frame i is the i:th oldest frame at the time the view was attached,
+// indices and frame times stay valid while the simulation keeps capturing into the ring. Times are in ps.
+static inline bool capture_traj_get_header(struct md_trajectory_o* inst, md_trajectory_header_t* header) {
+    const CaptureSnapshot* snap = (const CaptureSnapshot*)inst;
+    ASSERT(snap);
+    if (header) {
+        MEMSET(header, 0, sizeof(md_trajectory_header_t));
+        header->num_frames  = snap->num_frames;
+        header->num_atoms   = snap->atom_count;
+        header->frame_times = snap->frame_times;
+        return true;
+    }
+    return false;
+}
+
+static inline bool capture_traj_load_frame(struct md_trajectory_o* inst, int64_t idx, md_trajectory_frame_header_t* header, float* x, float* y, float* z) {
+    const CaptureSnapshot* snap = (const CaptureSnapshot*)inst;
+    ASSERT(snap);
+    if (idx < 0 || (size_t)idx >= snap->num_frames) {
+        MD_LOG_ERROR("Simulation trajectory: frame index out of range");
+        return false;
+    }
+
+    if (header) {
+        MEMSET(header, 0, sizeof(md_trajectory_frame_header_t));
+        header->num_atoms = snap->atom_count;
+        header->index     = idx;
+        header->timestamp = snap->frame_times[idx];
+        header->unit_cell = snap->unit_cell;
+    }
+
+    const size_t offset = (size_t)idx * snap->atom_count;
+    const size_t bytes  = snap->atom_count * sizeof(float);
+    if (x) MEMCPY(x, snap->x + offset, bytes);
+    if (y) MEMCPY(y, snap->y + offset, bytes);
+    if (z) MEMCPY(z, snap->z + offset, bytes);
+
+    return true;
+}
+
+// Called by the loader when VIAMD closes the view, releases the snapshot the view was reading from
+static inline void capture_traj_destroy(md_trajectory_i* traj) {
+    CaptureSnapshot* snap = (CaptureSnapshot*)traj->inst;
+    if (snap) {
+        free_capture_snapshot(snap);
+    }
+}
+
+// Releases the snapshot of the attached view. While the view is attached, close_view() is called first to have VIAMD close it,
+// which releases the snapshot through capture_traj_destroy. The snapshot is released here as well in case it was not attached.
+template <typename CloseView>
+static inline void capture_ring_detach(InternalTrajectoryStorage* ring, CloseView close_view) {
+    if (ring->view_attached()) {
+        close_view();
+    }
+    free_capture_snapshot(&ring->snapshot);
+}
+
+// Copies the ring into a new snapshot in logical order and points the view at it, returns false if the ring is empty.
+// A previous view is detached first: closing it after the new snapshot is taken would release the new snapshot.
+template <typename CloseView>
+static inline bool capture_ring_attach(InternalTrajectoryStorage* ring, md_allocator_i* alloc, CloseView close_view) {
+    if (ring->count == 0) {
+        return false;
+    }
+    capture_ring_detach(ring, close_view);
+
+    CaptureSnapshot& snap = ring->snapshot;
+    const size_t bytes = ring->count * ring->atom_count * sizeof(float);
+    snap.alloc = alloc;
+    snap.x = (float*)md_alloc(alloc, bytes);
+    snap.y = (float*)md_alloc(alloc, bytes);
+    snap.z = (float*)md_alloc(alloc, bytes);
+    snap.frame_times = (double*)md_alloc(alloc, ring->count * sizeof(double));
+    snap.atom_count = ring->atom_count;
+    snap.num_frames = ring->count;
+    snap.unit_cell  = ring->unit_cell;
+
+    const size_t frame_bytes = ring->atom_count * sizeof(float);
+    for (size_t i = 0; i < ring->count; ++i) {
+        const size_t offset = i * ring->atom_count;
+        MEMCPY(snap.x + offset, ring->frame_x(i), frame_bytes);
+        MEMCPY(snap.y + offset, ring->frame_y(i), frame_bytes);
+        MEMCPY(snap.z + offset, ring->frame_z(i), frame_bytes);
+    }
+    MEMCPY(snap.frame_times, ring->frame_times + ring->head, ring->count * sizeof(double));
+
+    ring->view = {};
+    ring->view.inst = (md_trajectory_o*)&snap;
+    ring->view.get_header = capture_traj_get_header;
+    ring->view.load_frame = capture_traj_load_frame;
+    return true;
+}
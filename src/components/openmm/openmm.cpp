@@ -11,22 +11,37 @@
 #include <core/md_vec_math.h>
 #include <core/md_array.h>
 #include <core/md_bitfield.h>
+#include <core/md_hash.h>
+#include <core/md_os.h>
 #include <md_molecule.h>
+#include <md_trajectory.h>
+
+#include <task_system.h>
+#include <loader.h>
+#include <memory_budget.h>
 
 #include <imgui_widgets.h>
 #include <imgui.h>
+#include <implot.h>
 
 #include <OpenMM.h>
 
+#include "capture_ring.h"
+
 #include <memory>
 #include <string>
 #include <vector>
 #include <cstring>
 #include <map>
+#include <unordered_map>
 #include <tuple>
 #include <algorithm>
 #include <cmath>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdio>
 
 namespace openmm {
 
@@ -36,6 +51,13 @@ enum class ForceFieldType {
     UFF
 };
 
+// Nonbonded interaction treatment, the periodic methods require a unit cell on the molecule
+enum class NonbondedMethod {
+    CutoffNonPeriodic,
+    CutoffPeriodic,
+    PME
+};
+
 // AMBER force field parameter structures
 struct AmberAtomType {
     std::string name;
@@ -94,19 +116,463 @@ struct SimulationContext {
     // Force field configuration
     ForceFieldType force_field_type = ForceFieldType::AMBER;
     std::string force_field_name = "AMBER14";
+
+    // Nonbonded configuration, falls back to CutoffNonPeriodic when the molecule has no unit cell
+    NonbondedMethod nonbonded_method = NonbondedMethod::PME;
+    double cutoff = 1.0;            // nm
+    double ewald_tolerance = 5e-4;  // Relative error in the Ewald/PME forces
+};
+
+static md_trajectory_loader_i* capture_traj_loader() {
+    static md_trajectory_loader_i loader = {};
+    loader.destroy = capture_traj_destroy;
+    return &loader;
+}
+
+// Cumulative counters of the simulation thread since it was launched (times in seconds)
+struct SimulationTimings {
+    int64_t steps = 0;
+    double integrate = 0.0;     // integrator->step()
+    double state = 0.0;         // context->getState() and conversion into the frame
+    double wall = 0.0;
+};
+
+// A completed simulation frame as published by the simulation thread (positions in Ångström)
+struct SimulationFrame {
+    float* x = nullptr;
+    float* y = nullptr;
+    float* z = nullptr;
+    double potential_energy = 0.0;
+    double time = 0.0;          // ps
+    int64_t frame = 0;
+    int64_t step = 0;           // Integration steps since the last reset
+    uint32_t generation = 0;    // Reset generation the frame belongs to
+    SimulationTimings timings;  // Task counters at the time the frame was published
+};
+
+enum SimulationCommand : uint32_t {
+    SimulationCommand_Reset            = 0x1,
+    SimulationCommand_UpdateParameters = 0x2,
+};
+
+// Number of independent accumulators in the fused position conversion, maps onto a 256-bit register of floats
+#define CONVERT_LANES 8
+
+// Maximum displacement of any atom between two published frames before the simulation is considered exploded (Ångström)
+#define EXPLOSION_DISPLACEMENT 10.0
+
+struct ConvertResult {
+    float max_disp2 = 0.0f;     // Maximum squared displacement relative to the reference (Ångström^2)
+    uint32_t max_idx = 0;       // Atom with the maximum displacement
+    bool non_finite = false;    // Any coordinate was NaN or Inf
+};
+
+// Converts OpenMM positions (AoS double, nm) into SoA float Ångström in a single pass.
+// With TRACK, the squared displacement relative to the reference coordinates is tracked and the reference is updated
+// to the new coordinates. Non-finite values are detected by accumulating (v - v), which is zero unless v is NaN or Inf.
+template <bool TRACK>
+static ConvertResult convert_positions(float* out_x, float* out_y, float* out_z, float* ref_x, float* ref_y, float* ref_z, const OpenMM::Vec3* pos, size_t count) {
+    static_assert(sizeof(OpenMM::Vec3) == 3 * sizeof(double), "Vec3 is expected to be three packed doubles");
+    if (count == 0) return {};
+    const double* p = &pos[0][0];
+
+    float s_nan[CONVERT_LANES] = {0};
+    float s_max[CONVERT_LANES] = {0};
+    uint32_t s_idx[CONVERT_LANES] = {0};
+
+    auto convert = [&](size_t i, size_t l) {
+        const float x = (float)(p[3 * i + 0] * 10.0);
+        const float y = (float)(p[3 * i + 1] * 10.0);
+        const float z = (float)(p[3 * i + 2] * 10.0);
+        out_x[i] = x;
+        out_y[i] = y;
+        out_z[i] = z;
+        s_nan[l] += (x - x) + (y - y) + (z - z);
+        if (TRACK) {
+            const float dx = x - ref_x[i];
+            const float dy = y - ref_y[i];
+            const float dz = z - ref_z[i];
+            const float d2 = dx * dx + dy * dy + dz * dz;
+            s_idx[l] = d2 > s_max[l] ? (uint32_t)i : s_idx[l];
+            s_max[l] = d2 > s_max[l] ? d2 : s_max[l];
+            ref_x[i] = x;
+            ref_y[i] = y;
+            ref_z[i] = z;
+        }
+    };
+
+    size_t i = 0;
+    const size_t simd_count = count & ~(size_t)(CONVERT_LANES - 1);
+    for (; i < simd_count; i += CONVERT_LANES) {
+        for (size_t l = 0; l < CONVERT_LANES; ++l) {
+            convert(i + l, l);
+        }
+    }
+    for (; i < count; ++i) {
+        convert(i, 0);
+    }
+
+    ConvertResult res;
+    for (size_t l = 0; l < CONVERT_LANES; ++l) {
+        res.non_finite |= (s_nan[l] != s_nan[l]);
+        if (s_max[l] > res.max_disp2) {
+            res.max_disp2 = s_max[l];
+            res.max_idx = s_idx[l];
+        }
+    }
+    return res;
+}
+
+// The integrator runs on a dedicated thread which publishes frames through a triple buffer.
+// It is deliberately not a pool task: the loop only ends when asked to, so it would permanently occupy a worker,
+// and a pool task may be picked up by any thread waiting in task_wait_for, including the UI thread which is the only one that can stop it.
+// The thread owns 'back', the UI thread owns 'front' and 'middle' holds the most recently completed frame.
+// Publishing and consuming are single atomic exchanges, so neither side ever waits for the other.
+// Reset and parameter changes are posted as commands and applied by the thread in between steps.
+struct SimulationWorker {
+    static constexpr uint32_t FRESH_BIT = 0x4;
+
+    std::thread thread;
+    std::atomic_bool active = false;    // Set while the thread is inside its loop, cleared when it exits (also on failure or explosion)
+    SimulationFrame frames[3] = {};
+    size_t atom_count = 0;
+
+    uint32_t back  = 0;                 // Only touched by the simulation thread
+    uint32_t front = 2;                 // Only touched by the UI thread
+    std::atomic_uint32_t middle = 1;    // Slot index | FRESH_BIT
+
+    std::atomic_bool stop = false;
+    std::atomic_bool failed = false;
+    std::atomic_bool exploded = false;
+    std::atomic_uint32_t commands = 0;
+
+    // Command arguments, guarded by mutex
+    std::mutex mutex;
+    double temperature = 0.0;
+    double friction = 0.0;
+    double timestep = 0.0;
+    int steps_per_update = 1;
+    std::vector<OpenMM::Vec3> reset_positions;
+    uint32_t generation = 0;
+
+    // Simulation clock, only touched by the simulation thread (or the UI thread while the thread is not running)
+    double time = 0.0;
+    int64_t frame = 0;
+    int64_t step = 0;
+    uint32_t applied_generation = 0;
+
+    SimulationTimings timings;  // Only touched by the simulation thread, reset on launch
+
+    // Coordinates of the previously published frame, for displacement tracking. Only touched by the simulation thread
+    float* ref_x = nullptr;
+    float* ref_y = nullptr;
+    float* ref_z = nullptr;
+    bool ref_valid = false;     // Cleared on launch and reset, the first frame after only initializes the reference
+
+    // Diagnostics written by the thread before setting failed/exploded
+    double explosion_disp = 0.0;
+    uint32_t explosion_atom = 0;
+    double explosion_energy = 0.0;
+    char error[256] = "";
+};
+
+// Appends frames to a GROMACS TRR file (single precision, nm / ps) from a dedicated writer thread.
+// The simulation thread copies every stride:th frame it publishes into a single-producer/single-consumer queue,
+// independent of which frames the UI thread picks up from the triple buffer. The writer thread encodes and writes
+// each frame with a single write followed by a flush, so the file can be opened by VIAMD or other tools while the
+// simulation is still running. If the writer falls behind, frames are dropped rather than stalling the simulation.
+// Like the simulation thread, the writer thread is not a pool task and never calls into the task system.
+struct TrajectoryWriter {
+    static constexpr uint32_t QUEUE_SIZE = 16;
+
+    struct Frame {
+        float* x = nullptr;
+        float* y = nullptr;
+        float* z = nullptr;
+        md_unit_cell_t unit_cell = {};
+        double time = 0.0;
+        int64_t step = 0;
+    };
+
+    FILE* file = nullptr;               // Opened and closed by the UI thread, written by the writer thread
+    char path[1024] = "";
+    int stride = 10;
+    size_t atom_count = 0;
+    md_unit_cell_t unit_cell = {};      // The simulation runs at constant volume, the box is fixed when writing starts
+
+    Frame queue[QUEUE_SIZE] = {};
+    std::atomic_uint32_t write_idx = 0; // Only advanced by the simulation thread
+    std::atomic_uint32_t read_idx  = 0; // Only advanced by the writer thread
+
+    uint8_t* encode_buf = nullptr;      // Only touched by the writer thread
+    size_t encode_cap = 0;
+
+    std::thread thread;
+    std::condition_variable wake;       // Signaled when a frame is queued or the writer is stopped
+    std::mutex mutex;                   // Guards active, stop and frames_seen
+    bool active = false;                // The simulation thread only queues frames while set
+    bool stop = false;
+    int64_t frames_seen = 0;
+
+    std::atomic_int64_t frames_written = 0;
+    std::atomic_int64_t frames_dropped = 0;
+    std::atomic_bool failed = false;
+    std::atomic_bool step_overflow = false; // A step did not fit the 32-bit TRR header field
+};
+
+// Throughput statistics of the running simulation, maintained by the UI thread.
+// Task counters are sampled from consumed frames, so frames skipped by the triple buffer are still accounted for.
+// Deltas are accumulated into windows of at least SAMPLE_INTERVAL seconds before being pushed to the history.
+struct SimulationPerformance {
+    static constexpr int HISTORY_SIZE = 240;
+    static constexpr double SAMPLE_INTERVAL = 0.25;
+
+    struct Sample {
+        double ns_per_day = 0.0;
+        double steps_per_second = 0.0;
+        // Milliseconds per consumed frame
+        double integrate = 0.0;
+        double state = 0.0;
+        double capture = 0.0;
+        double upload = 0.0;
+    };
+
+    SimulationTimings prev = {};    // Task counters of the previously consumed frame
+    SimulationTimings acc  = {};    // Accumulated deltas of the current window
+    double acc_capture = 0.0;       // UI side seconds spent copying into the molecule and ring
+    double acc_upload  = 0.0;       // Position upload to GPU buffers
+    int acc_frames = 0;
+
+    Sample current = {};
+    float history_ns_per_day[HISTORY_SIZE] = {};
+    float history_integrate[HISTORY_SIZE] = {};
+    float history_state[HISTORY_SIZE] = {};
+    float history_capture[HISTORY_SIZE] = {};
+    float history_upload[HISTORY_SIZE] = {};
+    int history_offset = 0;
+    int history_count = 0;
+
+    // Benchmark preset, runs a fixed number of steps with fixed parameters and reports the average throughput
+    bool benchmark_active = false;
+    int64_t benchmark_steps = 20000;
+    SimulationTimings benchmark_start = {};
+    double benchmark_capture = 0.0;
+    double benchmark_upload  = 0.0;
+    int benchmark_frames = 0;
+    char benchmark_result[256] = "";
+
+    std::string platform_name;
+    std::string platform_threads;
 };
 
-// Internal trajectory storage for OpenMM simulation
-struct InternalTrajectoryStorage {
-    md_array(float*) stored_x = nullptr;  // Array of x coordinate arrays for each frame
-    md_array(float*) stored_y = nullptr;  // Array of y coordinate arrays for each frame  
-    md_array(float*) stored_z = nullptr;  // Array of z coordinate arrays for each frame
-    md_array(double) frame_times = nullptr;  // Time for each stored frame
-    size_t atom_count = 0;  // Number of atoms per frame
-    int max_frames = 1000;  // Maximum frames to store
-    bool enabled = true;    // Whether to capture frames
+static inline uint8_t* xdr_put_i32(uint8_t* p, int32_t val) {
+    const uint32_t v = (uint32_t)val;
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)(v);
+    return p + 4;
+}
+
+static inline uint8_t* xdr_put_f32(uint8_t* p, float val) {
+    uint32_t v;
+    MEMCPY(&v, &val, sizeof(v));
+    return xdr_put_i32(p, (int32_t)v);
+}
+
+static size_t trr_frame_size(size_t atom_count) {
+    // magic + version string + 13 header ints + t + lambda + box + coords
+    return 4 + 4 + 4 + 12 + 13 * 4 + 2 * 4 + 9 * 4 + atom_count * 3 * 4;
+}
+
+// Encodes one TRR frame with positions (Ångström -> nm) and the box if the unit cell is set, returns the number of bytes written.
+// The step is a 32-bit integer in the TRR header, steps beyond its range are saturated instead of wrapping around
+// and reported through step_overflow. The time of the frame is unaffected.
+static size_t trr_encode_frame(uint8_t* buf, const float* x, const float* y, const float* z, size_t atom_count, int64_t step, double time, const md_unit_cell_t& cell, bool* step_overflow = nullptr) {
+    const bool has_box = cell.flags != 0;
+    const float scl = 0.1f;
+
+    uint8_t* p = buf;
+    p = xdr_put_i32(p, 1993);           // Magic
+    p = xdr_put_i32(p, 13);             // strlen("GMX_trn_file") + 1
+    p = xdr_put_i32(p, 12);             // XDR string length
+    MEMCPY(p, "GMX_trn_file", 12);
+    p += 12;
+    p = xdr_put_i32(p, 0);              // ir_size
+    p = xdr_put_i32(p, 0);              // e_size
+    p = xdr_put_i32(p, has_box ? 9 * 4 : 0);  // box_size
+    p = xdr_put_i32(p, 0);              // vir_size
+    p = xdr_put_i32(p, 0);              // pres_size
+    p = xdr_put_i32(p, 0);              // top_size
+    p = xdr_put_i32(p, 0);              // sym_size
+    p = xdr_put_i32(p, (int32_t)(atom_count * 3 * 4)); // x_size
+    p = xdr_put_i32(p, 0);              // v_size
+    p = xdr_put_i32(p, 0);              // f_size
+    p = xdr_put_i32(p, (int32_t)atom_count);
+    const int64_t header_step = CLAMP(step, (int64_t)0, (int64_t)INT32_MAX);
+    if (step_overflow && header_step != step) *step_overflow = true;
+    p = xdr_put_i32(p, (int32_t)header_step);
+    p = xdr_put_i32(p, 0);              // nre
+    p = xdr_put_f32(p, (float)time);
+    p = xdr_put_f32(p, 0.0f);           // lambda
+    if (has_box) {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                p = xdr_put_f32(p, cell.basis[i][j] * scl);
+            }
+        }
+    }
+    for (size_t i = 0; i < atom_count; ++i) {
+        p = xdr_put_f32(p, x[i] * scl);
+        p = xdr_put_f32(p, y[i] * scl);
+        p = xdr_put_f32(p, z[i] * scl);
+    }
+    return (size_t)(p - buf);
+}
+
+// Bonded topology derived from mol.bond: CSR adjacency plus flat angle (i-j-k) and dihedral (i-j-k-l) lists.
+// Neighbors appear in bond order, so the enumeration order matches a per-atom adjacency list built from the same bonds.
+struct BondedTopology {
+    std::vector<uint32_t> offsets;      // [atom_count + 1]
+    std::vector<uint32_t> neighbors;    // [2 * bond_count]
+    std::vector<uint32_t> angles;       // [3 * angle_count]
+    std::vector<uint32_t> dihedrals;    // [4 * dihedral_count]
+
+    size_t degree(size_t i) const { return offsets[i + 1] - offsets[i]; }
+    size_t angle_count() const { return angles.size() / 3; }
+    size_t dihedral_count() const { return dihedrals.size() / 4; }
 };
 
+// Runs fn over [0, count) on the task pool and waits for completion
+static void parallel_for(str_t label, uint32_t count, task_system::RangeTask fn, uint32_t grain_size) {
+    if (count == 0) return;
+    task_system::ID id = task_system::create_pool_task(label, count, fn, grain_size);
+    task_system::enqueue_task(id);
+    task_system::task_wait_for(id);
+}
+
+static void build_bonded_topology(BondedTopology* topo, const md_molecule_t& mol) {
+    const size_t atom_count = mol.atom.count;
+    const size_t bond_count = mol.bond.count;
+
+    // CSR adjacency (counting sort over bond endpoints)
+    topo->offsets.assign(atom_count + 1, 0);
+    for (size_t i = 0; i < bond_count; ++i) {
+        const auto& bond = mol.bond.pairs[i];
+        topo->offsets[bond.idx[0] + 1] += 1;
+        topo->offsets[bond.idx[1] + 1] += 1;
+    }
+    for (size_t i = 0; i < atom_count; ++i) {
+        topo->offsets[i + 1] += topo->offsets[i];
+    }
+    topo->neighbors.resize(2 * bond_count);
+    std::vector<uint32_t> fill(topo->offsets.begin(), topo->offsets.end() - 1);
+    for (size_t i = 0; i < bond_count; ++i) {
+        const auto& bond = mol.bond.pairs[i];
+        topo->neighbors[fill[bond.idx[0]]++] = bond.idx[1];
+        topo->neighbors[fill[bond.idx[1]]++] = bond.idx[0];
+    }
+
+    const uint32_t* offsets   = topo->offsets.data();
+    const uint32_t* neighbors = topo->neighbors.data();
+
+    // Angles: every pair of neighbors around each center atom, the count per center is known up front
+    std::vector<size_t> angle_offsets(atom_count + 1, 0);
+    for (size_t c = 0; c < atom_count; ++c) {
+        const size_t deg = topo->degree(c);
+        angle_offsets[c + 1] = angle_offsets[c] + deg * (deg - (deg > 0)) / 2;
+    }
+    topo->angles.resize(3 * angle_offsets[atom_count]);
+    uint32_t* angles = topo->angles.data();
+    parallel_for(STR_LIT("Enumerate Angles"), (uint32_t)atom_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+        for (uint32_t c = beg; c < end; ++c) {
+            uint32_t* out = angles + 3 * angle_offsets[c];
+            for (uint32_t i = offsets[c]; i < offsets[c + 1]; ++i) {
+                for (uint32_t j = i + 1; j < offsets[c + 1]; ++j) {
+                    *out++ = neighbors[i];
+                    *out++ = c;
+                    *out++ = neighbors[j];
+                }
+            }
+        }
+    }, 1024);
+
+    // Dihedrals: A-B-C-D around each bond B-C, counted first so that each bond can write to its own range
+    std::vector<size_t> dihedral_offsets(bond_count + 1, 0);
+    parallel_for(STR_LIT("Count Dihedrals"), (uint32_t)bond_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+        for (uint32_t i = beg; i < end; ++i) {
+            const uint32_t b = mol.bond.pairs[i].idx[0];
+            const uint32_t c = mol.bond.pairs[i].idx[1];
+            size_t num_a = 0, num_d = 0;
+            for (uint32_t k = offsets[b]; k < offsets[b + 1]; ++k) num_a += (neighbors[k] != c);
+            for (uint32_t k = offsets[c]; k < offsets[c + 1]; ++k) num_d += (neighbors[k] != b);
+            dihedral_offsets[i + 1] = num_a * num_d;
+        }
+    }, 1024);
+    for (size_t i = 0; i < bond_count; ++i) {
+        dihedral_offsets[i + 1] += dihedral_offsets[i];
+    }
+    topo->dihedrals.resize(4 * dihedral_offsets[bond_count]);
+    uint32_t* dihedrals = topo->dihedrals.data();
+    parallel_for(STR_LIT("Enumerate Dihedrals"), (uint32_t)bond_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+        for (uint32_t i = beg; i < end; ++i) {
+            const uint32_t b = mol.bond.pairs[i].idx[0];
+            const uint32_t c = mol.bond.pairs[i].idx[1];
+            uint32_t* out = dihedrals + 4 * dihedral_offsets[i];
+            for (uint32_t k = offsets[b]; k < offsets[b + 1]; ++k) {
+                const uint32_t a = neighbors[k];
+                if (a == c) continue;
+                for (uint32_t l = offsets[c]; l < offsets[c + 1]; ++l) {
+                    const uint32_t d = neighbors[l];
+                    if (d == b) continue;
+                    *out++ = a;
+                    *out++ = b;
+                    *out++ = c;
+                    *out++ = d;
+                }
+            }
+        }
+    }, 1024);
+}
+
+// Element symbol -> atomic number through a small open addressing table keyed on the (up to) two first characters
+static uint8_t atomic_number_from_symbol(const char* sym, size_t len) {
+    struct Entry { uint16_t key; uint8_t value; };
+    static constexpr size_t TABLE_SIZE = 128;
+    static const auto table = []() {
+        static const struct { const char* sym; uint8_t z; } elements[] = {
+            {"H", 1}, {"He", 2}, {"Li", 3}, {"Be", 4}, {"B", 5}, {"C", 6}, {"N", 7}, {"O", 8}, {"F", 9}, {"Ne", 10},
+            {"Na", 11}, {"Mg", 12}, {"Al", 13}, {"Si", 14}, {"P", 15}, {"S", 16}, {"Cl", 17}, {"Ar", 18}, {"K", 19}, {"Ca", 20},
+            {"Mn", 25}, {"Fe", 26}, {"Co", 27}, {"Ni", 28}, {"Cu", 29}, {"Zn", 30}, {"Se", 34}, {"Br", 35}, {"I", 53},
+        };
+        std::vector<Entry> t(TABLE_SIZE, Entry{0, 0});
+        for (const auto& e : elements) {
+            const uint16_t key = (uint16_t)((uint8_t)e.sym[0] | ((uint8_t)e.sym[1] << 8));
+            size_t i = (key * 2654435761u) & (TABLE_SIZE - 1);
+            while (t[i].key) i = (i + 1) & (TABLE_SIZE - 1);
+            t[i] = {key, e.z};
+        }
+        return t;
+    }();
+
+    auto lookup = [](uint16_t key) -> uint8_t {
+        size_t i = (key * 2654435761u) & (TABLE_SIZE - 1);
+        while (table[i].key) {
+            if (table[i].key == key) return table[i].value;
+            i = (i + 1) & (TABLE_SIZE - 1);
+        }
+        return 0;
+    };
+
+    if (len == 0) return 0;
+    // Two letter symbols are case sensitive (Cl, Ca, ...) so that atom names such as CA still resolve to carbon
+    if (len > 1) {
+        uint8_t z = lookup((uint16_t)((uint8_t)sym[0] | ((uint8_t)sym[1] << 8)));
+        if (z) return z;
+    }
+    return lookup((uint16_t)(uint8_t)sym[0]);
+}
+
 class OpenMMComponent : public viamd::EventHandler {
 public:
     SimulationContext sim_context;
@@ -114,10 +580,20 @@ public:
 private:
     md_allocator_i* allocator = nullptr;
     InternalTrajectoryStorage internal_trajectory;
+    SimulationWorker worker;
+    TrajectoryWriter writer;
+    SimulationPerformance perf;
 
 public:
     OpenMMComponent() { 
-        viamd::event_system_register_handler(*this); 
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdTopologyInit,
+            viamd::EventType_ViamdTopologyFree,
+            viamd::EventType_ViamdWindowDrawMenu,
+        }, "OpenMM");
     }
 
     void process_events(const viamd::Event* events, size_t num_events) final {
@@ -157,11 +633,14 @@ public:
     }
 
     void initialize(ApplicationState& state) {
-        allocator = state.allocator.persistent;
+        allocator = memory_budget::create_allocator("OpenMM", state.allocator.persistent);
         MD_LOG_INFO("OpenMM component initialized");
     }
 
     void shutdown() {
+        // The simulation thread never finishes on its own, it has to be stopped and joined before the context goes away
+        stop_simulation_thread();
+        stop_trajectory_writer();
         // Note: cleanup_simulation needs an ApplicationState, so we can't clean up here
         // Cleanup will happen when topology is freed
         MD_LOG_INFO("OpenMM component shutdown");
@@ -169,9 +648,27 @@ public:
 
     void update(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
-        if (state.simulation.running && !state.simulation.paused && state.simulation.initialized) {
-            // Run simulation steps
-            run_simulation_step(state);
+        if (!state.simulation.initialized) {
+            return;
+        }
+
+        // Pick up whatever the simulation thread has completed since the last frame
+        consume_simulation_frame(state);
+        poll_trajectory_writer();
+
+        if (state.simulation.running && !state.simulation.paused) {
+            if (!worker.active.load(std::memory_order_acquire)) {
+                launch_simulation_thread(state);
+            }
+        } else if (worker.active.load(std::memory_order_acquire)) {
+            // Pause and stop let the thread finish its current batch of steps and exit
+            stop_simulation_thread();
+            consume_simulation_frame(state);
+            if (perf.benchmark_active) {
+                // The thread counters restart with the next launch, a partial run is not comparable
+                perf.benchmark_active = false;
+                MD_LOG_INFO("OpenMM benchmark cancelled");
+            }
         }
 #endif
     }
@@ -211,6 +708,7 @@ public:
     }
 
     void on_topology_free() {
+        stop_simulation_thread();
         // Note: We can't call cleanup_simulation here without ApplicationState
         // The ApplicationState will handle clearing the simulation flags
         MD_LOG_INFO("Topology freed, OpenMM simulation stopped");
@@ -228,15 +726,17 @@ public:
             // Create OpenMM system
             sim_context.system = std::make_unique<OpenMM::System>();
             
+            const md_timestamp_t t0 = md_time_current();
+
+            // Connectivity, angles and dihedrals shared by both force fields
+            BondedTopology topo;
+            build_bonded_topology(&topo, state.mold.mol);
+            const md_timestamp_t t1 = md_time_current();
+
             // Add particles (atoms) to the system with AMBER masses
-            std::vector<std::string> amber_types(state.mold.mol.atom.count);
+            // Masses are assigned from the element only (no bonding environment), resolved once per unique atom type
+            std::vector<std::string> amber_types = assign_atom_types(state, nullptr, ForceFieldType::AMBER);
             for (size_t i = 0; i < state.mold.mol.atom.count; ++i) {
-                uint8_t atomic_number = get_atomic_number_from_atom_type(state.mold.mol.atom.type[i]);
-                
-                // Create a temporary connectivity for atom type assignment
-                std::vector<uint32_t> temp_connectivity;
-                amber_types[i] = map_to_amber_type(state.mold.mol.atom.type[i], atomic_number, temp_connectivity, state);
-                
                 // Get AMBER mass for this atom type
                 AmberAtomType atom_params = get_amber_atom_params(amber_types[i]);
                 double mass = atom_params.mass;
@@ -248,7 +748,8 @@ public:
             }
             
             // Set up basic force field (simplified)
-            setup_force_field(state);
+            setup_force_field(state, topo);
+            const md_timestamp_t t2 = md_time_current();
             
             // Create integrator
             sim_context.integrator = std::make_unique<OpenMM::LangevinIntegrator>(
@@ -257,6 +758,13 @@ public:
             // Create context
             sim_context.context = std::make_unique<OpenMM::Context>(
                 *sim_context.system, *sim_context.integrator);
+            const md_timestamp_t t3 = md_time_current();
+
+            query_platform_info();
+
+            MD_LOG_INFO("OpenMM setup: topology %.1f ms, force field %.1f ms, context %.1f ms (%zu atoms, %zu angles, %zu dihedrals)",
+                        md_time_as_seconds(t1 - t0) * 1000.0, md_time_as_seconds(t2 - t1) * 1000.0, md_time_as_seconds(t3 - t2) * 1000.0,
+                        state.mold.mol.atom.count, topo.angle_count(), topo.dihedral_count());
             
             // Set initial positions
             set_positions(state);
@@ -270,6 +778,9 @@ public:
             
             // Initialize internal trajectory capture
             init_internal_trajectory_capture(state);
+
+            // Buffers the simulation thread publishes its frames through
+            init_simulation_worker(state);
             
             MD_LOG_INFO("OpenMM simulation system initialized with %zu atoms", 
                        state.mold.mol.atom.count);
@@ -286,144 +797,192 @@ public:
 #endif
     }
 
-    void setup_force_field(ApplicationState& state) {
+    void setup_force_field(ApplicationState& state, const BondedTopology& topo) {
         // Update force field name based on selected type
         switch (sim_context.force_field_type) {
         case ForceFieldType::AMBER:
             sim_context.force_field_name = "AMBER14";
-            setup_amber_force_field(state);
+            setup_amber_force_field(state, topo);
             break;
         case ForceFieldType::UFF:
             sim_context.force_field_name = "UFF";
-            setup_uff_force_field(state);
+            setup_uff_force_field(state, topo);
             break;
         }
     }
 
-    void setup_amber_force_field(ApplicationState& state) {
-        MD_LOG_INFO("Setting up AMBER force field...");
-        
-        // Step 1: Build connectivity information and assign AMBER atom types
-        std::vector<std::string> amber_types(state.mold.mol.atom.count);
-        std::vector<std::vector<uint32_t>> connectivity(state.mold.mol.atom.count);
-        
-        // Build connectivity matrix
-        for (size_t i = 0; i < state.mold.mol.bond.count; ++i) {
-            const auto& bond = state.mold.mol.bond.pairs[i];
-            uint32_t atom1 = bond.idx[0];
-            uint32_t atom2 = bond.idx[1];
-            connectivity[atom1].push_back(atom2);
-            connectivity[atom2].push_back(atom1);
+    // Sets the nonbonded method and cutoff, and for periodic methods the box vectors of the system from the unit cell
+    void configure_nonbonded_force(OpenMM::NonbondedForce* force, const md_unit_cell_t& cell) {
+        const bool has_cell = (cell.flags & (MD_UNIT_CELL_FLAG_ORTHO | MD_UNIT_CELL_FLAG_TRICLINIC)) != 0;
+        NonbondedMethod method = sim_context.nonbonded_method;
+        double cutoff = sim_context.cutoff;
+
+        if (method != NonbondedMethod::CutoffNonPeriodic && !has_cell) {
+            MD_LOG_INFO("No unit cell present, using non-periodic cutoff for nonbonded interactions");
+            method = NonbondedMethod::CutoffNonPeriodic;
         }
-        
-        // Assign AMBER atom types
-        for (size_t i = 0; i < state.mold.mol.atom.count; ++i) {
-            uint8_t atomic_number = get_atomic_number_from_atom_type(state.mold.mol.atom.type[i]);
-            amber_types[i] = map_to_amber_type(state.mold.mol.atom.type[i], atomic_number, connectivity[i], state);
+
+        if (method == NonbondedMethod::CutoffNonPeriodic) {
+            force->setNonbondedMethod(OpenMM::NonbondedForce::CutoffNonPeriodic);
+            force->setCutoffDistance(cutoff);
+            return;
+        }
+
+        // OpenMM expects reduced box vectors in nm: a along x, b in the xy-plane
+        const OpenMM::Vec3 a(cell.basis[0][0] * 0.1, cell.basis[0][1] * 0.1, cell.basis[0][2] * 0.1);
+        const OpenMM::Vec3 b(cell.basis[1][0] * 0.1, cell.basis[1][1] * 0.1, cell.basis[1][2] * 0.1);
+        const OpenMM::Vec3 c(cell.basis[2][0] * 0.1, cell.basis[2][1] * 0.1, cell.basis[2][2] * 0.1);
+        sim_context.system->setDefaultPeriodicBoxVectors(a, b, c);
+
+        // The cutoff may not exceed half of the smallest box width (perpendicular extents of a reduced cell)
+        const double max_cutoff = 0.5 * std::min(a[0], std::min(b[1], c[2]));
+        if (cutoff > max_cutoff) {
+            MD_LOG_INFO("Nonbonded cutoff %.3f nm exceeds half the box width, clamping to %.3f nm", cutoff, max_cutoff);
+            cutoff = max_cutoff;
         }
+
+        if (method == NonbondedMethod::PME) {
+            force->setNonbondedMethod(OpenMM::NonbondedForce::PME);
+            force->setEwaldErrorTolerance(sim_context.ewald_tolerance);
+        } else {
+            force->setNonbondedMethod(OpenMM::NonbondedForce::CutoffPeriodic);
+        }
+        force->setCutoffDistance(cutoff);
+        MD_LOG_INFO("Periodic nonbonded interactions (%s), box %.3f x %.3f x %.3f nm, cutoff %.3f nm",
+                    method == NonbondedMethod::PME ? "PME" : "cutoff", a[0], b[1], c[2], cutoff);
+    }
+
+    uint8_t atomic_number(const ApplicationState& state, size_t i) const {
+        // Prefer the element assigned by the loader, fall back to parsing the atom type
+        if (state.mold.mol.atom.element && state.mold.mol.atom.element[i]) {
+            return (uint8_t)state.mold.mol.atom.element[i];
+        }
+        return get_atomic_number_from_atom_type(state.mold.mol.atom.type[i]);
+    }
+
+    // Atom types only depend on the type label, element and number of bonded atoms,
+    // so each unique combination is mapped once and looked up through a hash table afterwards.
+    // Without a topology all atoms are treated as unbonded.
+    std::vector<std::string> assign_atom_types(const ApplicationState& state, const BondedTopology* topo, ForceFieldType ff) {
+        const size_t atom_count = state.mold.mol.atom.count;
+        std::vector<std::string> types(atom_count);
+        std::unordered_map<uint64_t, uint32_t> lookup;
+        for (size_t i = 0; i < atom_count; ++i) {
+            const md_label_t& label = state.mold.mol.atom.type[i];
+            const uint8_t z = atomic_number(state, i);
+            const size_t degree = topo ? topo->degree(i) : 0;
+            const uint64_t key = md_hash64(label.buf, strnlen(label.buf, sizeof(label.buf)), ((uint64_t)z << 32) | degree);
+
+            auto it = lookup.find(key);
+            if (it != lookup.end()) {
+                types[i] = types[it->second];
+                continue;
+            }
+            types[i] = (ff == ForceFieldType::AMBER) ? map_to_amber_type(label, z, degree) : map_to_uff_type(label, z, degree);
+            lookup.emplace(key, (uint32_t)i);
+        }
+        return types;
+    }
+
+    void setup_amber_force_field(ApplicationState& state, const BondedTopology& topo) {
+        MD_LOG_INFO("Setting up AMBER force field...");
+        
+        // Step 1: Assign AMBER atom types based on connectivity
+        std::vector<std::string> amber_types = assign_atom_types(state, &topo, ForceFieldType::AMBER);
         
         // Step 2: Set up bond forces with AMBER parameters
         if (state.mold.mol.bond.count > 0) {
             auto* bondForce = new OpenMM::HarmonicBondForce();
+
+            // Parameter lookups are independent per term and run on the task pool, OpenMM forces are filled serially
+            std::vector<AmberBondType> bond_params(state.mold.mol.bond.count);
+            parallel_for(STR_LIT("AMBER Bond Parameters"), (uint32_t)bond_params.size(), [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const auto& bond = state.mold.mol.bond.pairs[i];
+                    bond_params[i] = get_amber_bond_params(amber_types[bond.idx[0]], amber_types[bond.idx[1]]);
+                }
+            }, 256);
             
             for (size_t i = 0; i < state.mold.mol.bond.count; ++i) {
                 const auto& bond = state.mold.mol.bond.pairs[i];
                 uint32_t atom1 = bond.idx[0];
                 uint32_t atom2 = bond.idx[1];
                 
-                // Get AMBER bond parameters
-                AmberBondType bond_params = get_amber_bond_params(amber_types[atom1], amber_types[atom2]);
-                
                 // Always use force field equilibrium length for correct distances
-                double equilibrium_length = bond_params.r0;
+                double equilibrium_length = bond_params[i].r0;
                 
-                bondForce->addBond(atom1, atom2, equilibrium_length, bond_params.k);
+                bondForce->addBond(atom1, atom2, equilibrium_length, bond_params[i].k);
                 
                 MD_LOG_DEBUG("Bond %zu-%zu: %s-%s, k=%.1f, r0=%.4f nm", 
                            atom1, atom2, amber_types[atom1].c_str(), amber_types[atom2].c_str(),
-                           bond_params.k, equilibrium_length);
+                           bond_params[i].k, equilibrium_length);
             }
             
             sim_context.system->addForce(bondForce);
             MD_LOG_INFO("Added %zu bond forces", state.mold.mol.bond.count);
         }
         
-        // Step 3: Set up angle forces (missing from original implementation)
-        auto* angleForce = new OpenMM::HarmonicAngleForce();
-        size_t angle_count = 0;
-        
-        for (size_t center = 0; center < state.mold.mol.atom.count; ++center) {
-            const auto& bonded = connectivity[center];
-            
-            // For each pair of atoms bonded to the center atom, create an angle
-            for (size_t i = 0; i < bonded.size(); ++i) {
-                for (size_t j = i + 1; j < bonded.size(); ++j) {
-                    uint32_t atom1 = bonded[i];
-                    uint32_t atom2 = static_cast<uint32_t>(center);
-                    uint32_t atom3 = bonded[j];
-                    
-                    // Get AMBER angle parameters
-                    AmberAngleType angle_params = get_amber_angle_params(
-                        amber_types[atom1], amber_types[atom2], amber_types[atom3]);
-                    
-                    angleForce->addAngle(atom1, atom2, atom3, angle_params.theta0, angle_params.k);
-                    angle_count++;
-                    
-                    MD_LOG_DEBUG("Angle %u-%u-%u: %s-%s-%s, k=%.1f, theta0=%.3f rad", 
-                               atom1, atom2, atom3, 
-                               amber_types[atom1].c_str(), amber_types[atom2].c_str(), amber_types[atom3].c_str(),
-                               angle_params.k, angle_params.theta0);
+        // Step 3: Set up angle forces
+        const size_t angle_count = topo.angle_count();
+        if (angle_count > 0) {
+            auto* angleForce = new OpenMM::HarmonicAngleForce();
+
+            std::vector<AmberAngleType> angle_params(angle_count);
+            parallel_for(STR_LIT("AMBER Angle Parameters"), (uint32_t)angle_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const uint32_t* idx = &topo.angles[3 * i];
+                    angle_params[i] = get_amber_angle_params(amber_types[idx[0]], amber_types[idx[1]], amber_types[idx[2]]);
                 }
+            }, 256);
+
+            for (size_t i = 0; i < angle_count; ++i) {
+                const uint32_t atom1 = topo.angles[3 * i + 0];
+                const uint32_t atom2 = topo.angles[3 * i + 1];
+                const uint32_t atom3 = topo.angles[3 * i + 2];
+                
+                angleForce->addAngle(atom1, atom2, atom3, angle_params[i].theta0, angle_params[i].k);
+                
+                MD_LOG_DEBUG("Angle %u-%u-%u: %s-%s-%s, k=%.1f, theta0=%.3f rad", 
+                           atom1, atom2, atom3, 
+                           amber_types[atom1].c_str(), amber_types[atom2].c_str(), amber_types[atom3].c_str(),
+                           angle_params[i].k, angle_params[i].theta0);
             }
-        }
-        
-        if (angle_count > 0) {
+
             sim_context.system->addForce(angleForce);
             MD_LOG_INFO("Added %zu angle forces", angle_count);
-        } else {
-            delete angleForce;
         }
         
-        // Step 4: Set up dihedral forces (torsional angles)
-        auto* dihedralForce = new OpenMM::PeriodicTorsionForce();
-        size_t dihedral_count = 0;
-        
-        // Generate dihedrals for all connected chains of 4 atoms (A-B-C-D)
-        for (size_t bond_b_c = 0; bond_b_c < state.mold.mol.bond.count; ++bond_b_c) {
-            const auto& central_bond = state.mold.mol.bond.pairs[bond_b_c];
-            uint32_t atom_b = central_bond.idx[0];
-            uint32_t atom_c = central_bond.idx[1];
-            
-            // Find atoms connected to B (but not C)
-            for (uint32_t atom_a : connectivity[atom_b]) {
-                if (atom_a == atom_c) continue;
-                
-                // Find atoms connected to C (but not B)
-                for (uint32_t atom_d : connectivity[atom_c]) {
-                    if (atom_d == atom_b) continue;
-                    
-                    // Get AMBER dihedral parameters
-                    AmberDihedralType dihedral_params = get_amber_dihedral_params(
-                        amber_types[atom_a], amber_types[atom_b], amber_types[atom_c], amber_types[atom_d]);
-                    
-                    dihedralForce->addTorsion(atom_a, atom_b, atom_c, atom_d,
-                                            dihedral_params.n, dihedral_params.phi0, dihedral_params.k);
-                    dihedral_count++;
-                    
-                    MD_LOG_DEBUG("Dihedral %u-%u-%u-%u: %s-%s-%s-%s, k=%.1f, phi0=%.3f, n=%d", 
-                               atom_a, atom_b, atom_c, atom_d,
-                               amber_types[atom_a].c_str(), amber_types[atom_b].c_str(), 
-                               amber_types[atom_c].c_str(), amber_types[atom_d].c_str(),
-                               dihedral_params.k, dihedral_params.phi0, dihedral_params.n);
+        // Step 4: Set up dihedral forces (torsional angles) for all connected chains of 4 atoms (A-B-C-D)
+        const size_t dihedral_count = topo.dihedral_count();
+        if (dihedral_count > 0) {
+            auto* dihedralForce = new OpenMM::PeriodicTorsionForce();
+
+            std::vector<AmberDihedralType> dihedral_params(dihedral_count);
+            parallel_for(STR_LIT("AMBER Dihedral Parameters"), (uint32_t)dihedral_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const uint32_t* idx = &topo.dihedrals[4 * i];
+                    dihedral_params[i] = get_amber_dihedral_params(amber_types[idx[0]], amber_types[idx[1]], amber_types[idx[2]], amber_types[idx[3]]);
                 }
+            }, 256);
+
+            for (size_t i = 0; i < dihedral_count; ++i) {
+                const uint32_t atom_a = topo.dihedrals[4 * i + 0];
+                const uint32_t atom_b = topo.dihedrals[4 * i + 1];
+                const uint32_t atom_c = topo.dihedrals[4 * i + 2];
+                const uint32_t atom_d = topo.dihedrals[4 * i + 3];
+                const AmberDihedralType& p = dihedral_params[i];
+                
+                dihedralForce->addTorsion(atom_a, atom_b, atom_c, atom_d, p.n, p.phi0, p.k);
+                
+                MD_LOG_DEBUG("Dihedral %u-%u-%u-%u: %s-%s-%s-%s, k=%.1f, phi0=%.3f, n=%d", 
+                           atom_a, atom_b, atom_c, atom_d,
+                           amber_types[atom_a].c_str(), amber_types[atom_b].c_str(), 
+                           amber_types[atom_c].c_str(), amber_types[atom_d].c_str(),
+                           p.k, p.phi0, p.n);
             }
-        }
-        
-        if (dihedral_count > 0) {
+
             sim_context.system->addForce(dihedralForce);
             MD_LOG_INFO("Added %zu dihedral forces", dihedral_count);
-        } else {
-            delete dihedralForce;
         }
         
         // Step 5: Set up non-bonded forces with AMBER parameters
@@ -447,8 +1006,7 @@ public:
                        i, amber_types[i].c_str(), charge, sigma, epsilon);
         }
         
-        nonbondedForce->setNonbondedMethod(OpenMM::NonbondedForce::CutoffNonPeriodic);
-        nonbondedForce->setCutoffDistance(1.0); // nm - standard cutoff for non-periodic
+        configure_nonbonded_force(nonbondedForce, state.mold.mol.unit_cell);
         
         sim_context.system->addForce(nonbondedForce);
         MD_LOG_INFO("Added non-bonded forces with AMBER parameters");
@@ -457,48 +1015,38 @@ public:
                    state.mold.mol.atom.count, state.mold.mol.bond.count, angle_count, dihedral_count);
     }
 
-    void setup_uff_force_field(ApplicationState& state) {
+    void setup_uff_force_field(ApplicationState& state, const BondedTopology& topo) {
         MD_LOG_INFO("Setting up UFF force field...");
         
-        // Step 1: Build connectivity information and assign UFF atom types
-        std::vector<std::string> uff_types(state.mold.mol.atom.count);
-        std::vector<std::vector<uint32_t>> connectivity(state.mold.mol.atom.count);
-        
-        // Build connectivity matrix
-        for (size_t i = 0; i < state.mold.mol.bond.count; ++i) {
-            const auto& bond = state.mold.mol.bond.pairs[i];
-            uint32_t atom1 = bond.idx[0];
-            uint32_t atom2 = bond.idx[1];
-            connectivity[atom1].push_back(atom2);
-            connectivity[atom2].push_back(atom1);
-        }
-        
-        // Assign UFF atom types
-        for (size_t i = 0; i < state.mold.mol.atom.count; ++i) {
-            uint8_t atomic_number = get_atomic_number_from_atom_type(state.mold.mol.atom.type[i]);
-            uff_types[i] = map_to_uff_type(state.mold.mol.atom.type[i], atomic_number, connectivity[i], state);
-        }
+        // Step 1: Assign UFF atom types based on connectivity
+        std::vector<std::string> uff_types = assign_atom_types(state, &topo, ForceFieldType::UFF);
         
         // Step 2: Set up bond forces with UFF parameters
         if (state.mold.mol.bond.count > 0) {
             auto* bondForce = new OpenMM::HarmonicBondForce();
+
+            // Parameter lookups are independent per term and run on the task pool, OpenMM forces are filled serially
+            std::vector<UffBondType> bond_params(state.mold.mol.bond.count);
+            parallel_for(STR_LIT("UFF Bond Parameters"), (uint32_t)bond_params.size(), [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const auto& bond = state.mold.mol.bond.pairs[i];
+                    bond_params[i] = get_uff_bond_params(uff_types[bond.idx[0]], uff_types[bond.idx[1]]);
+                }
+            }, 256);
             
             for (size_t i = 0; i < state.mold.mol.bond.count; ++i) {
                 const auto& bond = state.mold.mol.bond.pairs[i];
                 uint32_t atom1 = bond.idx[0];
                 uint32_t atom2 = bond.idx[1];
                 
-                // Get UFF bond parameters
-                UffBondType bond_params = get_uff_bond_params(uff_types[atom1], uff_types[atom2]);
-                
                 // Always use force field equilibrium length for correct distances
-                double equilibrium_length = bond_params.r0;
+                double equilibrium_length = bond_params[i].r0;
                 
-                bondForce->addBond(atom1, atom2, equilibrium_length, bond_params.k);
+                bondForce->addBond(atom1, atom2, equilibrium_length, bond_params[i].k);
                 
                 MD_LOG_DEBUG("Bond %zu-%zu: %s-%s, k=%.1f, r0=%.4f nm", 
                            atom1, atom2, uff_types[atom1].c_str(), uff_types[atom2].c_str(),
-                           bond_params.k, equilibrium_length);
+                           bond_params[i].k, equilibrium_length);
             }
             
             sim_context.system->addForce(bondForce);
@@ -506,81 +1054,66 @@ public:
         }
         
         // Step 3: Set up angle forces
-        auto* angleForce = new OpenMM::HarmonicAngleForce();
-        size_t angle_count = 0;
-        
-        for (size_t center = 0; center < state.mold.mol.atom.count; ++center) {
-            const auto& bonded = connectivity[center];
-            
-            // For each pair of atoms bonded to the center atom, create an angle
-            for (size_t i = 0; i < bonded.size(); ++i) {
-                for (size_t j = i + 1; j < bonded.size(); ++j) {
-                    uint32_t atom1 = bonded[i];
-                    uint32_t atom2 = static_cast<uint32_t>(center);
-                    uint32_t atom3 = bonded[j];
-                    
-                    // Get UFF angle parameters
-                    UffAngleType angle_params = get_uff_angle_params(
-                        uff_types[atom1], uff_types[atom2], uff_types[atom3]);
-                    
-                    angleForce->addAngle(atom1, atom2, atom3, angle_params.theta0, angle_params.k);
-                    angle_count++;
-                    
-                    MD_LOG_DEBUG("Angle %u-%u-%u: %s-%s-%s, k=%.1f, theta0=%.3f rad", 
-                               atom1, atom2, atom3, 
-                               uff_types[atom1].c_str(), uff_types[atom2].c_str(), uff_types[atom3].c_str(),
-                               angle_params.k, angle_params.theta0);
+        const size_t angle_count = topo.angle_count();
+        if (angle_count > 0) {
+            auto* angleForce = new OpenMM::HarmonicAngleForce();
+
+            std::vector<UffAngleType> angle_params(angle_count);
+            parallel_for(STR_LIT("UFF Angle Parameters"), (uint32_t)angle_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const uint32_t* idx = &topo.angles[3 * i];
+                    angle_params[i] = get_uff_angle_params(uff_types[idx[0]], uff_types[idx[1]], uff_types[idx[2]]);
                 }
+            }, 256);
+
+            for (size_t i = 0; i < angle_count; ++i) {
+                const uint32_t atom1 = topo.angles[3 * i + 0];
+                const uint32_t atom2 = topo.angles[3 * i + 1];
+                const uint32_t atom3 = topo.angles[3 * i + 2];
+                
+                angleForce->addAngle(atom1, atom2, atom3, angle_params[i].theta0, angle_params[i].k);
+                
+                MD_LOG_DEBUG("Angle %u-%u-%u: %s-%s-%s, k=%.1f, theta0=%.3f rad", 
+                           atom1, atom2, atom3, 
+                           uff_types[atom1].c_str(), uff_types[atom2].c_str(), uff_types[atom3].c_str(),
+                           angle_params[i].k, angle_params[i].theta0);
             }
-        }
-        
-        if (angle_count > 0) {
+
             sim_context.system->addForce(angleForce);
             MD_LOG_INFO("Added %zu angle forces", angle_count);
-        } else {
-            delete angleForce;
         }
         
-        // Step 4: Set up dihedral forces (torsional angles)
-        auto* dihedralForce = new OpenMM::PeriodicTorsionForce();
-        size_t dihedral_count = 0;
-        
-        // Generate dihedrals for all connected chains of 4 atoms (A-B-C-D)
-        for (size_t bond_b_c = 0; bond_b_c < state.mold.mol.bond.count; ++bond_b_c) {
-            const auto& central_bond = state.mold.mol.bond.pairs[bond_b_c];
-            uint32_t atom_b = central_bond.idx[0];
-            uint32_t atom_c = central_bond.idx[1];
-            
-            // Find atoms connected to B (but not C)
-            for (uint32_t atom_a : connectivity[atom_b]) {
-                if (atom_a == atom_c) continue;
-                
-                // Find atoms connected to C (but not B)
-                for (uint32_t atom_d : connectivity[atom_c]) {
-                    if (atom_d == atom_b) continue;
-                    
-                    // Get UFF dihedral parameters
-                    UffDihedralType dihedral_params = get_uff_dihedral_params(
-                        uff_types[atom_a], uff_types[atom_b], uff_types[atom_c], uff_types[atom_d]);
-                    
-                    dihedralForce->addTorsion(atom_a, atom_b, atom_c, atom_d,
-                                            dihedral_params.n, dihedral_params.phi0, dihedral_params.k);
-                    dihedral_count++;
-                    
-                    MD_LOG_DEBUG("Dihedral %u-%u-%u-%u: %s-%s-%s-%s, k=%.1f, phi0=%.3f, n=%d", 
-                               atom_a, atom_b, atom_c, atom_d,
-                               uff_types[atom_a].c_str(), uff_types[atom_b].c_str(), 
-                               uff_types[atom_c].c_str(), uff_types[atom_d].c_str(),
-                               dihedral_params.k, dihedral_params.phi0, dihedral_params.n);
+        // Step 4: Set up dihedral forces (torsional angles) for all connected chains of 4 atoms (A-B-C-D)
+        const size_t dihedral_count = topo.dihedral_count();
+        if (dihedral_count > 0) {
+            auto* dihedralForce = new OpenMM::PeriodicTorsionForce();
+
+            std::vector<UffDihedralType> dihedral_params(dihedral_count);
+            parallel_for(STR_LIT("UFF Dihedral Parameters"), (uint32_t)dihedral_count, [&](uint32_t beg, uint32_t end, uint32_t) {
+                for (uint32_t i = beg; i < end; ++i) {
+                    const uint32_t* idx = &topo.dihedrals[4 * i];
+                    dihedral_params[i] = get_uff_dihedral_params(uff_types[idx[0]], uff_types[idx[1]], uff_types[idx[2]], uff_types[idx[3]]);
                 }
+            }, 256);
+
+            for (size_t i = 0; i < dihedral_count; ++i) {
+                const uint32_t atom_a = topo.dihedrals[4 * i + 0];
+                const uint32_t atom_b = topo.dihedrals[4 * i + 1];
+                const uint32_t atom_c = topo.dihedrals[4 * i + 2];
+                const uint32_t atom_d = topo.dihedrals[4 * i + 3];
+                const UffDihedralType& p = dihedral_params[i];
+                
+                dihedralForce->addTorsion(atom_a, atom_b, atom_c, atom_d, p.n, p.phi0, p.k);
+                
+                MD_LOG_DEBUG("Dihedral %u-%u-%u-%u: %s-%s-%s-%s, k=%.1f, phi0=%.3f, n=%d", 
+                           atom_a, atom_b, atom_c, atom_d,
+                           uff_types[atom_a].c_str(), uff_types[atom_b].c_str(), 
+                           uff_types[atom_c].c_str(), uff_types[atom_d].c_str(),
+                           p.k, p.phi0, p.n);
             }
-        }
-        
-        if (dihedral_count > 0) {
+
             sim_context.system->addForce(dihedralForce);
             MD_LOG_INFO("Added %zu dihedral forces", dihedral_count);
-        } else {
-            delete dihedralForce;
         }
         
         // Step 5: Set up non-bonded forces with UFF parameters
@@ -604,8 +1137,7 @@ public:
                        i, uff_types[i].c_str(), charge, sigma, epsilon);
         }
         
-        nonbondedForce->setNonbondedMethod(OpenMM::NonbondedForce::CutoffNonPeriodic);
-        nonbondedForce->setCutoffDistance(1.0); // nm - standard cutoff for non-periodic
+        configure_nonbonded_force(nonbondedForce, state.mold.mol.unit_cell);
         
         sim_context.system->addForce(nonbondedForce);
         MD_LOG_INFO("Added non-bonded forces with UFF parameters");
@@ -641,6 +1173,11 @@ public:
         if (!sim_context.context) {
             return;
         }
+
+        // The context is not thread safe, any running simulation thread is relaunched on the next update
+        stop_simulation_thread();
+        // A frame published just before the stop would otherwise overwrite the minimized coordinates on the next update
+        discard_pending_frame();
         
         // Validate system state before attempting minimization
         if (!state.mold.mol.atom.x || !state.mold.mol.atom.y || !state.mold.mol.atom.z || 
@@ -676,10 +1213,10 @@ public:
                     MD_LOG_DEBUG("Updating %zu atom positions after energy minimization", update_count);
                     
                     // Copy coordinates immediately to avoid holding references
-                    for (size_t i = 0; i < update_count; ++i) {
-                        state.mold.mol.atom.x[i] = static_cast<float>(positions[i][0] * 10.0);
-                        state.mold.mol.atom.y[i] = static_cast<float>(positions[i][1] * 10.0);
-                        state.mold.mol.atom.z[i] = static_cast<float>(positions[i][2] * 10.0);
+                    ConvertResult conv = convert_positions<false>(state.mold.mol.atom.x, state.mold.mol.atom.y, state.mold.mol.atom.z,
+                        nullptr, nullptr, nullptr, positions.data(), update_count);
+                    if (conv.non_finite) {
+                        MD_LOG_ERROR("Non-finite coordinates after energy minimization");
                     }
                 } else {
                     MD_LOG_ERROR("Invalid atom coordinate arrays detected during energy minimization update");
@@ -709,102 +1246,481 @@ public:
 #endif
     }
 
-    void run_simulation_step(ApplicationState& state) {
+    void init_simulation_worker(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
-        if (!state.simulation.initialized || !sim_context.context) {
+        free_simulation_worker();
+
+        worker.atom_count = state.mold.mol.atom.count;
+        worker.ref_x = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+        worker.ref_y = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+        worker.ref_z = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+        worker.ref_valid = false;
+        for (auto& f : worker.frames) {
+            f.x = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+            f.y = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+            f.z = (float*)md_alloc(allocator, worker.atom_count * sizeof(float));
+            f.potential_energy = 0.0;
+            f.time = 0.0;
+            f.frame = 0;
+            f.generation = 0;
+        }
+        worker.back  = 0;
+        worker.front = 2;
+        worker.middle = 1;
+        worker.commands = 0;
+        worker.failed = false;
+        worker.exploded = false;
+        worker.generation = 0;
+        worker.applied_generation = 0;
+        worker.time = 0.0;
+        worker.frame = 0;
+        worker.step = 0;
+        post_parameters(state);
+#endif
+    }
+
+    void free_simulation_worker() {
+#ifdef VIAMD_ENABLE_OPENMM
+        stop_simulation_thread();
+        for (auto& f : worker.frames) {
+            if (f.x) {
+                md_free(allocator, f.x, worker.atom_count * sizeof(float));
+                md_free(allocator, f.y, worker.atom_count * sizeof(float));
+                md_free(allocator, f.z, worker.atom_count * sizeof(float));
+            }
+            f = {};
+        }
+        if (worker.ref_x) {
+            md_free(allocator, worker.ref_x, worker.atom_count * sizeof(float));
+            md_free(allocator, worker.ref_y, worker.atom_count * sizeof(float));
+            md_free(allocator, worker.ref_z, worker.atom_count * sizeof(float));
+        }
+        worker.ref_x = worker.ref_y = worker.ref_z = nullptr;
+        worker.atom_count = 0;
+        worker.reset_positions.clear();
+#endif
+    }
+
+    // Parameters are picked up by the simulation thread before its next batch of steps
+    void post_parameters(const ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.temperature = state.simulation.temperature;
+            worker.friction = state.simulation.friction;
+            worker.timestep = state.simulation.timestep;
+            worker.steps_per_update = MAX(1, state.simulation.steps_per_update);
+        }
+        worker.commands.fetch_or(SimulationCommand_UpdateParameters, std::memory_order_release);
+#endif
+    }
+
+    // Applies pending commands to the OpenMM context.
+    // Called from the simulation thread in between steps, or from the UI thread when the thread is not running.
+    void apply_simulation_commands() {
+#ifdef VIAMD_ENABLE_OPENMM
+        const uint32_t cmd = worker.commands.exchange(0, std::memory_order_acquire);
+        if (!cmd) return;
+
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (cmd & SimulationCommand_UpdateParameters) {
+            sim_context.integrator->setStepSize(worker.timestep);
+            if (auto* langevin = dynamic_cast<OpenMM::LangevinIntegrator*>(sim_context.integrator.get())) {
+                langevin->setTemperature(worker.temperature);
+                langevin->setFriction(worker.friction);
+            }
+        }
+        if (cmd & SimulationCommand_Reset) {
+            if (!worker.reset_positions.empty()) {
+                sim_context.context->setPositions(worker.reset_positions);
+            }
+            sim_context.context->setTime(0.0);
+            worker.time = 0.0;
+            worker.frame = 0;
+            worker.step = 0;
+            worker.applied_generation = worker.generation;
+            worker.ref_valid = false;
+        }
+#endif
+    }
+
+    void launch_simulation_thread(ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        if (!sim_context.context || !worker.frames[0].x) {
             return;
         }
-        
+
+        // A thread which exited on its own (failure or explosion) still has to be joined
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+
+        // A frame left over from the previous run carries timings from before the reset of perf.prev
+        discard_pending_frame();
+        worker.stop = false;
+        worker.ref_valid = false;
+        worker.timings = {};
+        perf.prev = {};
+        worker.active.store(true, std::memory_order_release);
+        worker.thread = std::thread([this]() {
+            simulation_thread_loop();
+            worker.active.store(false, std::memory_order_release);
+        });
+#endif
+    }
+
+    // Signals the simulation thread to exit after its current batch of steps and joins it
+    void stop_simulation_thread() {
+#ifdef VIAMD_ENABLE_OPENMM
+        worker.stop = true;
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+#endif
+    }
+
+    // Drops the completed frame waiting in 'middle' without consuming it. Only valid while the simulation thread is not running
+    void discard_pending_frame() {
+#ifdef VIAMD_ENABLE_OPENMM
+        ASSERT(!worker.thread.joinable());
+        worker.middle.fetch_and(~SimulationWorker::FRESH_BIT, std::memory_order_relaxed);
+#endif
+    }
+
+    void simulation_thread_loop() {
+#ifdef VIAMD_ENABLE_OPENMM
         try {
-            // Run simulation steps
-            sim_context.integrator->step(state.simulation.steps_per_update);
-            
-            // Get updated positions and check for explosion
-            // Use RAII and explicit memory isolation to prevent allocator conflicts
-            double current_energy = 0.0;
-            bool explosion_detected = false;
-            double max_coord = 0.0;
-            {
-                // Create OpenMM State object in isolated scope
-                OpenMM::State openmmState = sim_context.context->getState(OpenMM::State::Positions | OpenMM::State::Energy);
-                
-                // Extract data while OpenMM objects are still valid
-                const std::vector<OpenMM::Vec3>& positions = openmmState.getPositions();
-                current_energy = openmmState.getPotentialEnergy();
-                
-                // Check for simulation explosion (coordinates too large)
-                for (size_t i = 0; i < positions.size(); ++i) {
-                    double x = positions[i][0] * 10.0; // Convert to Angstroms
-                    double y = positions[i][1] * 10.0;
-                    double z = positions[i][2] * 10.0;
-                    
-                    double coord_magnitude = sqrt(x*x + y*y + z*z);
-                    max_coord = std::max(max_coord, coord_magnitude);
-                    
-                    // Check for explosion: coordinates > 50 Angstroms from origin (more sensitive)
-                    if (coord_magnitude > 50.0) {
-                        explosion_detected = true;
-                        break;
-                    }
-                }
-                
-                // Check for NaN or infinite values in energy
-                if (std::isnan(current_energy) || std::isinf(current_energy)) {
-                    explosion_detected = true;
+            const md_timestamp_t t_launch = md_time_current();
+            while (!worker.stop.load(std::memory_order_relaxed)) {
+                apply_simulation_commands();
+
+                int steps = 1;
+                double timestep = 0.0;
+                {
+                    std::lock_guard<std::mutex> lock(worker.mutex);
+                    steps = worker.steps_per_update;
+                    timestep = worker.timestep;
                 }
-                
-                if (!explosion_detected) {
-                    // Update VIAMD atom positions (convert from nm to Angstroms)
-                    // Add defensive checks to prevent segmentation faults
-                    if (state.mold.mol.atom.x && state.mold.mol.atom.y && state.mold.mol.atom.z && 
-                        state.mold.mol.atom.count > 0 && !positions.empty()) {
-                        
-                        size_t update_count = std::min(state.mold.mol.atom.count, positions.size());
-                        
-                        // Copy coordinates immediately to avoid holding references
-                        for (size_t i = 0; i < update_count; ++i) {
-                            state.mold.mol.atom.x[i] = static_cast<float>(positions[i][0] * 10.0);
-                            state.mold.mol.atom.y[i] = static_cast<float>(positions[i][1] * 10.0);
-                            state.mold.mol.atom.z[i] = static_cast<float>(positions[i][2] * 10.0);
-                        }
+
+                const md_timestamp_t t0 = md_time_current();
+                sim_context.integrator->step(steps);
+                const md_timestamp_t t1 = md_time_current();
+
+                SimulationFrame& dst = worker.frames[worker.back];
+                bool explosion_detected = false;
+                double current_energy = 0.0;
+                ConvertResult conv;
+                {
+                    OpenMM::State openmm_state = sim_context.context->getState(OpenMM::State::Positions | OpenMM::State::Energy);
+                    const std::vector<OpenMM::Vec3>& positions = openmm_state.getPositions();
+                    current_energy = openmm_state.getPotentialEnergy();
+
+                    // Displacement is measured against the previous frame rather than the origin, so large boxes are not flagged
+                    const size_t count = MIN(worker.atom_count, positions.size());
+                    if (worker.ref_valid) {
+                        conv = convert_positions<true>(dst.x, dst.y, dst.z, worker.ref_x, worker.ref_y, worker.ref_z, positions.data(), count);
                     } else {
-                        MD_LOG_ERROR("Invalid atom coordinate arrays detected during simulation update");
+                        conv = convert_positions<false>(dst.x, dst.y, dst.z, nullptr, nullptr, nullptr, positions.data(), count);
+                        MEMCPY(worker.ref_x, dst.x, count * sizeof(float));
+                        MEMCPY(worker.ref_y, dst.y, count * sizeof(float));
+                        MEMCPY(worker.ref_z, dst.z, count * sizeof(float));
+                        worker.ref_valid = true;
+                    }
+
+                    if (conv.non_finite || conv.max_disp2 > EXPLOSION_DISPLACEMENT * EXPLOSION_DISPLACEMENT ||
+                        std::isnan(current_energy) || std::isinf(current_energy)) {
+                        explosion_detected = true;
                     }
                 }
-                
-                // openmmState destructor will be called here - ensure complete cleanup
-            }
-            
-            // Force memory barrier to ensure OpenMM State object is completely destroyed
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            
-            // Handle explosion after OpenMM memory is fully released
-            if (explosion_detected) {
-                MD_LOG_ERROR("Simulation explosion detected! Max coordinate: %.3f Å, Energy: %.3f kJ/mol", 
-                            max_coord, current_energy);
-                MD_LOG_ERROR("Stopping simulation to prevent further instability");
-                state.simulation.running = false;
-                state.simulation.paused = false;
-                return;
+                const md_timestamp_t t2 = md_time_current();
+
+                if (explosion_detected) {
+                    worker.explosion_disp = conv.non_finite ? NAN : sqrt(conv.max_disp2);
+                    worker.explosion_atom = conv.max_idx;
+                    worker.explosion_energy = current_energy;
+                    worker.exploded.store(true, std::memory_order_release);
+                    break;
+                }
+
+                worker.time  += timestep * steps;
+                worker.frame += 1;
+                worker.step  += steps;
+
+                worker.timings.steps     += steps;
+                worker.timings.integrate += md_time_as_seconds(t1 - t0);
+                worker.timings.state     += md_time_as_seconds(t2 - t1);
+                worker.timings.wall       = md_time_as_seconds(t2 - t_launch);
+
+                dst.potential_energy = current_energy;
+                dst.time = worker.time;
+                dst.frame = worker.frame;
+                dst.step = worker.step;
+                dst.generation = worker.applied_generation;
+                dst.timings = worker.timings;
+
+                // Every published frame is offered to the writer, the UI thread may never see it
+                push_frame_to_writer(dst);
+
+                // Publish: hand the completed slot over to 'middle' and take the previous one back
+                worker.back = worker.middle.exchange(worker.back | SimulationWorker::FRESH_BIT, std::memory_order_acq_rel) & ~SimulationWorker::FRESH_BIT;
             }
-            
-            // Capture frame to internal storage (not the main trajectory)
-            capture_frame_to_internal_storage(state);
-            
-            // Mark buffers as dirty for visualization update
-            state.mold.dirty_buffers |= MolBit_DirtyPosition;
-            
-            // Update simulation state
-            state.simulation.current_frame++;
-            state.simulation.simulation_time += state.simulation.timestep * state.simulation.steps_per_update;
-            
         } catch (const std::exception& e) {
-            MD_LOG_ERROR("Simulation step failed: %s", e.what());
+            snprintf(worker.error, sizeof(worker.error), "%s", e.what());
+            worker.failed.store(true, std::memory_order_release);
+        }
+#endif
+    }
+
+    // Copies the latest completed frame (if any) into the molecule, never blocks on the simulation thread
+    void consume_simulation_frame(ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        if (worker.failed.exchange(false)) {
+            MD_LOG_ERROR("Simulation step failed: %s", worker.error);
+            state.simulation.running = false;
+            state.simulation.paused = false;
+        }
+
+        if (worker.exploded.exchange(false)) {
+            MD_LOG_ERROR("Simulation explosion detected! Max displacement: %.3f Å (atom %u), Energy: %.3f kJ/mol",
+                        worker.explosion_disp, worker.explosion_atom, worker.explosion_energy);
+            MD_LOG_ERROR("Stopping simulation to prevent further instability");
             state.simulation.running = false;
+            state.simulation.paused = false;
+        }
+
+        if (!(worker.middle.load(std::memory_order_relaxed) & SimulationWorker::FRESH_BIT)) {
+            return;
+        }
+        worker.front = worker.middle.exchange(worker.front, std::memory_order_acq_rel) & ~SimulationWorker::FRESH_BIT;
+
+        const SimulationFrame& src = worker.frames[worker.front];
+        if (src.generation != worker.generation) {
+            // Completed before the latest reset was applied
+            return;
+        }
+
+        const md_timestamp_t t0 = md_time_current();
+        if (state.mold.mol.atom.x && state.mold.mol.atom.y && state.mold.mol.atom.z &&
+            state.mold.mol.atom.count == worker.atom_count) {
+            const size_t bytes = worker.atom_count * sizeof(float);
+            MEMCPY(state.mold.mol.atom.x, src.x, bytes);
+            MEMCPY(state.mold.mol.atom.y, src.y, bytes);
+            MEMCPY(state.mold.mol.atom.z, src.z, bytes);
+        } else {
+            MD_LOG_ERROR("Invalid atom coordinate arrays detected during simulation update");
+            return;
         }
+
+        // Update simulation state
+        state.simulation.current_frame = (int)src.frame;
+        state.simulation.simulation_time = src.time;
+
+        // Capture frame to internal storage (not the main trajectory)
+        capture_frame_to_internal_storage(state);
+
+        // Mark buffers as dirty for visualization update
+        state.mold.dirty_buffers |= MolBit_DirtyPosition;
+
+        update_performance(state, src.timings, md_time_as_seconds(md_time_current() - t0));
 #endif
     }
 
+    void update_performance(ApplicationState& state, const SimulationTimings& t, double capture_time) {
+        perf.acc.steps     += t.steps     - perf.prev.steps;
+        perf.acc.integrate += t.integrate - perf.prev.integrate;
+        perf.acc.state     += t.state     - perf.prev.state;
+        perf.acc.wall      += t.wall      - perf.prev.wall;
+        perf.prev = t;
+        perf.acc_capture += capture_time;
+        perf.acc_upload  += state.simulation.upload_time;
+        perf.acc_frames  += 1;
+
+        if (perf.benchmark_active) {
+            perf.benchmark_capture += capture_time;
+            perf.benchmark_upload  += state.simulation.upload_time;
+            perf.benchmark_frames  += 1;
+            if (t.steps - perf.benchmark_start.steps >= perf.benchmark_steps) {
+                finish_benchmark(state, t);
+            }
+        }
+
+        if (perf.acc.wall < SimulationPerformance::SAMPLE_INTERVAL || perf.acc.steps == 0) {
+            return;
+        }
+
+        SimulationPerformance::Sample& cur = perf.current;
+        const double frames = (double)perf.acc_frames;
+        cur.steps_per_second = perf.acc.steps / perf.acc.wall;
+        // ps per step * steps per second * seconds per day, in ns
+        cur.ns_per_day = cur.steps_per_second * state.simulation.timestep * 86400.0 * 1e-3;
+        cur.integrate = 1000.0 * perf.acc.integrate / frames;
+        cur.state     = 1000.0 * perf.acc.state / frames;
+        cur.capture   = 1000.0 * perf.acc_capture / frames;
+        cur.upload    = 1000.0 * perf.acc_upload / frames;
+        state.simulation.steps_per_second = cur.steps_per_second;
+
+        const int i = (perf.history_offset + perf.history_count) % SimulationPerformance::HISTORY_SIZE;
+        perf.history_ns_per_day[i] = (float)cur.ns_per_day;
+        perf.history_integrate[i]  = (float)cur.integrate;
+        perf.history_state[i]      = (float)cur.state;
+        perf.history_capture[i]    = (float)cur.capture;
+        perf.history_upload[i]     = (float)cur.upload;
+        if (perf.history_count < SimulationPerformance::HISTORY_SIZE) {
+            perf.history_count += 1;
+        } else {
+            perf.history_offset = (perf.history_offset + 1) % SimulationPerformance::HISTORY_SIZE;
+        }
+
+        perf.acc = {};
+        perf.acc_capture = 0.0;
+        perf.acc_upload  = 0.0;
+        perf.acc_frames  = 0;
+    }
+
+    void clear_performance() {
+        perf.acc = {};
+        perf.acc_capture = 0.0;
+        perf.acc_upload  = 0.0;
+        perf.acc_frames  = 0;
+        perf.current = {};
+        perf.history_offset = 0;
+        perf.history_count  = 0;
+    }
+
+    // Fixed parameters so that runs on the bundled dataset (1ALA-500) are comparable between machines and builds
+    void start_benchmark(ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        state.simulation.running = false;
+        state.simulation.paused  = false;
+        stop_simulation_thread();
+
+        state.simulation.temperature = 300.0;
+        state.simulation.friction = 1.0;
+        state.simulation.timestep = 0.0005;
+        state.simulation.steps_per_update = 50;
+        sim_context.force_field_type = ForceFieldType::AMBER;
+        sim_context.force_field_name = "AMBER14";
+        sim_context.nonbonded_method = NonbondedMethod::PME;
+        sim_context.cutoff = 1.0;
+        sim_context.ewald_tolerance = 5e-4;
+
+        // Rebuild the system so that the force field and nonbonded settings take effect
+        if (state.simulation.initialized) {
+            cleanup_simulation(state);
+        }
+        setup_system(state);
+        if (!state.simulation.initialized) {
+            return;
+        }
+
+        clear_performance();
+        perf.benchmark_active = true;
+        perf.benchmark_start = {};
+        perf.benchmark_capture = 0.0;
+        perf.benchmark_upload  = 0.0;
+        perf.benchmark_frames  = 0;
+        perf.benchmark_result[0] = '\0';
+
+        state.simulation.running = true;
+        MD_LOG_INFO("OpenMM benchmark started: %lld steps", (long long)perf.benchmark_steps);
+#endif
+    }
+
+    void finish_benchmark(ApplicationState& state, const SimulationTimings& t) {
+        perf.benchmark_active = false;
+        state.simulation.running = false;
+
+        const double steps = (double)(t.steps - perf.benchmark_start.steps);
+        const double wall  = t.wall - perf.benchmark_start.wall;
+        const double frames = MAX(1, perf.benchmark_frames);
+        if (steps <= 0.0 || wall <= 0.0) return;
+
+        const double ns_per_day = (steps / wall) * state.simulation.timestep * 86400.0 * 1e-3;
+        snprintf(perf.benchmark_result, sizeof(perf.benchmark_result),
+            "%zu atoms, %.0f steps in %.2f s: %.2f ns/day, %.0f steps/s "
+            "(integrate %.1f%%, state %.1f%%, capture %.3f ms/frame, upload %.3f ms/frame)",
+            state.mold.mol.atom.count, steps, wall, ns_per_day, steps / wall,
+            100.0 * (t.integrate - perf.benchmark_start.integrate) / wall,
+            100.0 * (t.state - perf.benchmark_start.state) / wall,
+            1000.0 * perf.benchmark_capture / frames, 1000.0 * perf.benchmark_upload / frames);
+        MD_LOG_INFO("OpenMM benchmark [%s, %s threads]: %s", perf.platform_name.c_str(), perf.platform_threads.c_str(), perf.benchmark_result);
+    }
+
+    void query_platform_info() {
+#ifdef VIAMD_ENABLE_OPENMM
+        perf.platform_name.clear();
+        perf.platform_threads.clear();
+        if (!sim_context.context) return;
+        try {
+            OpenMM::Platform& platform = sim_context.context->getPlatform();
+            perf.platform_name = platform.getName();
+            // Only the CPU platform reports a thread count
+            const std::vector<std::string>& names = platform.getPropertyNames();
+            if (std::find(names.begin(), names.end(), "Threads") != names.end()) {
+                perf.platform_threads = platform.getPropertyValue(*sim_context.context, "Threads");
+            }
+        } catch (const std::exception& e) {
+            MD_LOG_DEBUG("Failed to query OpenMM platform properties: %s", e.what());
+        }
+#endif
+    }
+
+    void draw_performance_panel(ApplicationState& state) {
+        const SimulationPerformance::Sample& cur = perf.current;
+        ImGui::Text("Platform: %s", perf.platform_name.empty() ? "-" : perf.platform_name.c_str());
+        ImGui::Text("Threads: %s (task pool: %zu)", perf.platform_threads.empty() ? "-" : perf.platform_threads.c_str(), task_system::pool_num_threads());
+        ImGui::Text("Throughput: %.2f ns/day, %.0f steps/s", cur.ns_per_day, cur.steps_per_second);
+
+        const double total = cur.integrate + cur.state + cur.capture + cur.upload;
+        auto phase = [total](const char* label, double ms) {
+            ImGui::Text("%-10s %8.3f ms/frame (%5.1f%%)", label, ms, total > 0.0 ? 100.0 * ms / total : 0.0);
+        };
+        phase("Integrate", cur.integrate);
+        phase("getState",  cur.state);
+        phase("Capture",   cur.capture);
+        phase("Upload",    cur.upload);
+
+        if (perf.history_count > 1) {
+            const int count  = perf.history_count;
+            const int offset = perf.history_offset;
+            if (ImPlot::BeginPlot("##Throughput", ImVec2(-1, 150), ImPlotFlags_NoMenus)) {
+                ImPlot::SetupAxes("Sample", "ns/day", ImPlotAxisFlags_NoTickLabels, ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupAxis(ImAxis_Y2, "ms/frame", ImPlotAxisFlags_AuxDefault | ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupAxisLimits(ImAxis_X1, 0, SimulationPerformance::HISTORY_SIZE, ImPlotCond_Always);
+                ImPlot::PlotLine("ns/day", perf.history_ns_per_day, count, 1.0, 0.0, 0, offset);
+                ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+                ImPlot::PlotLine("Integrate", perf.history_integrate, count, 1.0, 0.0, 0, offset);
+                ImPlot::PlotLine("getState",  perf.history_state,     count, 1.0, 0.0, 0, offset);
+                ImPlot::PlotLine("Capture",   perf.history_capture,   count, 1.0, 0.0, 0, offset);
+                ImPlot::PlotLine("Upload",    perf.history_upload,    count, 1.0, 0.0, 0, offset);
+                ImPlot::EndPlot();
+            }
+        }
+
+        ImGui::Separator();
+        if (perf.benchmark_active) {
+            const int64_t done = perf.prev.steps - perf.benchmark_start.steps;
+            ImGui::ProgressBar((float)done / (float)perf.benchmark_steps, ImVec2(-1, 0), "Benchmark running...");
+        } else {
+            int steps = (int)perf.benchmark_steps;
+            if (ImGui::InputInt("Benchmark steps", &steps, 1000, 10000)) {
+                perf.benchmark_steps = CLAMP(steps, 1000, 1000000);
+            }
+            if (state.mold.mol.atom.count == 0) ImGui::BeginDisabled();
+            if (ImGui::Button("Run Benchmark")) {
+                start_benchmark(state);
+            }
+            if (state.mold.mol.atom.count == 0) ImGui::EndDisabled();
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Rebuilds the system with AMBER14, PME (1.0 nm cutoff), 0.5 fs timestep and 50 steps per update.\n"
+                                  "Use the bundled 1ALA-500 dataset for numbers comparable between machines.");
+            }
+        }
+        if (perf.benchmark_result[0]) {
+            ImGui::TextWrapped("Last benchmark: %s", perf.benchmark_result);
+        }
+    }
+
     void draw_simulation_window(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
         if (!ImGui::Begin("OpenMM Simulation", &state.simulation.show_window)) {
@@ -845,6 +1761,42 @@ public:
             }
         }
         
+        // Nonbonded treatment, changing it requires the system to be rebuilt
+        {
+            bool nonbonded_changed = false;
+            const char* nonbonded_items[] = { "Cutoff (non-periodic)", "Cutoff (periodic)", "PME" };
+            int current_nb = (int)sim_context.nonbonded_method;
+            if (ImGui::Combo("Nonbonded", &current_nb, nonbonded_items, IM_ARRAYSIZE(nonbonded_items))) {
+                sim_context.nonbonded_method = (NonbondedMethod)current_nb;
+                nonbonded_changed = true;
+            }
+            const bool has_cell = (state.mold.mol.unit_cell.flags & (MD_UNIT_CELL_FLAG_ORTHO | MD_UNIT_CELL_FLAG_TRICLINIC)) != 0;
+            if (sim_context.nonbonded_method != NonbondedMethod::CutoffNonPeriodic && !has_cell && ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("The loaded system has no unit cell, a non-periodic cutoff will be used");
+            }
+
+            float cutoff = (float)sim_context.cutoff;
+            if (ImGui::SliderFloat("Cutoff (nm)", &cutoff, 0.5f, 2.0f)) {
+                sim_context.cutoff = CLAMP(cutoff, 0.5f, 2.0f);
+            }
+            nonbonded_changed |= ImGui::IsItemDeactivatedAfterEdit();
+
+            if (sim_context.nonbonded_method == NonbondedMethod::PME) {
+                float tol = (float)sim_context.ewald_tolerance;
+                if (ImGui::SliderFloat("Ewald tolerance", &tol, 1e-5f, 1e-3f, "%.1e", ImGuiSliderFlags_Logarithmic)) {
+                    sim_context.ewald_tolerance = CLAMP(tol, 1e-5f, 1e-3f);
+                }
+                nonbonded_changed |= ImGui::IsItemDeactivatedAfterEdit();
+            }
+
+            if (nonbonded_changed && state.simulation.initialized) {
+                MD_LOG_INFO("Reinitializing system with new nonbonded settings...");
+                cleanup_simulation(state);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                setup_system(state);
+            }
+        }
+        
         ImGui::Separator();
 
         // System information
@@ -866,11 +1818,14 @@ public:
 
         // Simulation parameters
         if (ImGui::CollapsingHeader("Parameters", ImGuiTreeNodeFlags_DefaultOpen)) {
+            bool params_changed = false;
+
             float temp = static_cast<float>(state.simulation.temperature);
             if (ImGui::SliderFloat("Temperature (K)", &temp, 250.0f, 400.0f)) {
                 // Bounds checking for temperature
                 temp = std::max(250.0f, std::min(400.0f, temp));
                 state.simulation.temperature = temp;
+                params_changed = true;
             }
             
             float timestep = static_cast<float>(state.simulation.timestep);
@@ -879,6 +1834,7 @@ public:
                 // Max reduced to 0.001 ps for better stability
                 timestep = std::max(0.0001f, std::min(0.001f, timestep));
                 state.simulation.timestep = timestep;
+                params_changed = true;
             }
             
             float friction = static_cast<float>(state.simulation.friction);
@@ -886,14 +1842,24 @@ public:
                 // Constrain friction to reasonable range
                 friction = std::max(0.5f, std::min(5.0f, friction));
                 state.simulation.friction = friction;
+                params_changed = true;
             }
             
-            ImGui::SliderInt("Steps per update", &state.simulation.steps_per_update, 1, 50);
+            params_changed |= ImGui::SliderInt("Steps per update", &state.simulation.steps_per_update, 1, 50);
             
             // Add helpful tooltips for safety
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Lower values = smoother animation, higher values = faster simulation");
             }
+
+            if (params_changed && state.simulation.initialized) {
+                // Applied by the simulation thread before its next batch of steps
+                post_parameters(state);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Performance")) {
+            draw_performance_panel(state);
         }
 
         // Minimization panel
@@ -965,11 +1931,14 @@ public:
         ImGui::Separator();
         ImGui::Text("Trajectory Export");
         
-        size_t frame_count = md_array_size(internal_trajectory.stored_x);
-        ImGui::Text("Stored frames: %zu", frame_count);
+        size_t frame_count = internal_trajectory.count;
+        ImGui::Text("Stored frames: %zu / %zu", frame_count, internal_trajectory.capacity);
+        if (internal_trajectory.view_attached()) {
+            ImGui::Text("Attached as trajectory: %zu frames", internal_trajectory.snapshot.num_frames);
+        }
         
         if (frame_count > 0) {
-            if (ImGui::Button("Export to VIAMD Trajectory")) {
+            if (ImGui::Button(internal_trajectory.view_attached() ? "Refresh VIAMD Trajectory" : "Export to VIAMD Trajectory")) {
                 if (export_trajectory_to_viamd(state)) {
                     MD_LOG_INFO("Trajectory exported successfully");
                 } else {
@@ -978,7 +1947,6 @@ public:
             }
             ImGui::SameLine();
             if (ImGui::Button("Clear Stored Frames")) {
-                cleanup_internal_trajectory_capture(state);
                 init_internal_trajectory_capture(state);
                 MD_LOG_INFO("Internal trajectory storage cleared");
             }
@@ -986,6 +1954,29 @@ public:
             ImGui::TextDisabled("No frames stored");
         }
 
+        ImGui::Separator();
+        ImGui::Text("Stream to File (TRR)");
+        if (writer.file) {
+            ImGui::Text("Writing: %s", writer.path);
+            ImGui::Text("Frames written: %lld (dropped: %lld)", (long long)writer.frames_written.load(), (long long)writer.frames_dropped.load());
+            if (ImGui::Button("Stop Writing")) {
+                stop_trajectory_writer();
+            }
+        } else {
+            ImGui::SliderInt("Stride", &writer.stride, 1, 100);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Write every n:th simulation frame");
+            }
+            if (!state.simulation.initialized) ImGui::BeginDisabled();
+            if (ImGui::Button("Start Writing...")) {
+                char path_buf[1024];
+                if (application::file_dialog(path_buf, sizeof(path_buf), application::FileDialogFlag_Save, STR_LIT("trr"))) {
+                    start_trajectory_writer(state, path_buf);
+                }
+            }
+            if (!state.simulation.initialized) ImGui::EndDisabled();
+        }
+
         ImGui::End();
 #endif
     }
@@ -997,20 +1988,45 @@ public:
             state.simulation.paused = false;
             state.simulation.current_frame = 0;
             state.simulation.simulation_time = 0.0;
+
+            stop_simulation_thread();
             
             // Reset positions to initial state
-            set_positions(state);
+            post_reset(state);
+            apply_simulation_commands();
             
             MD_LOG_INFO("Simulation reset");
         }
 #endif
     }
 
+    // Resets the context to the current molecule coordinates, frames published before the reset are discarded
+    void post_reset(const ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.reset_positions.resize(state.mold.mol.atom.count);
+            for (size_t i = 0; i < state.mold.mol.atom.count; ++i) {
+                // Convert from Angstroms to nanometers
+                worker.reset_positions[i] = OpenMM::Vec3(state.mold.mol.atom.x[i] * 0.1, state.mold.mol.atom.y[i] * 0.1, state.mold.mol.atom.z[i] * 0.1);
+            }
+            worker.generation += 1;
+        }
+        worker.commands.fetch_or(SimulationCommand_Reset, std::memory_order_release);
+#endif
+    }
+
     void cleanup_simulation(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
         state.simulation.running = false;
         state.simulation.paused = false;
         state.simulation.initialized = false;
+
+        // The simulation thread must not touch the context while it is being destroyed
+        free_simulation_worker();
+
+        // Flush and close any file being streamed to
+        stop_trajectory_writer();
         
         // Clean up internal trajectory capture
         cleanup_internal_trajectory_capture(state);
@@ -1032,58 +2048,32 @@ public:
     void init_internal_trajectory_capture(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
         auto& capture = internal_trajectory;
-        
-        // Initialize arrays if not already done
-        if (!capture.stored_x) {
-            capture.stored_x = md_array_create(float*, capture.max_frames, allocator);
-            capture.stored_y = md_array_create(float*, capture.max_frames, allocator);
-            capture.stored_z = md_array_create(float*, capture.max_frames, allocator);
-            capture.frame_times = md_array_create(double, capture.max_frames, allocator);
-        }
-        
-        capture.atom_count = state.mold.mol.atom.count;
-        
-        // Clear existing frames
-        for (size_t i = 0; i < md_array_size(capture.stored_x); ++i) {
-            if (capture.stored_x[i]) {
-                md_free(allocator, capture.stored_x[i], capture.atom_count * sizeof(float));
-                md_free(allocator, capture.stored_y[i], capture.atom_count * sizeof(float));
-                md_free(allocator, capture.stored_z[i], capture.atom_count * sizeof(float));
-            }
+
+        const size_t atom_count = state.mold.mol.atom.count;
+        const size_t capacity   = (size_t)MAX(capture.max_frames, 1);
+
+        // (Re)allocate the ring only if its dimensions changed, otherwise just rewind it
+        if (!capture.x || capture.atom_count != atom_count || capture.capacity != capacity) {
+            cleanup_internal_trajectory_capture(state);
+            capture_ring_allocate(&capture, atom_count, capacity, allocator);
         }
+
+        capture.head  = 0;
+        capture.count = 0;
+        capture.unit_cell = state.mold.mol.unit_cell;
         
-        md_array_shrink(capture.stored_x, 0);
-        md_array_shrink(capture.stored_y, 0);
-        md_array_shrink(capture.stored_z, 0);
-        md_array_shrink(capture.frame_times, 0);
-        
-        MD_LOG_INFO("Internal trajectory capture initialized for %zu atoms", capture.atom_count);
+        MD_LOG_INFO("Internal trajectory capture initialized for %zu atoms (%zu frames, %.1f MB)", capture.atom_count, capture.capacity,
+                    (double)(capture.capacity * capture.atom_count * 3 * sizeof(float)) / (1024.0 * 1024.0));
 #endif
     }
 
     void cleanup_internal_trajectory_capture(ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
         auto& capture = internal_trajectory;
-        
-        // Free stored coordinate arrays
-        for (size_t i = 0; i < md_array_size(capture.stored_x); ++i) {
-            if (capture.stored_x[i]) {
-                md_free(allocator, capture.stored_x[i], capture.atom_count * sizeof(float));
-                md_free(allocator, capture.stored_y[i], capture.atom_count * sizeof(float));
-                md_free(allocator, capture.stored_z[i], capture.atom_count * sizeof(float));
-            }
-        }
-        
-        md_array_free(capture.stored_x, allocator);
-        md_array_free(capture.stored_y, allocator);
-        md_array_free(capture.stored_z, allocator);
-        md_array_free(capture.frame_times, allocator);
-        
-        capture.stored_x = nullptr;
-        capture.stored_y = nullptr;
-        capture.stored_z = nullptr;
-        capture.frame_times = nullptr;
-        capture.atom_count = 0;
+
+        // The attached snapshot belongs to the old topology
+        detach_trajectory_view();
+        capture_ring_free(&capture, allocator);
 #endif
     }
 
@@ -1091,63 +2081,22 @@ public:
 #ifdef VIAMD_ENABLE_OPENMM
         auto& capture = internal_trajectory;
         
-        if (!capture.enabled || capture.atom_count != state.mold.mol.atom.count) {
+        if (!capture.enabled || !capture.x || capture.atom_count != state.mold.mol.atom.count) {
             return;
         }
-        
-        // Remove oldest frame if we've reached max capacity
-        if (md_array_size(capture.stored_x) >= (size_t)capture.max_frames) {
-            // Free the oldest frame's memory
-            md_free(allocator, capture.stored_x[0], capture.atom_count * sizeof(float));
-            md_free(allocator, capture.stored_y[0], capture.atom_count * sizeof(float));
-            md_free(allocator, capture.stored_z[0], capture.atom_count * sizeof(float));
-            
-            // Shift all frames down by one position
-            for (size_t i = 1; i < md_array_size(capture.stored_x); ++i) {
-                capture.stored_x[i-1] = capture.stored_x[i];
-                capture.stored_y[i-1] = capture.stored_y[i];
-                capture.stored_z[i-1] = capture.stored_z[i];
-                capture.frame_times[i-1] = capture.frame_times[i];
-            }
-            
-            // Resize arrays to remove the last element
-            md_array_shrink(capture.stored_x, md_array_size(capture.stored_x) - 1);
-            md_array_shrink(capture.stored_y, md_array_size(capture.stored_y) - 1);
-            md_array_shrink(capture.stored_z, md_array_size(capture.stored_z) - 1);
-            md_array_shrink(capture.frame_times, md_array_size(capture.frame_times) - 1);
-        }
-        
-        // Allocate memory for new frame
-        float* x_frame = (float*)md_alloc(allocator, capture.atom_count * sizeof(float));
-        float* y_frame = (float*)md_alloc(allocator, capture.atom_count * sizeof(float));
-        float* z_frame = (float*)md_alloc(allocator, capture.atom_count * sizeof(float));
-        
-        // Copy current positions with defensive checks
-        if (state.mold.mol.atom.x && state.mold.mol.atom.y && state.mold.mol.atom.z) {
-            for (size_t i = 0; i < capture.atom_count; ++i) {
-                x_frame[i] = state.mold.mol.atom.x[i];
-                y_frame[i] = state.mold.mol.atom.y[i];
-                z_frame[i] = state.mold.mol.atom.z[i];
-            }
-        } else {
+
+        if (!state.mold.mol.atom.x || !state.mold.mol.atom.y || !state.mold.mol.atom.z) {
             MD_LOG_ERROR("Invalid atom coordinate arrays during trajectory capture");
-            md_free(allocator, x_frame, capture.atom_count * sizeof(float));
-            md_free(allocator, y_frame, capture.atom_count * sizeof(float));
-            md_free(allocator, z_frame, capture.atom_count * sizeof(float));
             return;
         }
         
-        // Store the frame
-        md_array_push(capture.stored_x, x_frame, allocator);
-        md_array_push(capture.stored_y, y_frame, allocator);
-        md_array_push(capture.stored_z, z_frame, allocator);
-        md_array_push(capture.frame_times, state.simulation.simulation_time, allocator);
+        capture_ring_push(&capture, state.mold.mol.atom.x, state.mold.mol.atom.y, state.mold.mol.atom.z, state.simulation.simulation_time);
 #endif
     }
 
     size_t get_simulation_frame_count(const ApplicationState& state) {
 #ifdef VIAMD_ENABLE_OPENMM
-        return md_array_size(internal_trajectory.stored_x);
+        return internal_trajectory.count;
 #else
         return 0;
 #endif
@@ -1157,17 +2106,16 @@ public:
 #ifdef VIAMD_ENABLE_OPENMM
         const auto& capture = internal_trajectory;
         
-        if (frame_idx >= md_array_size(capture.stored_x) || capture.atom_count != state.mold.mol.atom.count) {
+        if (frame_idx >= capture.count || capture.atom_count != state.mold.mol.atom.count) {
             return false;
         }
         
         // Load the requested frame's coordinates with defensive checks
         if (state.mold.mol.atom.x && state.mold.mol.atom.y && state.mold.mol.atom.z) {
-            for (size_t i = 0; i < capture.atom_count; ++i) {
-                state.mold.mol.atom.x[i] = capture.stored_x[frame_idx][i];
-                state.mold.mol.atom.y[i] = capture.stored_y[frame_idx][i];
-                state.mold.mol.atom.z[i] = capture.stored_z[frame_idx][i];
-            }
+            const size_t bytes = capture.atom_count * sizeof(float);
+            MEMCPY(state.mold.mol.atom.x, capture.frame_x(frame_idx), bytes);
+            MEMCPY(state.mold.mol.atom.y, capture.frame_y(frame_idx), bytes);
+            MEMCPY(state.mold.mol.atom.z, capture.frame_z(frame_idx), bytes);
         } else {
             MD_LOG_ERROR("Invalid atom coordinate arrays during trajectory load");
             return false;
@@ -1182,73 +2130,201 @@ public:
 #endif
     }
 
-    bool export_trajectory_to_viamd(ApplicationState& state) {
+    bool start_trajectory_writer(const ApplicationState& state, const char* path) {
 #ifdef VIAMD_ENABLE_OPENMM
-        const auto& capture = internal_trajectory;
-        size_t num_frames = md_array_size(capture.stored_x);
-        
-        if (num_frames == 0) {
-            MD_LOG_ERROR("No simulation frames to export");
+        stop_trajectory_writer();
+
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            MD_LOG_ERROR("Failed to open file for writing: '%s'", path);
             return false;
         }
-        
-        MD_LOG_INFO("Exporting %zu simulation frames to viamd trajectory", num_frames);
-        
-        // For now, we'll copy the frames back to the ApplicationState's trajectory capture
-        // This is a simple way to make the frames available to viamd's trajectory system
-        // A full implementation would create a proper md_trajectory_i
-        auto& target_capture = state.simulation.trajectory_capture;
-        
-        // Initialize target if needed
-        if (!target_capture.stored_x) {
-            target_capture.stored_x = md_array_create(float*, num_frames, state.allocator.persistent);
-            target_capture.stored_y = md_array_create(float*, num_frames, state.allocator.persistent);
-            target_capture.stored_z = md_array_create(float*, num_frames, state.allocator.persistent);
-            target_capture.frame_times = md_array_create(double, num_frames, state.allocator.persistent);
-        } else {
-            // Clear existing data
-            for (size_t i = 0; i < md_array_size(target_capture.stored_x); ++i) {
-                if (target_capture.stored_x[i]) {
-                    md_free(state.allocator.persistent, target_capture.stored_x[i], target_capture.atom_count * sizeof(float));
-                    md_free(state.allocator.persistent, target_capture.stored_y[i], target_capture.atom_count * sizeof(float));
-                    md_free(state.allocator.persistent, target_capture.stored_z[i], target_capture.atom_count * sizeof(float));
-                }
+
+        writer.file = file;
+        snprintf(writer.path, sizeof(writer.path), "%s", path);
+        writer.stride = MAX(1, writer.stride);
+        writer.atom_count = state.mold.mol.atom.count;
+        writer.unit_cell = state.mold.mol.unit_cell;
+        for (auto& f : writer.queue) {
+            f.x = (float*)md_alloc(allocator, writer.atom_count * sizeof(float));
+            f.y = (float*)md_alloc(allocator, writer.atom_count * sizeof(float));
+            f.z = (float*)md_alloc(allocator, writer.atom_count * sizeof(float));
+        }
+        writer.encode_cap = trr_frame_size(writer.atom_count);
+        writer.encode_buf = (uint8_t*)md_alloc(allocator, writer.encode_cap);
+        writer.write_idx = 0;
+        writer.read_idx = 0;
+        writer.frames_written = 0;
+        writer.frames_dropped = 0;
+        writer.failed = false;
+        writer.step_overflow = false;
+        writer.stop = false;
+        writer.thread = std::thread([this]() {
+            writer_thread_loop();
+        });
+
+        {
+            // From here on the simulation thread may queue frames
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            writer.frames_seen = 0;
+            writer.active = true;
+        }
+
+        MD_LOG_INFO("Streaming simulation frames to '%s' (stride %d)", writer.path, writer.stride);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void stop_trajectory_writer() {
+#ifdef VIAMD_ENABLE_OPENMM
+        if (!writer.file) return;
+
+        {
+            // Once active is cleared the simulation thread no longer touches the queue
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            writer.active = false;
+            writer.stop = true;
+        }
+        // The writer thread writes whatever is left in the queue before it exits
+        writer.wake.notify_one();
+        if (writer.thread.joinable()) {
+            writer.thread.join();
+        }
+
+        fclose(writer.file);
+        writer.file = nullptr;
+
+        for (auto& f : writer.queue) {
+            md_free(allocator, f.x, writer.atom_count * sizeof(float));
+            md_free(allocator, f.y, writer.atom_count * sizeof(float));
+            md_free(allocator, f.z, writer.atom_count * sizeof(float));
+            f = {};
+        }
+        md_free(allocator, writer.encode_buf, writer.encode_cap);
+        writer.encode_buf = nullptr;
+        writer.encode_cap = 0;
+
+        MD_LOG_INFO("Finished writing %lld frames to '%s' (dropped: %lld)", (long long)writer.frames_written.load(), writer.path, (long long)writer.frames_dropped.load());
+#endif
+    }
+
+    // Reports writer failures on the UI thread, the writer and simulation threads cannot stop the writer themselves
+    void poll_trajectory_writer() {
+#ifdef VIAMD_ENABLE_OPENMM
+        if (!writer.file) return;
+
+        if (writer.step_overflow.exchange(false)) {
+            MD_LOG_INFO("Simulation step exceeds the range of the TRR header in '%s', the step is saturated (frame times are exact)", writer.path);
+        }
+
+        if (writer.failed) {
+            MD_LOG_ERROR("Failed to write simulation frame to '%s', stopping", writer.path);
+            stop_trajectory_writer();
+        }
+#endif
+    }
+
+    void writer_thread_loop() {
+#ifdef VIAMD_ENABLE_OPENMM
+        std::unique_lock<std::mutex> lock(writer.mutex);
+        while (true) {
+            writer.wake.wait(lock, [this]() {
+                return writer.stop || writer.read_idx.load(std::memory_order_relaxed) != writer.write_idx.load(std::memory_order_acquire);
+            });
+            lock.unlock();
+            drain_writer_queue();
+            lock.lock();
+            if (writer.stop && writer.read_idx.load(std::memory_order_relaxed) == writer.write_idx.load(std::memory_order_acquire)) {
+                break;
             }
-            md_array_shrink(target_capture.stored_x, 0);
-            md_array_shrink(target_capture.stored_y, 0);
-            md_array_shrink(target_capture.stored_z, 0);
-            md_array_shrink(target_capture.frame_times, 0);
-        }
-        
-        target_capture.atom_count = capture.atom_count;
-        target_capture.max_frames = (int)num_frames;
-        target_capture.enabled = true;
-        
-        // Copy all frames from internal storage to trajectory capture
-        for (size_t i = 0; i < num_frames; ++i) {
-            // Allocate memory for frame
-            float* x_frame = (float*)md_alloc(state.allocator.persistent, capture.atom_count * sizeof(float));
-            float* y_frame = (float*)md_alloc(state.allocator.persistent, capture.atom_count * sizeof(float));
-            float* z_frame = (float*)md_alloc(state.allocator.persistent, capture.atom_count * sizeof(float));
-            
-            // Copy coordinates
-            for (size_t j = 0; j < capture.atom_count; ++j) {
-                x_frame[j] = capture.stored_x[i][j];
-                y_frame[j] = capture.stored_y[i][j];
-                z_frame[j] = capture.stored_z[i][j];
+        }
+#endif
+    }
+
+    // Only called by the writer thread
+    void drain_writer_queue() {
+#ifdef VIAMD_ENABLE_OPENMM
+        uint32_t r = writer.read_idx.load(std::memory_order_relaxed);
+        while (r != writer.write_idx.load(std::memory_order_acquire)) {
+            const TrajectoryWriter::Frame& f = writer.queue[r % TrajectoryWriter::QUEUE_SIZE];
+            if (!writer.failed) {
+                bool overflow = false;
+                const size_t bytes = trr_encode_frame(writer.encode_buf, f.x, f.y, f.z, writer.atom_count, f.step, f.time, f.unit_cell, &overflow);
+                if (overflow) {
+                    writer.step_overflow = true;
+                }
+                if (fwrite(writer.encode_buf, 1, bytes, writer.file) != bytes || fflush(writer.file) != 0) {
+                    writer.failed = true;
+                } else {
+                    writer.frames_written += 1;
+                }
             }
-            
-            // Store the frame
-            md_array_push(target_capture.stored_x, x_frame, state.allocator.persistent);
-            md_array_push(target_capture.stored_y, y_frame, state.allocator.persistent);
-            md_array_push(target_capture.stored_z, z_frame, state.allocator.persistent);
-            md_array_push(target_capture.frame_times, capture.frame_times[i], state.allocator.persistent);
+            r += 1;
+            writer.read_idx.store(r, std::memory_order_release);
         }
+#endif
+    }
+
+    // Called by the simulation thread for every frame it publishes, never waits for the writer
+    void push_frame_to_writer(const SimulationFrame& src) {
+#ifdef VIAMD_ENABLE_OPENMM
+        {
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            if (!writer.active || writer.failed) return;
+            if (writer.atom_count != worker.atom_count) return;
+            if (writer.frames_seen++ % writer.stride != 0) return;
+
+            const uint32_t w = writer.write_idx.load(std::memory_order_relaxed);
+            if (w - writer.read_idx.load(std::memory_order_acquire) == TrajectoryWriter::QUEUE_SIZE) {
+                writer.frames_dropped += 1;
+                return;
+            }
+
+            TrajectoryWriter::Frame& f = writer.queue[w % TrajectoryWriter::QUEUE_SIZE];
+            const size_t bytes = writer.atom_count * sizeof(float);
+            MEMCPY(f.x, src.x, bytes);
+            MEMCPY(f.y, src.y, bytes);
+            MEMCPY(f.z, src.z, bytes);
+            f.unit_cell = writer.unit_cell;
+            f.time = src.time;
+            f.step = src.step;
+            writer.write_idx.store(w + 1, std::memory_order_release);
+        }
+        writer.wake.notify_one();
+#endif
+    }
+
+    // Hands the captured frames to VIAMD as its trajectory, without copying them
+    bool export_trajectory_to_viamd(ApplicationState& state) {
+#ifdef VIAMD_ENABLE_OPENMM
+        auto& capture = internal_trajectory;
         
-        MD_LOG_INFO("Successfully exported %zu frames to viamd trajectory", num_frames);
-        
-        // Trigger trajectory initialization event
-        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryInit, viamd::EventPayloadType_Undefined, &state);
+        if (capture.count == 0) {
+            MD_LOG_ERROR("No simulation frames to export");
+            return false;
+        }
+
+        if (capture.atom_count != state.mold.mol.atom.count) {
+            MD_LOG_ERROR("Simulation frames are not compatible with the loaded molecule");
+            return false;
+        }
+
+        // Copy the ring into logical order, VIAMD may load frames on worker threads while the simulation keeps capturing
+        capture_ring_attach(&capture, allocator, close_trajectory_view);
+        CaptureSnapshot& snap = capture.snapshot;
+
+        md_trajectory_i* traj = load::traj::open_trajectory(&capture.view, capture_traj_loader(), &state.mold.mol, state.allocator.persistent, LoadTrajectoryFlag_InMemory);
+        if (!traj) {
+            free_capture_snapshot(&snap);
+            return false;
+        }
+
+        MD_LOG_INFO("Attached %zu simulation frames as viamd trajectory", snap.num_frames);
+
+        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryReplace, viamd::EventPayloadType_Trajectory, traj);
+        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryInit, viamd::EventPayloadType_ApplicationState, &state);
         
         return true;
 #else
@@ -1256,26 +2332,24 @@ public:
 #endif
     }
 
-    uint8_t get_atomic_number_from_atom_type(const md_label_t& atom_type) {
+    // VIAMD closes the view through the loader, which releases the snapshot
+    static void close_trajectory_view() {
+        viamd::event_system_broadcast_event(viamd::EventType_ViamdTrajectoryReplace, viamd::EventPayloadType_Trajectory, nullptr);
+    }
+
+    void detach_trajectory_view() {
+#ifdef VIAMD_ENABLE_OPENMM
+        capture_ring_detach(&internal_trajectory, close_trajectory_view);
+#endif
+    }
+
+    uint8_t get_atomic_number_from_atom_type(const md_label_t& atom_type) const {
         // Convert atom type label to atomic number
         const char* type_str = atom_type.buf;
-        
-        // Simple mapping based on common element symbols
-        if (strncmp(type_str, "H", 1) == 0) return 1;
-        if (strncmp(type_str, "C", 1) == 0) return 6;
-        if (strncmp(type_str, "N", 1) == 0) return 7;
-        if (strncmp(type_str, "O", 1) == 0) return 8;
-        if (strncmp(type_str, "P", 1) == 0) return 15;
-        if (strncmp(type_str, "S", 1) == 0) return 16;
-        if (strncmp(type_str, "Cl", 2) == 0) return 17;
-        if (strncmp(type_str, "Na", 2) == 0) return 11;
-        if (strncmp(type_str, "Mg", 2) == 0) return 12;
-        if (strncmp(type_str, "Ca", 2) == 0) return 20;
-        if (strncmp(type_str, "Fe", 2) == 0) return 26;
-        if (strncmp(type_str, "Zn", 2) == 0) return 30;
+        uint8_t atomic_number = atomic_number_from_symbol(type_str, strnlen(type_str, sizeof(atom_type.buf)));
         
         // Default to carbon if unknown
-        return 6;
+        return atomic_number ? atomic_number : 6;
     }
 
     double get_atomic_mass(uint8_t atomic_number) {
@@ -1308,7 +2382,7 @@ public:
         return 12.011; // Default to carbon mass
     }
 
-    std::string map_to_amber_type(const md_label_t& atom_type, uint8_t atomic_number, const std::vector<uint32_t>& bonded_atoms, ApplicationState& state) {
+    std::string map_to_amber_type(const md_label_t& atom_type, uint8_t atomic_number, size_t num_bonded) {
         // Convert VIAMD atom type to AMBER atom type based on chemical environment
         const char* type_str = atom_type.buf;
         
@@ -1327,14 +2401,14 @@ public:
         case 1: // Hydrogen
             return "H";  // Generic hydrogen, could be refined based on bonding
         case 6: // Carbon
-            if (bonded_atoms.size() == 4) return "CA";  // sp3 carbon (approximation)
-            if (bonded_atoms.size() == 3) return "C";   // sp2 carbon (approximation)
+            if (num_bonded == 4) return "CA";  // sp3 carbon (approximation)
+            if (num_bonded == 3) return "C";   // sp2 carbon (approximation)
             return "C*";  // Generic carbon
         case 7: // Nitrogen
             return "N";   // Generic nitrogen
         case 8: // Oxygen
-            if (bonded_atoms.size() == 1) return "O";   // Carbonyl oxygen
-            if (bonded_atoms.size() == 2) return "OH";  // Hydroxyl oxygen
+            if (num_bonded == 1) return "O";   // Carbonyl oxygen
+            if (num_bonded == 2) return "OH";  // Hydroxyl oxygen
             return "O*";  // Generic oxygen
         case 16: // Sulfur
             return "SH";  // Sulfur (thiol)
@@ -1813,7 +2887,7 @@ public:
         return {2.09200, 0.0, 3};  // Generic torsion with 3-fold symmetry
     }
 
-    std::string map_to_uff_type(const md_label_t& atom_type, uint8_t atomic_number, const std::vector<uint32_t>& bonded_atoms, ApplicationState& state) {
+    std::string map_to_uff_type(const md_label_t& atom_type, uint8_t atomic_number, size_t num_bonded) {
         // Convert VIAMD atom type to UFF atom type based on chemical environment
         
         // Element-based mapping with chemical environment consideration
@@ -1821,18 +2895,18 @@ public:
         case 1: // Hydrogen
             return "H_";
         case 6: // Carbon
-            if (bonded_atoms.size() == 4) return "C_3";  // sp3 carbon
-            if (bonded_atoms.size() == 3) return "C_2";  // sp2 carbon
-            if (bonded_atoms.size() == 2) return "C_1";  // sp carbon
+            if (num_bonded == 4) return "C_3";  // sp3 carbon
+            if (num_bonded == 3) return "C_2";  // sp2 carbon
+            if (num_bonded == 2) return "C_1";  // sp carbon
             return "C_3";  // Default to sp3
         case 7: // Nitrogen
-            if (bonded_atoms.size() == 4) return "N_3";  // sp3 nitrogen
-            if (bonded_atoms.size() == 3) return "N_2";  // sp2 nitrogen
-            if (bonded_atoms.size() == 2) return "N_1";  // sp nitrogen
+            if (num_bonded == 4) return "N_3";  // sp3 nitrogen
+            if (num_bonded == 3) return "N_2";  // sp2 nitrogen
+            if (num_bonded == 2) return "N_1";  // sp nitrogen
             return "N_3";  // Default to sp3
         case 8: // Oxygen
-            if (bonded_atoms.size() == 1) return "O_2";  // Carbonyl oxygen
-            if (bonded_atoms.size() == 2) return "O_3";  // sp3 oxygen
+            if (num_bonded == 1) return "O_2";  // Carbonyl oxygen
+            if (num_bonded == 2) return "O_3";  // sp3 oxygen
             return "O_3";  // Default to sp3
         case 9: // Fluorine
             return "F_";
@@ -1841,7 +2915,7 @@ public:
         case 15: // Phosphorus
             return "P_3";
         case 16: // Sulfur
-            if (bonded_atoms.size() == 1) return "S_2";  // S=O, etc.
+            if (num_bonded == 1) return "S_2";  // S=O, etc.
             return "S_3";  // Default to sp3
         case 17: // Chlorine
             return "Cl";
@@ -13,6 +13,7 @@
 #endif
 
 #include <viamd.h>
+#include <memory_budget.h>
 
 #include <core/md_common.h>
 #include <core/md_allocator.h>
@@ -21,6 +22,7 @@
 #include <core/md_vec_math.h>
 #include <core/md_array.h>
 #include <core/md_bitfield.h>
+#include <core/md_os.h>
 #include <md_molecule.h>
 
 #include "gfx/gl.h"
@@ -457,6 +459,9 @@ struct Ramachandran : viamd::EventHandler {
     GLuint fbo = 0;
     GLuint vao = 0;
 
+    // The GL resources and the reference densities are created the first time the window is shown
+    bool gl_initialized = false;
+
     char input[256] = "all";
     char error[256] = "";
 
@@ -513,7 +518,15 @@ struct Ramachandran : viamd::EventHandler {
 
     md_allocator_i* arena = 0;
 
-    Ramachandran() { viamd::event_system_register_handler(*this); }
+    Ramachandran() {
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdTopologyInit,
+            viamd::EventType_ViamdWindowDrawMenu,
+        }, "Ramachandran");
+    }
 
     void process_events(const viamd::Event* events, size_t num_events) final {
         for (size_t i = 0; i < num_events; ++i) {
@@ -548,7 +561,11 @@ struct Ramachandran : viamd::EventHandler {
     }
 
     void initialize(ApplicationState& state) {
-        arena = md_arena_allocator_create(state.allocator.persistent, MEGABYTES(1));
+        arena = md_arena_allocator_create(memory_budget::create_allocator("Ramachandran", state.allocator.persistent), MEGABYTES(1));
+    }
+
+    void initialize_gl() {
+        const md_timestamp_t t0 = md_time_current();
 
         if (!map.program) {
             GLuint v_shader = gl::compile_shader_from_source(v_fs_quad_src, GL_VERTEX_SHADER);
@@ -607,12 +624,17 @@ struct Ramachandran : viamd::EventHandler {
         rama_rep_init(&rama_data.filt);
 
         rama_init_ref(&rama_data.ref);
+
+        gl_initialized = true;
+        MD_LOG_DEBUG("Ramachandran: Initialized shaders and reference densities in %.2f ms", md_time_as_seconds(md_time_current() - t0) * 1000.0);
     }
 
     void shutdown() {
-        rama_rep_free(&rama_data.ref);
-        rama_rep_free(&rama_data.full);
-        rama_rep_free(&rama_data.filt);
+        if (gl_initialized) {
+            rama_rep_free(&rama_data.ref);
+            rama_rep_free(&rama_data.full);
+            rama_rep_free(&rama_data.filt);
+        }
 
         if (fbo) glDeleteFramebuffers(1, &fbo);
         if (vao) glDeleteVertexArrays(1, &vao);
@@ -650,6 +672,10 @@ struct Ramachandran : viamd::EventHandler {
     }
 
     void update(ApplicationState& state) {
+        if (show_window && !gl_initialized) {
+            initialize_gl();
+        }
+
         if (show_window && state.mold.mol.protein_backbone.count > 0) {
             const size_t num_frames = md_trajectory_num_frames(state.mold.traj);
             if (num_frames > 0) {
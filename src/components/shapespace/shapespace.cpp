@@ -17,10 +17,14 @@
 
 #include <viamd.h>
 #include <serialization_utils.h>
+#include <memory_budget.h>
 #include <imgui_widgets.h>
 #include <implot_widgets.h>
 #include <implot_internal.h>
 
+#include <atomic>
+#include <algorithm>
+
 /*
     @NOTE:
     It would be nice to have a colormap applied to the points in the plot where they are graded by t=time
@@ -39,6 +43,156 @@ static const char* colormode_lbl[] = {
     "Colormap",
 };
 
+// Number of independent accumulators used in the fused covariance pass, this maps onto the width of a 256-bit register
+#define COV_LANES 8
+
+// Symmetric 3x3 covariance matrices for a batch of structures, stored as SoA of the six unique elements
+struct CovarianceBatch {
+    float* xx;
+    float* yy;
+    float* zz;
+    float* xy;
+    float* xz;
+    float* yz;
+};
+
+// Computes the weighted covariance of the gathered atoms in a single pass over the coordinates.
+// The coordinates are deperiodized against the first atom using the minimum image convention (orthorhombic or no cell)
+// and the center of mass and covariance are accumulated simultaneously as first and second order moments.
+// Accumulating relative to the reference atom keeps the magnitudes small and avoids cancellation when forming E[xx] - E[x]E[x].
+// A zero extent in 'box' disables the periodic wrapping in that dimension.
+static void compute_covariance_fused(CovarianceBatch* out, size_t out_idx, const float* x, const float* y, const float* z, const int32_t* idx, const float* w, size_t count, vec3_t box) {
+    const float ext[3] = {box.x, box.y, box.z};
+    const float inv[3] = {box.x > 0 ? 1.0f / box.x : 0.0f, box.y > 0 ? 1.0f / box.y : 0.0f, box.z > 0 ? 1.0f / box.z : 0.0f};
+
+    if (count == 0) {
+        out->xx[out_idx] = out->yy[out_idx] = out->zz[out_idx] = 0.0f;
+        out->xy[out_idx] = out->xz[out_idx] = out->yz[out_idx] = 0.0f;
+        return;
+    }
+
+    const float rx = x[idx[0]];
+    const float ry = y[idx[0]];
+    const float rz = z[idx[0]];
+
+    float s_w[COV_LANES]  = {0};
+    float s_x[COV_LANES]  = {0}, s_y[COV_LANES]  = {0}, s_z[COV_LANES]  = {0};
+    float s_xx[COV_LANES] = {0}, s_yy[COV_LANES] = {0}, s_zz[COV_LANES] = {0};
+    float s_xy[COV_LANES] = {0}, s_xz[COV_LANES] = {0}, s_yz[COV_LANES] = {0};
+
+    size_t i = 0;
+    const size_t simd_count = count & ~(size_t)(COV_LANES - 1);
+    for (; i < simd_count; i += COV_LANES) {
+        for (size_t l = 0; l < COV_LANES; ++l) {
+            const int32_t j = idx[i + l];
+            float dx = x[j] - rx;
+            float dy = y[j] - ry;
+            float dz = z[j] - rz;
+            dx -= ext[0] * floorf(dx * inv[0] + 0.5f);
+            dy -= ext[1] * floorf(dy * inv[1] + 0.5f);
+            dz -= ext[2] * floorf(dz * inv[2] + 0.5f);
+            const float m = w[i + l];
+            s_w[l]  += m;
+            s_x[l]  += m * dx;
+            s_y[l]  += m * dy;
+            s_z[l]  += m * dz;
+            s_xx[l] += m * dx * dx;
+            s_yy[l] += m * dy * dy;
+            s_zz[l] += m * dz * dz;
+            s_xy[l] += m * dx * dy;
+            s_xz[l] += m * dx * dz;
+            s_yz[l] += m * dy * dz;
+        }
+    }
+    for (; i < count; ++i) {
+        const int32_t j = idx[i];
+        float dx = x[j] - rx;
+        float dy = y[j] - ry;
+        float dz = z[j] - rz;
+        dx -= ext[0] * floorf(dx * inv[0] + 0.5f);
+        dy -= ext[1] * floorf(dy * inv[1] + 0.5f);
+        dz -= ext[2] * floorf(dz * inv[2] + 0.5f);
+        const float m = w[i];
+        s_w[0]  += m;
+        s_x[0]  += m * dx;
+        s_y[0]  += m * dy;
+        s_z[0]  += m * dz;
+        s_xx[0] += m * dx * dx;
+        s_yy[0] += m * dy * dy;
+        s_zz[0] += m * dz * dz;
+        s_xy[0] += m * dx * dy;
+        s_xz[0] += m * dx * dz;
+        s_yz[0] += m * dy * dz;
+    }
+
+    // Reduce lanes in double precision
+    double sw = 0, sx = 0, sy = 0, sz = 0, sxx = 0, syy = 0, szz = 0, sxy = 0, sxz = 0, syz = 0;
+    for (size_t l = 0; l < COV_LANES; ++l) {
+        sw  += s_w[l];
+        sx  += s_x[l];
+        sy  += s_y[l];
+        sz  += s_z[l];
+        sxx += s_xx[l];
+        syy += s_yy[l];
+        szz += s_zz[l];
+        sxy += s_xy[l];
+        sxz += s_xz[l];
+        syz += s_yz[l];
+    }
+
+    const double inv_w = sw != 0.0 ? 1.0 / sw : 0.0;
+    const double mx = sx * inv_w;
+    const double my = sy * inv_w;
+    const double mz = sz * inv_w;
+
+    out->xx[out_idx] = (float)(sxx * inv_w - mx * mx);
+    out->yy[out_idx] = (float)(syy * inv_w - my * my);
+    out->zz[out_idx] = (float)(szz * inv_w - mz * mz);
+    out->xy[out_idx] = (float)(sxy * inv_w - mx * my);
+    out->xz[out_idx] = (float)(sxz * inv_w - mx * mz);
+    out->yz[out_idx] = (float)(syz * inv_w - my * mz);
+}
+
+// Computes the shape weights (linear, planar, isotropic) for a batch of symmetric 3x3 matrices.
+// The eigenvalues are obtained analytically through the trigonometric solution of the characteristic polynomial,
+// which has no iterations or data dependent branches and can therefore be evaluated for all structures of a frame in one sweep.
+// The weights follow the same definition as md_util_shape_weights: (l1 - l2, 2(l2 - l3), 3 l3) / (l1 + l2 + l3) with l1 >= l2 >= l3.
+static void compute_shape_weights_batch(vec3_t* out_weights, const CovarianceBatch& cov, size_t count) {
+    const float two_pi_3 = 2.0943951023931955f;
+    for (size_t i = 0; i < count; ++i) {
+        const float a00 = cov.xx[i];
+        const float a11 = cov.yy[i];
+        const float a22 = cov.zz[i];
+        const float a01 = cov.xy[i];
+        const float a02 = cov.xz[i];
+        const float a12 = cov.yz[i];
+
+        const float q  = (a00 + a11 + a22) * (1.0f / 3.0f);
+        const float p1 = a01 * a01 + a02 * a02 + a12 * a12;
+        const float d0 = a00 - q;
+        const float d1 = a11 - q;
+        const float d2 = a22 - q;
+        const float p2 = d0 * d0 + d1 * d1 + d2 * d2 + 2.0f * p1;
+        const float p  = sqrtf(p2 * (1.0f / 6.0f));
+        const float inv_p = p > 0.0f ? 1.0f / p : 0.0f;
+
+        // r = det((A - qI) / p) / 2
+        const float b00 = d0 * inv_p, b11 = d1 * inv_p, b22 = d2 * inv_p;
+        const float b01 = a01 * inv_p, b02 = a02 * inv_p, b12 = a12 * inv_p;
+        const float det = b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02);
+        const float r   = CLAMP(det * 0.5f, -1.0f, 1.0f);
+        const float phi = acosf(r) * (1.0f / 3.0f);
+
+        const float l1 = q + 2.0f * p * cosf(phi);
+        const float l3 = q + 2.0f * p * cosf(phi + two_pi_3);
+        const float l2 = 3.0f * q - l1 - l3;
+
+        const float sum = l1 + l2 + l3;
+        const float scl = sum > 0.0f ? 1.0f / sum : 0.0f;
+        out_weights[i] = {(l1 - l2) * scl, 2.0f * (l2 - l3) * scl, 3.0f * l3 * scl};
+    }
+}
+
 struct Shapespace : viamd::EventHandler {
     char input[256] = "all";
     char error[256] = "";
@@ -58,7 +212,40 @@ struct Shapespace : viamd::EventHandler {
     md_array(md_bitfield_t) bitfields = 0;
     md_bitfield_t joined_bitfield = {};
 
+    // Flattened atom indices of all structures, structure i occupies [offsets[i], offsets[i+1])
+    // The corresponding weights are gathered once so that the evaluation does not need to touch the bitfields
+    md_array(int32_t)  indices = 0;
+    md_array(float)    masses  = 0;
+    md_array(uint32_t) offsets = 0;
+    size_t max_structure_size = 0;
+
+    // Per worker thread scratch memory, which is reused for all frames processed by that thread.
+    // Each block holds a full copy of the coordinates, so it is allocated lazily by the first range a thread executes:
+    // with many threads and few frames, most threads never take part and should not pay for it.
+    struct Scratch {
+        void*   mem;
+        size_t  bytes;
+        float*  x;
+        float*  y;
+        float*  z;
+        vec4_t* xyzw;   // Only used for triclinic cells
+        CovarianceBatch cov;
+        vec3_t* weights;
+    };
+    md_array(Scratch) scratch = 0;
+    md_allocator_i* scratch_alloc = 0;  // Thread-safe, the blocks are allocated from worker threads
+    size_t scratch_stride = 0;
+
+    // Key per structure, derived from its atom indices and the use_mass flag.
+    // When the structures change, the weights of structures with a matching key in the previous (completed) evaluation
+    // are copied over, and only the remaining structures listed in 'eval_structures' are evaluated.
+    md_array(uint64_t) keys = 0;
+    md_array(uint32_t) eval_structures = 0;
+    std::atomic_uint32_t frames_complete = 0;
+
+    // The previous evaluation is kept alive in a second arena while the next one is set up
     md_allocator_i* arena = 0;
+    md_allocator_i* prev_arena = 0;
 
     // Settings
     float marker_size = 1.5f;
@@ -71,7 +258,53 @@ struct Shapespace : viamd::EventHandler {
 
     ApplicationState* app_state = 0;
 
-    Shapespace() { viamd::event_system_register_handler(*this); }
+    Shapespace() {
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdTopologyInit,
+            viamd::EventType_ViamdTopologyFree,
+            viamd::EventType_ViamdTrajectoryInit,
+            viamd::EventType_ViamdTrajectoryFree,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdWindowDrawMenu,
+            viamd::EventType_ViamdDeserialize,
+            viamd::EventType_ViamdSerialize,
+        }, "Shapespace");
+    }
+
+    // Called from the worker thread which owns the slot
+    void init_scratch(Scratch& s) {
+        const size_t stride = scratch_stride;
+        s.bytes = max_structure_size * sizeof(vec4_t) + stride * 3 * sizeof(float) + num_structures * (6 * sizeof(float) + sizeof(vec3_t));
+        s.mem = md_alloc(scratch_alloc, s.bytes);
+
+        s.xyzw = (vec4_t*)s.mem;
+        float* xyz = (float*)(s.xyzw + max_structure_size);
+        s.x = xyz + stride * 0;
+        s.y = xyz + stride * 1;
+        s.z = xyz + stride * 2;
+        float* cov = xyz + stride * 3;
+        s.cov = {
+            cov + num_structures * 0,
+            cov + num_structures * 1,
+            cov + num_structures * 2,
+            cov + num_structures * 3,
+            cov + num_structures * 4,
+            cov + num_structures * 5,
+        };
+        s.weights = (vec3_t*)(cov + num_structures * 6);
+    }
+
+    // The evaluation task must not be running
+    void free_scratch() {
+        for (size_t i = 0; i < md_array_size(scratch); ++i) {
+            if (scratch[i].mem) {
+                md_free(scratch_alloc, scratch[i].mem, scratch[i].bytes);
+            }
+        }
+        scratch = 0;
+    }
 
     void process_events(const viamd::Event* events, size_t num_events) final {
         for (size_t i = 0; i < num_events; ++i) {
@@ -80,13 +313,28 @@ struct Shapespace : viamd::EventHandler {
             switch (e.type) {
             case viamd::EventType_ViamdInitialize: {
                 app_state = (ApplicationState*)e.payload;
-                arena = md_arena_allocator_create(app_state->allocator.persistent, MEGABYTES(1));
+                md_allocator_i* shapespace_alloc = memory_budget::create_allocator("Shape Space", app_state->allocator.persistent);
+                scratch_alloc = shapespace_alloc;
+                arena = md_arena_allocator_create(shapespace_alloc, MEGABYTES(1));
+                prev_arena = md_arena_allocator_create(shapespace_alloc, MEGABYTES(1));
                 md_bitfield_init(&joined_bitfield, arena);
                 break;
             }
             case viamd::EventType_ViamdShutdown:
                 task_system::task_interrupt_and_wait_for(evaluate_task);
+                free_scratch();
                 md_arena_allocator_destroy(arena);
+                md_arena_allocator_destroy(prev_arena);
+                break;
+            case viamd::EventType_ViamdTopologyInit:
+            case viamd::EventType_ViamdTopologyFree:
+            case viamd::EventType_ViamdTrajectoryInit:
+            case viamd::EventType_ViamdTrajectoryFree:
+                // Previously evaluated weights are no longer valid
+                task_system::task_interrupt_and_wait_for(evaluate_task);
+                free_scratch();
+                frames_complete = 0;
+                eval_hash = 0;
                 break;
             case viamd::EventType_ViamdFrameTick:
                 draw_window();
@@ -346,12 +594,33 @@ struct Shapespace : viamd::EventHandler {
             if (task_system::task_is_running(evaluate_task)) {
                 task_system::task_interrupt (evaluate_task);
             } else {
+                // Keep the results of the previous evaluation around if it completed, so unchanged structures can be reused
+                const size_t num_frames_in_traj = md_trajectory_num_frames(app_state->mold.traj);
+                const bool prev_valid = num_frames > 0 && num_frames == num_frames_in_traj && frames_complete == num_frames;
+                const size_t    prev_num_structures = prev_valid ? num_structures : 0;
+                const uint64_t* prev_keys    = keys;
+                const vec3_t*   prev_weights = weights;
+                const vec2_t*   prev_coords  = coords;
+
+                md_allocator_i* tmp_arena = prev_arena;
+                prev_arena = arena;
+                arena = tmp_arena;
+
                 bitfields = 0;
                 weights = 0;
                 coords = 0;
+                indices = 0;
+                masses = 0;
+                offsets = 0;
+                free_scratch();
+                keys = 0;
+                eval_structures = 0;
+                frames_complete = 0;
+                max_structure_size = 0;
                 num_frames = 0;
                 num_structures = 0;
                 md_arena_allocator_reset(arena);
+                defer { md_arena_allocator_reset(prev_arena); };
                 joined_bitfield = {0};
                 md_bitfield_init(&joined_bitfield, arena);
 
@@ -366,7 +635,7 @@ struct Shapespace : viamd::EventHandler {
                         MD_LOG_ERROR("No structures present when attempting to populate shape space");
                         return;
                     }
-                    num_frames = md_trajectory_num_frames(app_state->mold.traj);
+                    num_frames = num_frames_in_traj;
                     if (!num_frames) {
                         MD_LOG_ERROR("No trajectory frames present when attempting to populate shape space");
                         return;
@@ -375,53 +644,136 @@ struct Shapespace : viamd::EventHandler {
                         md_bitfield_or_inplace(&joined_bitfield, &bitfields[i]);
                     }
 
+                    // Flatten the structure bitfields into index lists once, instead of iterating the bitfields for every frame
+                    const float* atom_mass = use_mass ? app_state->mold.mol.atom.mass : 0;
+                    md_array_resize(offsets, num_structures + 1, arena);
+                    offsets[0] = 0;
+                    for (size_t i = 0; i < num_structures; ++i) {
+                        const size_t count = md_bitfield_popcount(&bitfields[i]);
+                        offsets[i + 1] = offsets[i] + (uint32_t)count;
+                        max_structure_size = MAX(max_structure_size, count);
+                    }
+                    md_array_resize(indices, offsets[num_structures], arena);
+                    md_array_resize(masses,  offsets[num_structures], arena);
+                    for (size_t i = 0; i < num_structures; ++i) {
+                        md_bitfield_iter_t iter = md_bitfield_iter_create(&bitfields[i]);
+                        size_t dst_idx = offsets[i];
+                        while (md_bitfield_iter_next(&iter)) {
+                            const size_t src_idx = md_bitfield_iter_idx(&iter);
+                            indices[dst_idx] = (int32_t)src_idx;
+                            masses[dst_idx]  = atom_mass ? atom_mass[src_idx] : 1.0f;
+                            dst_idx += 1;
+                        }
+                    }
+
+                    scratch_stride = ALIGN_TO(app_state->mold.mol.atom.count, 8);
+                    md_array_resize(scratch, task_system::pool_num_threads(), arena);
+                    MEMSET(scratch, 0, md_array_bytes(scratch));
+
                     md_array_resize(weights, num_frames * num_structures, arena);
                     md_array_resize(coords,  num_frames * num_structures, arena);
                     MEMSET(weights, 0, md_array_bytes(weights));
-                    MEMSET(coords,  0, md_array_bytes(coords));
+
+                    // Look up each structure among the previous results (sorted by key) and copy the weights of any match.
+                    // Coordinates of structures which are yet to be evaluated are set to NaN, which excludes them from the plot,
+                    // so the plot fills in progressively as frames complete.
+                    struct KeyIndex {
+                        uint64_t key;
+                        uint32_t idx;
+                    };
+                    md_array(KeyIndex) prev_lookup = 0;
+                    if (prev_num_structures) {
+                        md_array_resize(prev_lookup, prev_num_structures, prev_arena);
+                        for (size_t i = 0; i < prev_num_structures; ++i) {
+                            prev_lookup[i] = {prev_keys[i], (uint32_t)i};
+                        }
+                        std::sort(prev_lookup, prev_lookup + prev_num_structures, [](const KeyIndex& a, const KeyIndex& b) { return a.key < b.key; });
+                    }
+
+                    const uint64_t seed = use_mass ? 1 : 0;
+                    md_array_resize(keys, num_structures, arena);
+                    for (size_t i = 0; i < num_structures; ++i) {
+                        const size_t count = offsets[i + 1] - offsets[i];
+                        keys[i] = md_hash64(indices + offsets[i], count * sizeof(int32_t), seed);
+
+                        const KeyIndex* it = std::lower_bound(prev_lookup, prev_lookup + prev_num_structures, keys[i], [](const KeyIndex& a, uint64_t key) { return a.key < key; });
+                        if (it != prev_lookup + prev_num_structures && it->key == keys[i]) {
+                            MEMCPY(weights + num_frames * i, prev_weights + num_frames * it->idx, num_frames * sizeof(vec3_t));
+                            MEMCPY(coords  + num_frames * i, prev_coords  + num_frames * it->idx, num_frames * sizeof(vec2_t));
+                        } else {
+                            for (size_t j = 0; j < num_frames; ++j) {
+                                coords[num_frames * i + j] = {NAN, NAN};
+                            }
+                            md_array_push(eval_structures, (uint32_t)i, arena);
+                        }
+                    }
+
+                    const size_t num_eval_structures = md_array_size(eval_structures);
+                    if (!num_eval_structures) {
+                        frames_complete = (uint32_t)num_frames;
+                        return;
+                    }
                     evaluate_task = task_system::create_pool_task(STR_LIT("Eval Shape Space"), (uint32_t)num_frames, [shapespace = this](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
-                        (void)thread_num;
                         ApplicationState* app_state = shapespace->app_state;
-                        const size_t stride = ALIGN_TO(app_state->mold.mol.atom.count, 8);
-                        const size_t bytes = stride * 3 * sizeof(float);
-                        float* coords = (float*)md_alloc(md_get_heap_allocator(), bytes);
-                        defer { md_free(md_get_heap_allocator(), coords, bytes); };
-                        float* x = coords + stride * 0;
-                        float* y = coords + stride * 1;
-                        float* z = coords + stride * 2;
-                        const float* w = shapespace->use_mass ? app_state->mold.mol.atom.mass : 0;
+                        ASSERT(thread_num < md_array_size(shapespace->scratch));
+                        Scratch& scratch = shapespace->scratch[thread_num];
+                        if (!scratch.mem) {
+                            shapespace->init_scratch(scratch);
+                        }
 
                         const vec2_t p[3] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.5f, 0.86602540378f}};
 
-                        md_array(vec4_t) xyzw = 0;
+                        const size_t num_eval = md_array_size(shapespace->eval_structures);
+                        const uint32_t* eval_structures = shapespace->eval_structures;
+
                         for (uint32_t frame_idx = range_beg; frame_idx < range_end; ++frame_idx) {
                             md_trajectory_frame_header_t header;
-                            md_trajectory_load_frame(app_state->mold.traj, frame_idx, &header, x, y, z);
-
-                            for (size_t i = 0; i < md_array_size(shapespace->bitfields); ++i) {
-                                const md_bitfield_t* bf = &shapespace->bitfields[i];
-                                size_t count = md_bitfield_popcount(bf);
-                                md_array_resize(xyzw, count, md_get_heap_allocator());
-
-                                md_bitfield_iter_t iter = md_bitfield_iter_create(bf);
-                                size_t dst_idx = 0;
-                                while (md_bitfield_iter_next(&iter)) {
-                                    const size_t src_idx = md_bitfield_iter_idx(&iter);
-                                    xyzw[dst_idx++] = vec4_set(x[src_idx], y[src_idx], z[src_idx], w ? w[src_idx] : 1.0f);
+                            md_trajectory_load_frame(app_state->mold.traj, frame_idx, &header, scratch.x, scratch.y, scratch.z);
+
+                            const md_unit_cell_t* cell = &header.unit_cell;
+                            if (cell->flags & MD_UNIT_CELL_FLAG_TRICLINIC) {
+                                // The minimum image in the fused pass only holds for orthorhombic cells, fall back to the general path
+                                for (size_t k = 0; k < num_eval; ++k) {
+                                    const uint32_t i = eval_structures[k];
+                                    const uint32_t beg = shapespace->offsets[i];
+                                    const size_t count = shapespace->offsets[i + 1] - beg;
+                                    const int32_t* idx = shapespace->indices + beg;
+                                    const float*   w   = shapespace->masses  + beg;
+                                    vec4_t* xyzw = scratch.xyzw;
+
+                                    for (size_t j = 0; j < count; ++j) {
+                                        xyzw[j] = vec4_set(scratch.x[idx[j]], scratch.y[idx[j]], scratch.z[idx[j]], w[j]);
+                                    }
+
+                                    vec3_t com = md_util_com_compute_vec4(xyzw, 0, count, cell);
+                                    md_util_deperiodize_vec4(xyzw, count, com, cell);
+
+                                    const mat3_t M = mat3_covariance_matrix_vec4(xyzw, 0, count, com);
+                                    scratch.weights[k] = md_util_shape_weights(&M);
                                 }
+                            } else {
+                                vec3_t box = {0, 0, 0};
+                                if (cell->flags & MD_UNIT_CELL_FLAG_ORTHO) {
+                                    box = {cell->basis[0][0], cell->basis[1][1], cell->basis[2][2]};
+                                }
+                                CovarianceBatch cov = scratch.cov;
+                                for (size_t k = 0; k < num_eval; ++k) {
+                                    const uint32_t i = eval_structures[k];
+                                    const uint32_t beg = shapespace->offsets[i];
+                                    const size_t count = shapespace->offsets[i + 1] - beg;
+                                    compute_covariance_fused(&cov, k, scratch.x, scratch.y, scratch.z, shapespace->indices + beg, shapespace->masses + beg, count, box);
+                                }
+                                compute_shape_weights_batch(scratch.weights, cov, num_eval);
+                            }
 
-                                vec3_t com = md_util_com_compute_vec4(xyzw, 0, count, &app_state->mold.mol.unit_cell);
-                                md_util_deperiodize_vec4(xyzw, count, com, &app_state->mold.mol.unit_cell);
-
-                                const mat3_t M = mat3_covariance_matrix_vec4(xyzw, 0, count, com);
-                                const vec3_t weights = md_util_shape_weights(&M);
-
-                                dst_idx = shapespace->num_frames * i + frame_idx;
+                            for (size_t k = 0; k < num_eval; ++k) {
+                                const vec3_t weights = scratch.weights[k];
+                                const size_t dst_idx = shapespace->num_frames * eval_structures[k] + frame_idx;
                                 shapespace->weights[dst_idx] = weights;
                                 shapespace->coords[dst_idx] = p[0] * weights[0] + p[1] * weights[1] + p[2] * weights[2];
                             }
                         }
-                        md_array_free(xyzw, md_get_heap_allocator());
+                        shapespace->frames_complete += (range_end - range_beg);
                     });
 
                     task_system::enqueue_task(evaluate_task);
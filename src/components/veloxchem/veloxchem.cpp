@@ -4,6 +4,7 @@
 #include <viamd.h>
 #include <task_system.h>
 #include <color_utils.h>
+#include <memory_budget.h>
 
 #include <md_gto.h>
 #include <md_vlx.h>
@@ -286,7 +287,20 @@ static void grid_segment_and_attribute(float* out_group_values, size_t group_cap
 }
 
 struct VeloxChem : viamd::EventHandler {
-    VeloxChem() { viamd::event_system_register_handler(*this); }
+    VeloxChem() {
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdInitialize,
+            viamd::EventType_ViamdShutdown,
+            viamd::EventType_ViamdFrameTick,
+            viamd::EventType_ViamdWindowDrawMenu,
+            viamd::EventType_ViamdRenderTransparent,
+            viamd::EventType_ViamdTopologyInit,
+            viamd::EventType_ViamdTopologyFree,
+            viamd::EventType_RepresentationInfoFill,
+            viamd::EventType_RepresentationEvalElectronicStructure,
+            viamd::EventType_RepresentationEvalAtomProperty,
+        }, "VeloxChem");
+    }
     md_vlx_t* vlx = nullptr;
 
     bool use_gpu_path = false;
@@ -509,7 +523,7 @@ struct VeloxChem : viamd::EventHandler {
                 ASSERT(e.payload_type == viamd::EventPayloadType_ApplicationState);
                 ApplicationState& state = *(ApplicationState*)e.payload;
 
-                arena = md_arena_allocator_create(state.allocator.persistent, MEGABYTES(4));
+                arena = md_arena_allocator_create(memory_budget::create_allocator("VeloxChem", state.allocator.persistent), MEGABYTES(4));
                 int gl_major, gl_minor;
                 glGetIntegerv(GL_MAJOR_VERSION, &gl_major);
                 glGetIntegerv(GL_MINOR_VERSION, &gl_minor);
@@ -1,21 +1,195 @@
 #include "event.h"
+#include <core/md_common.h>
 #include <core/md_array.h>
 #include <core/md_os.h>
 #include <core/md_allocator.h>
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <atomic_queue.h>
 
 namespace viamd {
 
+// Capacity of the lock-free queue which receives events from any thread
+#define EVENT_QUEUE_CAPACITY 4096
+
+// Pending events are kept in a binary min-heap keyed on (timestamp, sequence)
+// The sequence number keeps events with equal timestamps in the order they were enqueued
+struct PendingEvent {
+	Event event;
+	uint64_t sequence;
+};
+
+// Heap predicate for the std heap algorithms (which build max-heaps), the earliest event ends up on top
+static inline bool pending_event_later(const PendingEvent& a, const PendingEvent& b) {
+	if (a.event.timestamp != b.event.timestamp) return a.event.timestamp > b.event.timestamp;
+	return a.sequence > b.sequence;
+}
+
+struct HandlerEntry {
+	EventHandler* handler;
+	md_array(Event) batch;		// Events routed to this handler during the current dispatch
+	EventHandlerStats stats;
+};
+
+// Handlers subscribed to a specific event type, stored as indices into the handler array in registration order
+struct TypeSubscribers {
+	EventType type;
+	bool used;
+	md_array(uint32_t) handlers;
+};
+
 struct event_system_t {
-	md_array(Event) event_queue = 0;
-	md_array(EventHandler*) event_handlers = 0;
+	md_array(PendingEvent) event_heap = 0;		// Pending events, only touched by the main thread
+	md_array(Event) dispatch = 0;				// Scratch array of due events handed to the handlers
+	uint64_t next_sequence = 0;
+
+	md_array(HandlerEntry) handlers = 0;
+	md_array(uint32_t) all_type_handlers = 0;	// Handlers which receive every event type
+	md_array(TypeSubscribers) type_table = 0;	// Open addressing table (power of two size) keyed on EventType
+	size_t num_types = 0;
+
+	// Events enqueued from any thread land in a bounded lock-free queue which the main thread drains when processing.
+	// Should it ever be full, producers fall back to a mutex protected overflow array so that no event is lost.
+	atomic_queue::AtomicQueue2<Event, EVENT_QUEUE_CAPACITY> incoming;
+	std::mutex overflow_mutex;
+	md_array(Event) overflow = 0;
+	std::atomic_size_t overflow_count = 0;
 };
 
 static event_system_t event_system = {};
 
+// EventTypes are already hashes, so the low bits are used directly as the table index
+static TypeSubscribers* find_type_subscribers(EventType type) {
+	const size_t cap = md_array_size(event_system.type_table);
+	if (cap == 0) return NULL;
+	const size_t mask = cap - 1;
+	for (size_t i = type & mask; ; i = (i + 1) & mask) {
+		TypeSubscribers* slot = &event_system.type_table[i];
+		if (!slot->used) return NULL;
+		if (slot->type == type) return slot;
+	}
+}
+
+static void insert_type_subscribers(md_array(TypeSubscribers) table, const TypeSubscribers& entry) {
+	const size_t mask = md_array_size(table) - 1;
+	size_t i = entry.type & mask;
+	while (table[i].used) {
+		i = (i + 1) & mask;
+	}
+	table[i] = entry;
+}
+
+static TypeSubscribers* get_or_create_type_subscribers(EventType type) {
+	TypeSubscribers* slot = find_type_subscribers(type);
+	if (slot) return slot;
+
+	// Keep the load factor at or below 1/2
+	const size_t cap = md_array_size(event_system.type_table);
+	if ((event_system.num_types + 1) * 2 > cap) {
+		const size_t new_cap = cap ? cap * 2 : 32;
+		md_array(TypeSubscribers) table = 0;
+		md_array_resize(table, new_cap, md_get_heap_allocator());
+		MEMSET(table, 0, sizeof(TypeSubscribers) * new_cap);
+		for (size_t i = 0; i < cap; ++i) {
+			if (event_system.type_table[i].used) {
+				insert_type_subscribers(table, event_system.type_table[i]);
+			}
+		}
+		md_array_free(event_system.type_table, md_get_heap_allocator());
+		event_system.type_table = table;
+	}
+
+	// A type seen for the first time is delivered to everyone who subscribed to all types
+	TypeSubscribers entry = {.type = type, .used = true, .handlers = 0};
+	md_array_push_array(entry.handlers, event_system.all_type_handlers, md_array_size(event_system.all_type_handlers), md_get_heap_allocator());
+	insert_type_subscribers(event_system.type_table, entry);
+	event_system.num_types += 1;
+	return find_type_subscribers(type);
+}
+
+static const uint32_t* subscribers_of(EventType type, size_t* count) {
+	const TypeSubscribers* slot = find_type_subscribers(type);
+	const md_array(uint32_t) list = slot ? slot->handlers : event_system.all_type_handlers;
+	*count = md_array_size(list);
+	return list;
+}
+
+void event_system_register_handler(EventHandler& handler, const EventType* types, size_t num_types, const char* name) {
+	const uint32_t idx = (uint32_t)md_array_size(event_system.handlers);
+	HandlerEntry entry = {
+		.handler = &handler,
+		.batch = 0,
+		.stats = {
+			.name = name ? name : "",
+			.num_subscribed_types = 0,
+		},
+	};
+	md_array_push(event_system.handlers, entry, md_get_heap_allocator());
+
+	// Indices are appended in registration order, which keeps the dispatch order of every list the registration order.
+	// A type listed more than once is only subscribed (and counted) once.
+	if (types && num_types > 0) {
+		for (size_t i = 0; i < num_types; ++i) {
+			TypeSubscribers* slot = get_or_create_type_subscribers(types[i]);
+			const size_t n = md_array_size(slot->handlers);
+			if (n == 0 || slot->handlers[n - 1] != idx) {
+				md_array_push(slot->handlers, idx, md_get_heap_allocator());
+				event_system.handlers[idx].stats.num_subscribed_types += 1;
+			}
+		}
+	} else {
+		md_array_push(event_system.all_type_handlers, idx, md_get_heap_allocator());
+		for (size_t i = 0; i < md_array_size(event_system.type_table); ++i) {
+			if (event_system.type_table[i].used) {
+				md_array_push(event_system.type_table[i].handlers, idx, md_get_heap_allocator());
+			}
+		}
+	}
+}
+
 void event_system_register_handler(EventHandler& handler) {
-	md_array_push(event_system.event_handlers, &handler, md_get_heap_allocator());
+	event_system_register_handler(handler, NULL, 0, NULL);
+}
+
+static void invoke_handler(HandlerEntry& entry, const Event* events, size_t num_events) {
+	const md_timestamp_t t0 = md_time_current();
+	entry.handler->process_events(events, num_events);
+	const md_timestamp_t t1 = md_time_current();
+
+	const double ms = md_time_as_seconds(t1 - t0) * 1000.0;
+	EventHandlerStats& stats = entry.stats;
+	stats.num_calls  += 1;
+	stats.num_events += num_events;
+	stats.last_ms     = ms;
+	stats.max_ms      = MAX(stats.max_ms, ms);
+	stats.total_ms   += ms;
+}
+
+size_t event_system_handler_stats(EventHandlerStats* out_stats, size_t cap) {
+	const size_t count = MIN(cap, md_array_size(event_system.handlers));
+	for (size_t i = 0; i < count; ++i) {
+		out_stats[i] = event_system.handlers[i].stats;
+	}
+	return md_array_size(event_system.handlers);
+}
+
+void event_system_reset_handler_stats() {
+	for (size_t i = 0; i < md_array_size(event_system.handlers); ++i) {
+		EventHandlerStats& stats = event_system.handlers[i].stats;
+		stats.num_calls  = 0;
+		stats.num_events = 0;
+		stats.last_ms    = 0;
+		stats.max_ms     = 0;
+		stats.total_ms   = 0;
+	}
+}
+
+// Timestamps are in platform specific ticks, so delays given in milliseconds have to be converted
+static uint64_t ms_to_ticks(uint64_t ms) {
+	static const double ticks_per_ms = 1.0e9 / (md_time_as_seconds(1000000000) * 1000.0);
+	return (uint64_t)((double)ms * ticks_per_ms);
 }
 
 void event_system_enqueue_event(EventType type, EventPayloadType payload_type, const void* payload, uint64_t delay_in_ms) {
@@ -23,10 +197,38 @@ void event_system_enqueue_event(EventType type, EventPayloadType payload_type, c
 	Event e = {
 		.type = type,
 		.payload_type = payload_type,
-		.timestamp = time_now + delay_in_ms,
+		.timestamp = (uint64_t)time_now + (delay_in_ms ? ms_to_ticks(delay_in_ms) : 0),
 		.payload = payload,
 	};
-	md_array_push(event_system.event_queue, e, md_get_heap_allocator());
+	if (!event_system.incoming.try_push(e)) {
+		std::lock_guard<std::mutex> lock(event_system.overflow_mutex);
+		md_array_push(event_system.overflow, e, md_get_heap_allocator());
+		event_system.overflow_count.store(md_array_size(event_system.overflow), std::memory_order_release);
+	}
+}
+
+static void push_pending_event(const Event& e) {
+	PendingEvent pe = {e, event_system.next_sequence++};
+	md_array_push(event_system.event_heap, pe, md_get_heap_allocator());
+	PendingEvent* beg = event_system.event_heap;
+	std::push_heap(beg, beg + md_array_size(event_system.event_heap), pending_event_later);
+}
+
+// Moves events posted from any thread into the main thread heap
+static void drain_incoming_events() {
+	Event e;
+	while (event_system.incoming.try_pop(e)) {
+		push_pending_event(e);
+	}
+
+	if (event_system.overflow_count.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(event_system.overflow_mutex);
+		for (size_t i = 0; i < md_array_size(event_system.overflow); ++i) {
+			push_pending_event(event_system.overflow[i]);
+		}
+		md_array_shrink(event_system.overflow, 0);
+		event_system.overflow_count.store(0, std::memory_order_release);
+	}
 }
 
 void event_system_broadcast_event(EventType type, EventPayloadType payload_type, const void* payload) {
@@ -37,41 +239,59 @@ void event_system_broadcast_event(EventType type, EventPayloadType payload_type,
 		.payload = payload
 	};
 
-	for (size_t i = 0; i < md_array_size(event_system.event_handlers); ++i) {
-		event_system.event_handlers[i]->process_events(&e, 1);
+	size_t num_subscribers = 0;
+	const uint32_t* subscribers = subscribers_of(type, &num_subscribers);
+	for (size_t i = 0; i < num_subscribers; ++i) {
+		invoke_handler(event_system.handlers[subscribers[i]], &e, 1);
 	}
 }
 
+size_t event_system_num_pending_events() {
+	return md_array_size(event_system.event_heap);
+}
+
 void event_system_process_event_queue() {
-	size_t num_events = md_array_size(event_system.event_queue);
-	if (num_events == 0) {
+	drain_incoming_events();
+
+	size_t num_pending = md_array_size(event_system.event_heap);
+	if (num_pending == 0) {
 		return;
 	}
 
-	Event* beg = event_system.event_queue;
-	std::sort(beg, beg + num_events, [](const Event& a, const Event& b) {
-		return a.timestamp > b.timestamp;
-	});
-	
-	uint64_t time_now = md_time_current();
-	size_t num_events_to_process = num_events;
-	for (size_t i = 0; i < num_events; ++i) {
-		if (event_system.event_queue[i].timestamp > time_now) {
-			num_events_to_process = i;
-			break;
-		}
+	// Only the top of the heap has to be inspected, so frames without due events cost O(1)
+	// and popping k due events costs O(k log n)
+	const uint64_t time_now = (uint64_t)md_time_current();
+	PendingEvent* beg = event_system.event_heap;
+	md_array_shrink(event_system.dispatch, 0);
+	while (num_pending > 0 && beg[0].event.timestamp <= time_now) {
+		std::pop_heap(beg, beg + num_pending, pending_event_later);
+		num_pending -= 1;
+		md_array_push(event_system.dispatch, beg[num_pending].event, md_get_heap_allocator());
 	}
+	md_array_shrink(event_system.event_heap, num_pending);
 
-	if (num_events_to_process) {
-		for (size_t i = 0; i < md_array_size(event_system.event_handlers); ++i) {
-			EventHandler* handler = event_system.event_handlers[i];
-			handler->process_events(event_system.event_queue, num_events_to_process);
+	// Route each due event to the batches of its subscribers, every handler then gets a single call with its events in order
+	const size_t num_due = md_array_size(event_system.dispatch);
+	if (num_due == 0) {
+		return;
+	}
+	for (size_t i = 0; i < num_due; ++i) {
+		const Event& e = event_system.dispatch[i];
+		size_t num_subscribers = 0;
+		const uint32_t* subscribers = subscribers_of(e.type, &num_subscribers);
+		for (size_t j = 0; j < num_subscribers; ++j) {
+			md_array_push(event_system.handlers[subscribers[j]].batch, e, md_get_heap_allocator());
 		}
-		size_t num_events_left = num_events - num_events_to_process;
-		if (num_events_left) {
-			MEMCPY(beg, beg + num_events_to_process, sizeof(Event) * num_events_left);
+	}
+
+	// Events enqueued by the handlers go through the incoming queue and are picked up next call
+	for (size_t i = 0; i < md_array_size(event_system.handlers); ++i) {
+		HandlerEntry& entry = event_system.handlers[i];
+		const size_t num_events = md_array_size(entry.batch);
+		if (num_events) {
+			invoke_handler(entry, entry.batch, num_events);
+			md_array_shrink(entry.batch, 0);
 		}
-		md_array_shrink(event_system.event_queue, num_events_left);
 	}
 }
 
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <core/md_hash.h>
+#include <initializer_list>
 
 namespace viamd {
 	
@@ -32,6 +33,7 @@ enum : EventType {
 
 	EventType_ViamdTrajectoryInit		= HASH_STR_LIT("VIAMD Trajectory Initialize"),	// Called when a trajectory is initialized
 	EventType_ViamdTrajectoryFree		= HASH_STR_LIT("VIAMD Trajectory Free"),		// Called when a trajectory is freed
+	EventType_ViamdTrajectoryReplace	= HASH_STR_LIT("VIAMD Trajectory Replace"),		// Replace the loaded trajectory with the payload (md_trajectory_i*, opened through load::traj), null just frees it
 
 	//EventType_ViamdFileOpen 	   		= HASH_STR_LIT("VIAMD Open File"),
 
@@ -55,6 +57,7 @@ enum : EventType {
 enum : EventPayloadType {
 	EventPayloadType_Undefined					= 0,
 	EventPayloadType_ApplicationState			= HASH_STR_LIT("Payload Application State"),
+	EventPayloadType_Trajectory					= HASH_STR_LIT("Payload Trajectory"),
 	EventPayloadType_RepresentationInfo			= HASH_STR_LIT("Payload Representation Info"),
 	EventPayloadType_Representation				= HASH_STR_LIT("Payload Representation"),
 	EventPayloadType_SerializationState			= HASH_STR_LIT("Payload Serialization State"),
@@ -75,16 +78,45 @@ struct EventHandler {
     virtual void process_events(const Event* events, size_t num_events) = 0;
 };
 
+// Registers a handler which receives every event type
 void event_system_register_handler(EventHandler& event_handler);
 
+// Registers a handler which only receives the listed event types, the name is used for the timing statistics
+// Dispatch only touches the handlers subscribed to an event's type, so prefer this for components which care about a few types
+void event_system_register_handler(EventHandler& event_handler, const EventType* types, size_t num_types, const char* name = 0);
+
+inline void event_system_register_handler(EventHandler& event_handler, std::initializer_list<EventType> types, const char* name = 0) {
+	event_system_register_handler(event_handler, types.begin(), types.size(), name);
+}
+
+// Accumulated time spent inside each handler's process_events, used to find slow event consumers
+struct EventHandlerStats {
+	const char* name;
+	uint32_t num_subscribed_types;	// 0 means the handler receives every event type
+	uint64_t num_calls;
+	uint64_t num_events;
+	double   last_ms;
+	double   max_ms;
+	double   total_ms;
+};
+
+// Writes up to cap entries (in registration order) and returns the total number of registered handlers
+size_t event_system_handler_stats(EventHandlerStats* out_stats, size_t cap);
+void event_system_reset_handler_stats();
+
 // Queues up an event to be processed (Prefer this, unless the event has to be processed now)
 // Events are processed in batches by each registered event
+// This is safe to call from any thread (e.g. pool tasks posting completion events), the handlers are always invoked on the main thread
 void event_system_enqueue_event(EventType type, EventPayloadType payload_type = EventPayloadType_Undefined, const void* payload = 0, uint64_t delay_in_ms = 0);
 
-// This immediately broadcasts an event in the system
+// This immediately broadcasts an event in the system (Main thread only)
 void event_system_broadcast_event(EventType type, EventPayloadType payload_type = EventPayloadType_Undefined, const void* payload = 0);
 
 // Call once per frame to process the queued up events
+// Only the events which are due are dispatched, delayed events stay pending until their time has come
 void event_system_process_event_queue();
 
+// Number of events waiting in the main thread queue (Main thread only)
+size_t event_system_num_pending_events();
+
 }
@@ -0,0 +1,69 @@
+#include "histogram.h"
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_bitfield.h>
+
+#include <float.h>
+
+bool histogram_compute_masked(float* out_bins, int num_bins, float value_min, float value_max, const float* values, int dim, const md_bitfield_t* mask, bool aggregate,
+    float* out_y_min, float* out_y_max, md_allocator_i* temp_alloc) {
+    ASSERT(out_bins);
+    ASSERT(values);
+    ASSERT(mask);
+    ASSERT(dim > 0);
+    ASSERT(temp_alloc);
+
+    const int hist_dim = aggregate ? 1 : dim;
+    MEMSET(out_bins, 0, sizeof(float) * hist_dim * num_bins);
+
+    const size_t num_samples = md_bitfield_popcount(mask) * dim;
+    if (num_samples == 0) return false;
+
+    const float range_ext = value_max - value_min;
+    const float inv_range = range_ext > 0.0f ? 1.0f / range_ext : 0.0f;
+
+    int* count = (int*)md_alloc(temp_alloc, sizeof(int) * hist_dim);
+    MEMSET(count, 0, sizeof(int) * hist_dim);
+
+    // We evaluate each frame, one at a time
+    md_bitfield_iter_t it = md_bitfield_iter_create(mask);
+    while (md_bitfield_iter_next(&it)) {
+        const int val_idx = dim * (int)md_bitfield_iter_idx(&it);
+        for (int i = 0; i < dim; ++i) {
+            const float val = values[val_idx + i];
+            // Written so that NaN fails the test, it would otherwise reach the float to int conversion below
+            if (!(value_min <= val && val <= value_max)) continue;
+            // Clamped in float before the conversion, the bin can still be NaN or out of range with infinite bounds
+            const float bin = ((val - value_min) * inv_range) * num_bins;
+            const int bin_idx = bin > 0.0f ? (bin < (float)(num_bins - 1) ? (int)bin : num_bins - 1) : 0;
+
+            if (aggregate) {
+                out_bins[bin_idx] += 1.0f;
+                count[0] += 1;
+            } else {
+                out_bins[num_bins * i + bin_idx] += 1.0f;
+                count[i] += 1;
+            }
+        }
+    }
+
+    float min_bin =  FLT_MAX;
+    float max_bin = -FLT_MAX;
+    const float width = range_ext / num_bins;
+    for (int i = 0; i < hist_dim; ++i) {
+        const float scl = 1.0f / (width * count[i]);
+        for (int j = 0; j < num_bins; ++j) {
+            float& val = out_bins[num_bins * i + j];
+            val *= scl;
+            min_bin = MIN(min_bin, val);
+            max_bin = MAX(max_bin, val);
+        }
+    }
+
+    md_free(temp_alloc, count, sizeof(int) * hist_dim);
+
+    if (out_y_min) *out_y_min = min_bin;
+    if (out_y_max) *out_y_max = max_bin;
+    return true;
+}
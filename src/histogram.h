@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+struct md_allocator_i;
+struct md_bitfield_t;
+
+// Bins the values of every frame set in mask into num_bins over [value_min, value_max] and normalizes each histogram into a density.
+// values holds dim values per frame. out_bins must hold (aggregate ? 1 : dim) * num_bins floats, where aggregate bins all dimensions together.
+// The y-range of the bins is written to out_y_min / out_y_max. temp_alloc is used for a small scratch array.
+// Returns false (with out_bins zeroed) if the mask is empty.
+bool histogram_compute_masked(float* out_bins, int num_bins, float value_min, float value_max, const float* values, int dim, const md_bitfield_t* mask, bool aggregate,
+    float* out_y_min, float* out_y_max, md_allocator_i* temp_alloc);
@@ -0,0 +1,47 @@
+#include "hot_paths.h"
+
+#include <core/md_common.h>
+#include <md_util.h>
+
+#include <float.h>
+
+namespace hot_paths {
+
+void interpolate_linear(float* dst_x, float* dst_y, float* dst_z, const float* const src_x[2], const float* const src_y[2], const float* const src_z[2], const md_unit_cell_t* cell, float t, uint32_t beg, uint32_t end) {
+    const float* x[2] = { src_x[0] + beg, src_x[1] + beg };
+    const float* y[2] = { src_y[0] + beg, src_y[1] + beg };
+    const float* z[2] = { src_z[0] + beg, src_z[1] + beg };
+    md_util_interpolate_linear(dst_x + beg, dst_y + beg, dst_z + beg, x, y, z, end - beg, cell, t);
+}
+
+void interpolate_cubic(float* dst_x, float* dst_y, float* dst_z, const float* const src_x[4], const float* const src_y[4], const float* const src_z[4], const md_unit_cell_t* cell, float t, float s, uint32_t beg, uint32_t end) {
+    const float* x[4] = { src_x[0] + beg, src_x[1] + beg, src_x[2] + beg, src_x[3] + beg };
+    const float* y[4] = { src_y[0] + beg, src_y[1] + beg, src_y[2] + beg, src_y[3] + beg };
+    const float* z[4] = { src_z[0] + beg, src_z[1] + beg, src_z[2] + beg, src_z[3] + beg };
+    md_util_interpolate_cubic_spline(dst_x + beg, dst_y + beg, dst_z + beg, x, y, z, end - beg, cell, t, s);
+}
+
+void apply_pbc(float* x, float* y, float* z, const md_unit_cell_t* cell, uint32_t beg, uint32_t end) {
+    md_util_pbc(x + beg, y + beg, z + beg, 0, end - beg, cell);
+}
+
+void unwrap_structures(float* x, float* y, float* z, const md_index_data_t* structures, const md_unit_cell_t* cell, uint32_t beg, uint32_t end) {
+    for (uint32_t i = beg; i < end; ++i) {
+        md_util_unwrap(x, y, z, md_index_range_beg(*structures, i), md_index_range_size(*structures, i), cell);
+    }
+}
+
+void compute_aabb(vec3_t* aabb_min, vec3_t* aabb_max, const float* x, const float* y, const float* z, const float* r, uint32_t beg, uint32_t end) {
+    vec3_t lo = vec3_set1( FLT_MAX);
+    vec3_t hi = vec3_set1(-FLT_MAX);
+    md_util_aabb_compute(lo.elem, hi.elem, x + beg, y + beg, z + beg, r + beg, 0, end - beg);
+    *aabb_min = vec3_min(*aabb_min, lo);
+    *aabb_max = vec3_max(*aabb_max, hi);
+}
+
+void recalc_bonds(md_bond_data_t* bonds, const float* x, const float* y, const float* z, const md_element_t* element, size_t count, const md_unit_cell_t* cell, md_allocator_i* alloc) {
+    md_bond_data_clear(bonds);
+    md_util_covalent_bonds_compute_exp(bonds, x, y, z, element, count, nullptr, cell, alloc);
+}
+
+}  // namespace hot_paths
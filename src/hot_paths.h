@@ -0,0 +1,36 @@
+#pragma once
+
+#include <core/md_vec_math.h>
+#include <md_molecule.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+
+// Per-frame kernels of interpolate_atomic_properties. viamd_bench times these same functions.
+// Each kernel works on the range [beg, end) and is called from a pool range task, with ATOM_GRAIN_SIZE for per-atom ranges.
+namespace hot_paths {
+
+static const uint32_t ATOM_GRAIN_SIZE = 1024;
+
+// Interpolates coordinates between src[0] and src[1] at t
+void interpolate_linear(float* dst_x, float* dst_y, float* dst_z, const float* const src_x[2], const float* const src_y[2], const float* const src_z[2], const md_unit_cell_t* cell, float t, uint32_t beg, uint32_t end);
+
+// Interpolates coordinates between src[1] and src[2] at t, with src[0] and src[3] as the outer control points and s as the tension
+void interpolate_cubic(float* dst_x, float* dst_y, float* dst_z, const float* const src_x[4], const float* const src_y[4], const float* const src_z[4], const md_unit_cell_t* cell, float t, float s, uint32_t beg, uint32_t end);
+
+// Wraps atoms into the unit cell
+void apply_pbc(float* x, float* y, float* z, const md_unit_cell_t* cell, uint32_t beg, uint32_t end);
+
+// Makes structures [beg, end) whole across periodic boundaries
+void unwrap_structures(float* x, float* y, float* z, const md_index_data_t* structures, const md_unit_cell_t* cell, uint32_t beg, uint32_t end);
+
+// Expands aabb_min / aabb_max by the atoms in [beg, end), including their radii.
+// A thread may process several ranges, so the per-thread bounds must be initialized to FLT_MAX / -FLT_MAX before the task runs.
+void compute_aabb(vec3_t* aabb_min, vec3_t* aabb_max, const float* x, const float* y, const float* z, const float* r, uint32_t beg, uint32_t end);
+
+// Clears bonds and recomputes the covalent bonds of all atoms
+void recalc_bonds(md_bond_data_t* bonds, const float* x, const float* y, const float* z, const md_element_t* element, size_t count, const md_unit_cell_t* cell, md_allocator_i* alloc);
+
+}  // namespace hot_paths
@@ -0,0 +1,415 @@
+#include "large_pages.h"
+#include "task_system.h"
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_array.h>
+#include <core/md_log.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+#if MD_PLATFORM_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#elif MD_PLATFORM_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace large_pages {
+
+#define MAX_ALLOCATORS 8
+#define DEFAULT_THRESHOLD MEGABYTES(4)
+#define HUGE_PAGE_SIZE MEGABYTES(2)
+#define PREFAULT_CHUNK MEGABYTES(16)
+
+// Placed in front of every mapped block, the returned pointer follows it.
+// Mapped blocks start on a HUGE_PAGE_SIZE boundary, so the returned pointer is always sizeof(BlockHeader) past one
+struct alignas(64) BlockHeader {
+    size_t   length;        // Length of the mapping
+    uint32_t is_explicit;
+};
+
+struct Entry {
+    md_allocator_i  iface;
+    md_allocator_i* backing;
+};
+
+static Config state = {};
+static Entry entries[MAX_ALLOCATORS];
+static uint32_t num_entries = 0;
+static std::mutex create_mutex;
+
+static std::atomic_int64_t mapped_bytes = 0;
+static std::atomic_int64_t mapped_blocks = 0;
+static std::atomic_int64_t explicit_bytes = 0;
+static std::atomic_bool explicit_failed = false;
+
+// Base addresses of all mapped blocks. A block is identified by its pointer rather than by the size the caller passes,
+// the registry is only searched for pointers with the alignment of a mapped block, so small blocks never take the lock
+static std::mutex registry_mutex;
+static md_array(void*) registry = 0;
+
+#if MD_PLATFORM_LINUX
+#define MAX_NUMA_NODES 64
+static unsigned long numa_node_mask = 0;
+static uint32_t num_numa_nodes = 0;
+
+// Reads the online nodes from sysfs, the format is a list of ranges: "0-1,3"
+static void detect_numa_nodes() {
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) return;
+    char buf[256] = "";
+    if (fgets(buf, sizeof(buf), file)) {
+        const char* c = buf;
+        while (*c) {
+            int beg = 0, end = 0, n = 0;
+            if (sscanf(c, "%d-%d%n", &beg, &end, &n) == 2 || (sscanf(c, "%d%n", &beg, &n) == 1 && (end = beg, true))) {
+                for (int i = beg; i <= end && i < MAX_NUMA_NODES; ++i) {
+                    numa_node_mask |= 1UL << i;
+                }
+                c += n;
+            }
+            if (*c != ',') break;
+            ++c;
+        }
+    }
+    fclose(file);
+    num_numa_nodes = (uint32_t)__builtin_popcountl(numa_node_mask);
+}
+
+static void interleave(void* ptr, size_t len) {
+    // MPOL_INTERLEAVE from <linux/mempolicy.h>, called through syscall to avoid a dependency on libnuma
+    const int MPOL_INTERLEAVE = 3;
+    if (syscall(SYS_mbind, ptr, len, MPOL_INTERLEAVE, &numa_node_mask, MAX_NUMA_NODES + 1, 0) != 0) {
+        MD_LOG_DEBUG("Large pages: mbind failed, pages are placed on first touch");
+    }
+}
+#endif
+
+#if MD_PLATFORM_LINUX
+// Maps len bytes (a multiple of HUGE_PAGE_SIZE) at a HUGE_PAGE_SIZE aligned address.
+// mmap only guarantees page alignment, and khugepaged can only back 2 MB aligned ranges by huge pages,
+// so the mapping is made one huge page larger and the unaligned head and the tail are unmapped again.
+static void* map_aligned(size_t len) {
+    const size_t padded = len + HUGE_PAGE_SIZE;
+    char* raw = (char*)mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return MAP_FAILED;
+    char* base = (char*)ALIGN_TO((uintptr_t)raw, HUGE_PAGE_SIZE);
+    const size_t head = (size_t)(base - raw);
+    const size_t tail = padded - head - len;
+    if (head) munmap(raw, head);
+    if (tail) munmap(base + len, tail);
+    return base;
+}
+#elif MD_PLATFORM_WINDOWS
+// VirtualAlloc only guarantees 64 KB alignment and a reservation cannot be partially released,
+// so a padded range is reserved to find an aligned address, released, and the block is then placed at that address.
+// Another thread may take the range in between, in which case the search is repeated.
+static void* map_aligned(size_t len) {
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        char* raw = (char*)VirtualAlloc(NULL, len + HUGE_PAGE_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+        if (!raw) return NULL;
+        VirtualFree(raw, 0, MEM_RELEASE);
+        void* ptr = VirtualAlloc((void*)ALIGN_TO((uintptr_t)raw, HUGE_PAGE_SIZE), len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (ptr) return ptr;
+    }
+    return NULL;
+}
+#endif
+
+// Maps a block of at least len bytes, the length actually mapped is returned in out_len
+static void* map_block(size_t len, size_t* out_len, bool* out_explicit) {
+    *out_explicit = false;
+    *out_len = len;
+#if MD_PLATFORM_LINUX
+    void* ptr = MAP_FAILED;
+    if (state.mode == Mode_Explicit && !explicit_failed) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) {
+            // The pool is empty or not configured (vm.nr_hugepages), there is no point in retrying for every block
+            if (!explicit_failed.exchange(true)) {
+                MD_LOG_INFO("Large pages: No explicit huge pages available, falling back to transparent huge pages");
+            }
+        } else {
+            *out_explicit = true;
+        }
+    }
+    if (ptr == MAP_FAILED) {
+        ptr = map_aligned(len);
+        if (ptr == MAP_FAILED) return NULL;
+        if (state.mode != Mode_Off) {
+            madvise(ptr, len, MADV_HUGEPAGE);
+        }
+    }
+    if (state.numa_interleave && num_numa_nodes > 1) {
+        interleave(ptr, len);
+    }
+    return ptr;
+#elif MD_PLATFORM_WINDOWS
+    void* ptr = NULL;
+    const size_t large_page = GetLargePageMinimum();
+    if (state.mode == Mode_Explicit && large_page && !explicit_failed) {
+        // Requires the 'Lock pages in memory' privilege, the size must be a multiple of the large page size
+        const size_t aligned_len = ALIGN_TO(len, large_page);
+        ptr = VirtualAlloc(NULL, aligned_len, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (!ptr) {
+            if (!explicit_failed.exchange(true)) {
+                MD_LOG_INFO("Large pages: MEM_LARGE_PAGES allocation failed (missing privilege?), using regular pages");
+            }
+        } else {
+            *out_explicit = true;
+            *out_len = aligned_len;
+        }
+    }
+    if (!ptr) {
+        ptr = map_aligned(len);
+    }
+    return ptr;
+#else
+    (void)len;
+    return NULL;
+#endif
+}
+
+static void unmap_block(void* ptr, size_t len) {
+#if MD_PLATFORM_LINUX
+    munmap(ptr, len);
+#elif MD_PLATFORM_WINDOWS
+    (void)len;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    (void)ptr;
+    (void)len;
+#endif
+}
+
+// Faults in every page of the block, spread over the task pool when it is available
+static void prefault(char* ptr, size_t len) {
+    const uint32_t num_chunks = (uint32_t)DIV_UP(len, PREFAULT_CHUNK);
+    auto touch = [ptr, len](uint32_t beg, uint32_t end) {
+        const size_t page = 4096;
+        const size_t last = MIN((size_t)end * PREFAULT_CHUNK, len);
+        for (size_t i = (size_t)beg * PREFAULT_CHUNK; i < last; i += page) {
+            ptr[i] = 0;
+        }
+    };
+    if (num_chunks > 1 && task_system::pool_num_threads() > 1) {
+        task_system::ID id = task_system::create_pool_task(STR_LIT("##Prefault"), num_chunks, [&touch](uint32_t beg, uint32_t end, uint32_t) { touch(beg, end); });
+        task_system::enqueue_task(id);
+        task_system::task_wait_for(id);
+    } else {
+        touch(0, num_chunks);
+    }
+}
+
+static void* alloc_block(size_t size) {
+    size_t len = ALIGN_TO(size + sizeof(BlockHeader), HUGE_PAGE_SIZE);
+    bool is_explicit = false;
+    char* base = (char*)map_block(len, &len, &is_explicit);
+    if (!base) return NULL;
+    if ((uintptr_t)base % HUGE_PAGE_SIZE != 0) {
+        // Only possible with an explicit page size below 2 MB, such a block could not be told apart from a backing block
+        MD_LOG_ERROR("Large pages: Mapped block is not aligned to %zu bytes", (size_t)HUGE_PAGE_SIZE);
+        unmap_block(base, len);
+        return NULL;
+    }
+
+    if (state.prefault) {
+        prefault(base, len);
+    }
+
+    BlockHeader* header = (BlockHeader*)base;
+    header->length = len;
+    header->is_explicit = is_explicit;
+    mapped_bytes.fetch_add((int64_t)len, std::memory_order_relaxed);
+    mapped_blocks.fetch_add(1, std::memory_order_relaxed);
+    if (is_explicit) explicit_bytes.fetch_add((int64_t)len, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        md_array_push(registry, (void*)base, md_get_heap_allocator());
+    }
+    return base + sizeof(BlockHeader);
+}
+
+// Returns true if ptr was returned by alloc_block
+static bool is_mapped(const void* ptr) {
+    if ((uintptr_t)ptr % HUGE_PAGE_SIZE != sizeof(BlockHeader)) {
+        return false;
+    }
+    const void* base = (const char*)ptr - sizeof(BlockHeader);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (size_t i = 0; i < md_array_size(registry); ++i) {
+        if (registry[i] == base) return true;
+    }
+    return false;
+}
+
+static void free_block(void* ptr) {
+    BlockHeader* header = (BlockHeader*)((char*)ptr - sizeof(BlockHeader));
+    const size_t len = header->length;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        const size_t count = md_array_size(registry);
+        for (size_t i = 0; i < count; ++i) {
+            if (registry[i] == header) {
+                registry[i] = registry[count - 1];
+                md_array_shrink(registry, count - 1);
+                break;
+            }
+        }
+    }
+    mapped_bytes.fetch_sub((int64_t)len, std::memory_order_relaxed);
+    mapped_blocks.fetch_sub(1, std::memory_order_relaxed);
+    if (header->is_explicit) explicit_bytes.fetch_sub((int64_t)len, std::memory_order_relaxed);
+    unmap_block(header, len);
+}
+
+static inline bool is_large(size_t size) {
+    return size >= state.threshold;
+}
+
+// Which path a block took is determined from its pointer, so a block freed or reallocated with a wrong (or zero) old_size
+// still goes back to where it came from
+static void* large_realloc(md_allocator_o* inst, void* ptr, size_t old_size, size_t new_size, const char* file, size_t line) {
+    md_allocator_i* backing = ((Entry*)inst)->backing;
+    const bool old_large = ptr && is_mapped(ptr);
+    const bool new_large = is_large(new_size);
+    ASSERT(!ptr || !old_size || old_large == is_large(old_size));
+
+    if (!old_large && !new_large) {
+        return backing->realloc(backing->inst, ptr, old_size, new_size, file, line);
+    }
+
+    if (new_size == 0) {
+        free_block(ptr);
+        return NULL;
+    }
+
+    // Bytes to carry over from the old block, for a mapped block without a (valid) old_size this is all it holds
+    size_t old_bytes = ptr ? old_size : 0;
+    if (old_large) {
+        const BlockHeader* header = (const BlockHeader*)((const char*)ptr - sizeof(BlockHeader));
+        const size_t capacity = header->length - sizeof(BlockHeader);
+        if (new_large && new_size <= capacity) {
+            return ptr;
+        }
+        old_bytes = old_size ? MIN(old_size, capacity) : capacity;
+    }
+
+    void* new_ptr = new_large ? alloc_block(new_size) : backing->realloc(backing->inst, NULL, 0, new_size, file, line);
+    if (!new_ptr) {
+        // The original block is left untouched, as with realloc.
+        // There is no fallback to the backing allocator, so blocks at or above the threshold are always mapped.
+        MD_LOG_ERROR("Large pages: Failed to allocate %zu bytes", new_size);
+        return NULL;
+    }
+    if (ptr) {
+        MEMCPY(new_ptr, ptr, MIN(old_bytes, new_size));
+        if (old_large) {
+            free_block(ptr);
+        } else {
+            backing->realloc(backing->inst, ptr, old_size, 0, file, line);
+        }
+    }
+    return new_ptr;
+}
+
+void configure(const Config& config) {
+    state = config;
+    if (state.threshold == 0) {
+        state.threshold = DEFAULT_THRESHOLD;
+    }
+#if MD_PLATFORM_LINUX
+    if (state.numa_interleave) {
+        detect_numa_nodes();
+        if (num_numa_nodes < 2) {
+            MD_LOG_INFO("Large pages: Single NUMA node, interleaving has no effect");
+        }
+    }
+#elif MD_PLATFORM_WINDOWS
+    if (state.numa_interleave) {
+        MD_LOG_INFO("Large pages: NUMA interleaving is only supported on Linux");
+        state.numa_interleave = false;
+    }
+#else
+    if (state.mode != Mode_Off || state.numa_interleave) {
+        MD_LOG_INFO("Large pages: Not supported on this platform");
+        state.mode = Mode_Off;
+        state.numa_interleave = false;
+    }
+#endif
+    if (enabled()) {
+        MD_LOG_INFO("Large pages: %s%s%s, blocks of %zu KB and above", mode_name(state.mode),
+            state.numa_interleave ? ", NUMA interleaved" : "", state.prefault ? ", prefaulted" : "", state.threshold / 1024);
+    }
+}
+
+const Config& config() { return state; }
+
+bool enabled() {
+    return state.mode != Mode_Off || state.numa_interleave;
+}
+
+md_allocator_i* create_allocator(md_allocator_i* backing) {
+    ASSERT(backing);
+    if (!enabled()) {
+        return backing;
+    }
+
+    std::lock_guard<std::mutex> lock(create_mutex);
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        if (entries[i].backing == backing) {
+            return &entries[i].iface;
+        }
+    }
+    if (num_entries == MAX_ALLOCATORS) {
+        MD_LOG_ERROR("Large pages: Too many allocators");
+        return backing;
+    }
+
+    Entry* entry = &entries[num_entries++];
+    entry->backing = backing;
+    entry->iface.inst = (md_allocator_o*)entry;
+    entry->iface.realloc = large_realloc;
+    return &entry->iface;
+}
+
+Stats stats() {
+    return {
+        .mapped_bytes = mapped_bytes.load(std::memory_order_relaxed),
+        .mapped_blocks = mapped_blocks.load(std::memory_order_relaxed),
+        .explicit_bytes = explicit_bytes.load(std::memory_order_relaxed),
+    };
+}
+
+bool parse_mode(Mode* mode, const char* str) {
+    ASSERT(mode);
+    if (!str) return false;
+    if (strcmp(str, "off") == 0 || strcmp(str, "0") == 0) {
+        *mode = Mode_Off;
+    } else if (strcmp(str, "thp") == 0 || strcmp(str, "1") == 0) {
+        *mode = Mode_Transparent;
+    } else if (strcmp(str, "explicit") == 0) {
+        *mode = Mode_Explicit;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* mode_name(Mode mode) {
+    switch (mode) {
+    case Mode_Transparent:  return "Transparent huge pages";
+    case Mode_Explicit:     return "Explicit huge pages";
+    default:                return "Off";
+    }
+}
+
+}  // namespace large_pages
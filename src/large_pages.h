@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+
+// Opt-in allocator for large, long-lived blocks such as the frame cache slab and per-frame property arrays.
+// Blocks at or above the threshold are mapped directly from the OS and backed by huge pages where possible,
+// smaller requests are forwarded to the backing allocator.
+// Off by default: the TLB and NUMA gains have not been measured yet, only a single node machine without a huge page pool was available.
+namespace large_pages {
+
+enum Mode : uint32_t {
+    Mode_Off = 0,
+    Mode_Transparent,   // madvise(MADV_HUGEPAGE), the kernel promotes the mapping to 2 MB pages when it can
+    Mode_Explicit,      // MAP_HUGETLB (Linux) or MEM_LARGE_PAGES (Windows), falls back to Mode_Transparent if none are available
+};
+
+struct Config {
+    Mode   mode = Mode_Off;
+    bool   numa_interleave = false;   // Interleave the pages of large blocks across all NUMA nodes (Linux only)
+    bool   prefault = false;          // Touch all pages of a new block from the task pool, so page faults do not occur during playback
+    size_t threshold = 0;             // Minimum block size, 0 means the default (4 MB)
+};
+
+struct Stats {
+    int64_t mapped_bytes;
+    int64_t mapped_blocks;
+    int64_t explicit_bytes;           // Portion of mapped_bytes which is backed by explicit huge pages
+};
+
+// Call once at startup before any allocator is created (Main thread only)
+void configure(const Config& config);
+const Config& config();
+bool enabled();
+
+// Returns backing if large pages are disabled. Calling this again with the same backing returns the same allocator.
+// The returned allocator is thread-safe if backing is.
+md_allocator_i* create_allocator(md_allocator_i* backing);
+
+Stats stats();
+
+// Parses "off", "thp" or "explicit" (also "0" and "1", where 1 means thp)
+bool parse_mode(Mode* mode, const char* str);
+const char* mode_name(Mode mode);
+
+}  // namespace large_pages
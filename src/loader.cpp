@@ -23,8 +23,11 @@
 #endif
 
 #include <string.h>
+#include <atomic>
 
 #include "task_system.h"
+#include "memory_budget.h"
+#include "large_pages.h"
 
 enum mol_loader_t {
     MOL_LOADER_UNKNOWN,
@@ -124,6 +127,18 @@ struct LoadedTrajectory {
     md_trajectory_i* traj;
     md_frame_cache_t cache;
     md_allocator_i*  alloc;
+    LoadTrajectoryFlags flags;
+
+    // Frame cache counters, updated atomically since frames are loaded from pool threads
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t cache_misses_since_clear;
+    uint64_t cache_evictions;
+    uint64_t cache_decode_ns;
+    uint64_t cache_decode_max_ns;
+    uint64_t cache_decoded_bytes;
+    size_t   cache_frame_bytes;
+    size_t   cache_budget_bytes;
 
     md_array(int32_t) recenter_indices;
 };
@@ -176,7 +191,9 @@ static inline LoadedTrajectory* alloc_loaded_trajectory(uint64_t key) {
 static inline void remove_loaded_trajectory(uint64_t key) {
     for (int64_t i = 0; i < num_loaded_trajectories; ++i) {
         if (loaded_trajectories[i].key == key) {
-            md_frame_cache_free(&loaded_trajectories[i].cache);
+            if (!(loaded_trajectories[i].flags & LoadTrajectoryFlag_InMemory)) {
+                md_frame_cache_free(&loaded_trajectories[i].cache);
+            }
             loaded_trajectories[i].loader->destroy(loaded_trajectories[i].traj);
             // Swap back and pop
             loaded_trajectories[i] = loaded_trajectories[--num_loaded_trajectories];
@@ -487,6 +504,31 @@ bool decode_frame_data(struct md_trajectory_o* inst, const void* data_ptr, [[may
 }
 #endif
 
+// If we have a recenter target, then compute the com and apply that transformation
+static void apply_recenter(const LoadedTrajectory* loaded_traj, const md_trajectory_frame_header_t* header, float* x, float* y, float* z) {
+    if (md_array_size(loaded_traj->recenter_indices) == 0) return;
+
+    const md_unit_cell_t* cell = &header->unit_cell;
+    const md_molecule_t* mol = loaded_traj->mol;
+    const size_t num_atoms = header->num_atoms;
+    const size_t count = md_array_size(loaded_traj->recenter_indices);
+    const int32_t* indices = loaded_traj->recenter_indices;
+
+    vec3_t com = {0};
+    if (count == 1) {
+        const int32_t i = indices[0];
+        com = vec3_set(x[i], y[i], z[i]);
+    } else {
+        com = md_util_com_compute(x, y, z, mol->atom.mass, indices, count, &mol->unit_cell);
+        md_util_pbc(&com.x, &com.y, &com.z, 0, 1, cell);
+    }
+
+    // Translate all
+    const vec3_t center = cell->flags ? cell->basis * vec3_set1(0.5f) : vec3_zero();
+    const vec3_t trans  = center - com;
+    vec3_batch_translate_inplace(x, y, z, num_atoms, trans);
+}
+
 bool load_frame(struct md_trajectory_o* inst, int64_t idx, md_trajectory_frame_header_t* out_header, float* out_x, float* out_y, float* out_z) {
     ASSERT(inst);
     LoadedTrajectory* loaded_traj = (LoadedTrajectory*)inst;
@@ -497,48 +539,55 @@ bool load_frame(struct md_trajectory_o* inst, int64_t idx, md_trajectory_frame_h
         return false;
     }
 
+    if (loaded_traj->flags & LoadTrajectoryFlag_InMemory) {
+        // Frames are already resident, read them straight into the output without going through the frame cache
+        md_trajectory_frame_header_t header;
+        bool result = md_trajectory_load_frame(loaded_traj->traj, idx, &header, out_x, out_y, out_z);
+        if (result && out_x) {
+            apply_recenter(loaded_traj, &header, out_x, out_y, out_z);
+        }
+        if (result && out_header) *out_header = header;
+        return result;
+    }
+
     md_frame_data_t* frame_data;
     md_frame_cache_lock_t* lock = 0;
     bool result = true;
     bool in_cache = md_frame_cache_find_or_reserve(&loaded_traj->cache, idx, &frame_data, &lock);
+    if (in_cache) {
+        std::atomic_ref<uint64_t>(loaded_traj->cache_hits).fetch_add(1, std::memory_order_relaxed);
+    } else {
+        std::atomic_ref<uint64_t>(loaded_traj->cache_misses).fetch_add(1, std::memory_order_relaxed);
+        // Once the cache is full, every miss replaces a resident frame
+        const uint64_t prev_misses = std::atomic_ref<uint64_t>(loaded_traj->cache_misses_since_clear).fetch_add(1, std::memory_order_relaxed);
+        if (prev_misses >= md_frame_cache_num_frames(&loaded_traj->cache)) {
+            std::atomic_ref<uint64_t>(loaded_traj->cache_evictions).fetch_add(1, std::memory_order_relaxed);
+        }
+    }
     if (!in_cache) {
         //md_allocator_i* alloc = md_get_heap_allocator();
         //size_t frame_data_size = md_trajectory_fetch_frame_data(loaded_traj->traj, idx, 0);
         //void*  frame_data_ptr  = md_alloc(alloc, frame_data_size);
         //md_trajectory_fetch_frame_data(loaded_traj->traj, idx, frame_data_ptr);
         //result = md_trajectory_decode_frame_data(loaded_traj->traj, frame_data_ptr, frame_data_size, &frame_data->header, frame_data->x, frame_data->y, frame_data->z);
+        const md_timestamp_t t0 = md_time_current();
         result = md_trajectory_load_frame(loaded_traj->traj, idx, &frame_data->header, frame_data->x, frame_data->y, frame_data->z);
 
         if (result) {
-            const md_unit_cell_t* cell = &frame_data->header.unit_cell;
-            const md_molecule_t* mol = loaded_traj->mol;
-            float* x = frame_data->x;
-            float* y = frame_data->y;
-            float* z = frame_data->z;
-            const size_t num_atoms = frame_data->header.num_atoms;
-
-            // If we have a recenter target, then compute the com and apply that transformation
-            if (md_array_size(loaded_traj->recenter_indices) > 0) {
-                size_t count = md_array_size(loaded_traj->recenter_indices);
-                const int32_t* indices = loaded_traj->recenter_indices;
-
-                vec3_t com = {0};
-                if (count == 1) {
-                    const int32_t i = indices[0];
-                    com = vec3_set(x[i], y[i], z[i]);
-                } else {
-                    com = md_util_com_compute(x, y, z, mol->atom.mass, indices, count, &mol->unit_cell);
-                    md_util_pbc(&com.x, &com.y, &com.z, 0, 1, cell);
-                }
-
-                // Translate all
-                const vec3_t center = cell->flags ? cell->basis * vec3_set1(0.5f) : vec3_zero();
-                const vec3_t trans  = center - com;
-                vec3_batch_translate_inplace(x, y, z, num_atoms, trans);
-            }
+            apply_recenter(loaded_traj, &frame_data->header, frame_data->x, frame_data->y, frame_data->z);
         }
+        const md_timestamp_t t1 = md_time_current();
 
         //md_free(alloc, frame_data_ptr, frame_data_size);
+
+        const uint64_t ns = (uint64_t)(md_time_as_seconds(t1 - t0) * 1.0e9);
+        std::atomic_ref<uint64_t>(loaded_traj->cache_decode_ns).fetch_add(ns, std::memory_order_relaxed);
+        std::atomic_ref<uint64_t> max_ns(loaded_traj->cache_decode_max_ns);
+        uint64_t prev_max = max_ns.load(std::memory_order_relaxed);
+        while (ns > prev_max && !max_ns.compare_exchange_weak(prev_max, ns, std::memory_order_relaxed)) {}
+        if (result) {
+            std::atomic_ref<uint64_t>(loaded_traj->cache_decoded_bytes).fetch_add(frame_data->header.num_atoms * 3 * sizeof(float), std::memory_order_relaxed);
+        }
     }
 
     if (result) {
@@ -577,6 +626,15 @@ md_trajectory_i* open_file(str_t filename, md_trajectory_loader_i* loader, const
     if (!internal_traj) {
         return NULL;
     }
+
+    return open_trajectory(internal_traj, loader, mol, alloc, flags);
+}
+
+md_trajectory_i* open_trajectory(md_trajectory_i* internal_traj, md_trajectory_loader_i* loader, const md_molecule_t* mol, md_allocator_i* alloc, LoadTrajectoryFlags flags) {
+    ASSERT(internal_traj);
+    ASSERT(loader);
+    ASSERT(mol);
+    ASSERT(alloc);
     
     size_t traj_atom_count = md_trajectory_num_atoms(internal_traj);
     if (traj_atom_count != mol->atom.count) {
@@ -595,16 +653,21 @@ md_trajectory_i* open_file(str_t filename, md_trajectory_loader_i* loader, const
     inst->cache = {0};
     inst->recenter_indices = 0;
     inst->alloc = alloc;
+    inst->flags = flags;
     
-    const size_t num_traj_frames      = md_trajectory_num_frames(internal_traj);
-    const size_t frame_cache_size     = CLAMP(MEGABYTES(VIAMD_FRAME_CACHE_SIZE), MEGABYTES(4), md_os_physical_ram() / 4);
-    const size_t approx_frame_size    = mol->atom.count * 3 * sizeof(float);
-    const size_t max_num_cache_frames = frame_cache_size / approx_frame_size;
-
-    const size_t  num_cache_frames    = MIN(num_traj_frames, max_num_cache_frames);
-    
-    MD_LOG_DEBUG("Initializing frame cache with %i frames.", (int)num_cache_frames);
-    md_frame_cache_init(&inst->cache, inst->traj, alloc, num_cache_frames);
+    if (!(flags & LoadTrajectoryFlag_InMemory)) {
+        const size_t num_traj_frames      = md_trajectory_num_frames(internal_traj);
+        const size_t frame_cache_size     = CLAMP(MEGABYTES(VIAMD_FRAME_CACHE_SIZE), MEGABYTES(4), md_os_physical_ram() / 4);
+        const size_t approx_frame_size    = mol->atom.count * 3 * sizeof(float);
+        const size_t max_num_cache_frames = frame_cache_size / approx_frame_size;
+        inst->cache_frame_bytes = approx_frame_size;
+        inst->cache_budget_bytes = frame_cache_size;
+
+        const size_t  num_cache_frames    = MIN(num_traj_frames, max_num_cache_frames);
+        
+        MD_LOG_DEBUG("Initializing frame cache with %i frames.", (int)num_cache_frames);
+        md_frame_cache_init(&inst->cache, inst->traj, memory_budget::create_allocator("Frame Cache", large_pages::create_allocator(alloc)), num_cache_frames);
+    }
 
     // We only overload load frame and decode frame data to apply PBC upon loading data
     traj->inst = (md_trajectory_o*)inst;
@@ -660,7 +723,10 @@ bool clear_cache(md_trajectory_i* traj) {
 
     LoadedTrajectory* loaded_traj = find_loaded_trajectory((uint64_t)traj);
     if (loaded_traj) {
-        md_frame_cache_clear(&loaded_traj->cache);
+        if (!(loaded_traj->flags & LoadTrajectoryFlag_InMemory)) {
+            md_frame_cache_clear(&loaded_traj->cache);
+            std::atomic_ref<uint64_t>(loaded_traj->cache_misses_since_clear).store(0, std::memory_order_relaxed);
+        }
         return true;
     }
     MD_LOG_ERROR("Supplied trajectory was not loaded with loader");
@@ -672,12 +738,56 @@ size_t num_cache_frames(md_trajectory_i* traj) {
 
     LoadedTrajectory* loaded_traj = find_loaded_trajectory((uint64_t)traj);
     if (loaded_traj) {
-        return md_frame_cache_num_frames(&loaded_traj->cache);
+        return (loaded_traj->flags & LoadTrajectoryFlag_InMemory) ? 0 : md_frame_cache_num_frames(&loaded_traj->cache);
     }
     MD_LOG_ERROR("Supplied trajectory was not loaded with loader");
     return 0;
 }
 
+bool cache_stats(md_trajectory_i* traj, CacheStats* out_stats) {
+    ASSERT(traj);
+    ASSERT(out_stats);
+
+    LoadedTrajectory* loaded_traj = find_loaded_trajectory((uint64_t)traj);
+    if (!loaded_traj || (loaded_traj->flags & LoadTrajectoryFlag_InMemory)) {
+        return false;
+    }
+
+    // The cache only evicts when a miss occurs while it is full, so the number of resident frames follows from the misses
+    const size_t capacity = md_frame_cache_num_frames(&loaded_traj->cache);
+    const uint64_t misses_since_clear = std::atomic_ref<uint64_t>(loaded_traj->cache_misses_since_clear).load(std::memory_order_relaxed);
+    out_stats->capacity   = capacity;
+    out_stats->resident   = (size_t)MIN((uint64_t)capacity, misses_since_clear);
+    out_stats->num_frames = md_trajectory_num_frames(loaded_traj->traj);
+    out_stats->budget_bytes   = loaded_traj->cache_budget_bytes;
+    out_stats->frame_bytes    = loaded_traj->cache_frame_bytes;
+    out_stats->resident_bytes = out_stats->resident * loaded_traj->cache_frame_bytes;
+    out_stats->hits           = std::atomic_ref<uint64_t>(loaded_traj->cache_hits).load(std::memory_order_relaxed);
+    out_stats->misses         = std::atomic_ref<uint64_t>(loaded_traj->cache_misses).load(std::memory_order_relaxed);
+    out_stats->evictions      = std::atomic_ref<uint64_t>(loaded_traj->cache_evictions).load(std::memory_order_relaxed);
+    out_stats->decode_ns      = std::atomic_ref<uint64_t>(loaded_traj->cache_decode_ns).load(std::memory_order_relaxed);
+    out_stats->decode_max_ns  = std::atomic_ref<uint64_t>(loaded_traj->cache_decode_max_ns).load(std::memory_order_relaxed);
+    out_stats->decoded_bytes  = std::atomic_ref<uint64_t>(loaded_traj->cache_decoded_bytes).load(std::memory_order_relaxed);
+    return true;
+}
+
+bool reset_cache_stats(md_trajectory_i* traj) {
+    ASSERT(traj);
+
+    LoadedTrajectory* loaded_traj = find_loaded_trajectory((uint64_t)traj);
+    if (!loaded_traj || (loaded_traj->flags & LoadTrajectoryFlag_InMemory)) {
+        return false;
+    }
+
+    std::atomic_ref<uint64_t>(loaded_traj->cache_hits).store(0, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(loaded_traj->cache_misses).store(0, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(loaded_traj->cache_evictions).store(0, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(loaded_traj->cache_decode_ns).store(0, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(loaded_traj->cache_decode_max_ns).store(0, std::memory_order_relaxed);
+    std::atomic_ref<uint64_t>(loaded_traj->cache_decoded_bytes).store(0, std::memory_order_relaxed);
+    return true;
+}
+
 }  // namespace traj
 
 }  // namespace load
@@ -19,6 +19,7 @@ enum LoaderStateFlag_ {
 enum LoadTrajectoryFlag_ {
     LoadTrajectoryFlag_None = 0,
     LoadTrajectoryFlag_DisableCacheWrite = 1,
+    LoadTrajectoryFlag_InMemory = 2,    // Frames are already resident in memory, bypass the frame cache
 };
 
 typedef uint32_t LoaderStateFlags;
@@ -51,6 +52,8 @@ namespace traj {
     md_trajectory_loader_i* loader_from_ext(str_t ext);
 
     md_trajectory_i* open_file(str_t filename, md_trajectory_loader_i* loader, const md_molecule_t* mol, md_allocator_i* alloc, LoadTrajectoryFlags flags = LoadTrajectoryFlag_None);
+    // Wraps an already created trajectory (e.g. an in-memory one) in the same way as open_file, loader->destroy is called upon close
+    md_trajectory_i* open_trajectory(md_trajectory_i* internal_traj, md_trajectory_loader_i* loader, const md_molecule_t* mol, md_allocator_i* alloc, LoadTrajectoryFlags flags = LoadTrajectoryFlag_None);
     bool close(md_trajectory_i* traj);
 
     bool has_recenter_target(md_trajectory_i* traj);
@@ -58,6 +61,27 @@ namespace traj {
 
     bool clear_cache(md_trajectory_i* traj);
     size_t num_cache_frames(md_trajectory_i* traj);
+
+    struct CacheStats {
+        size_t   capacity;      // Number of frames the cache can hold
+        size_t   resident;      // Number of frames currently held
+        size_t   num_frames;    // Number of frames in the trajectory
+        size_t   budget_bytes;  // Effective cache size, VIAMD_FRAME_CACHE_SIZE clamped to [4 MB, physical RAM / 4]
+        size_t   frame_bytes;   // Coordinate bytes per cached frame
+        size_t   resident_bytes;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;     // Misses which replaced a resident frame
+        uint64_t decode_ns;     // Total time spent loading and decoding missed frames
+        uint64_t decode_max_ns;
+        uint64_t decoded_bytes; // Coordinate bytes written into the cache
+    };
+
+    // Returns false if the trajectory was not opened through load::traj or bypasses the frame cache (LoadTrajectoryFlag_InMemory)
+    bool cache_stats(md_trajectory_i* traj, CacheStats* out_stats);
+
+    // Resets the hit, miss, eviction and decode counters (the occupancy is not affected)
+    bool reset_cache_stats(md_trajectory_i* traj);
 }
 
 }  // namespace load
@@ -65,10 +65,15 @@
 #include <imgui_notify.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <bitset>
 
 #include <viamd.h>
 #include <serialization_utils.h>
+#include <memory_budget.h>
+#include <large_pages.h>
+#include <histogram.h>
+#include <hot_paths.h>
 
 #ifdef VIAMD_ENABLE_OPENMM
 #include "components/openmm/openmm_interface.h"
@@ -78,6 +83,7 @@
 #define MAX_TEMPORAL_SUBPLOTS 10
 #define MAX_DISTRIBUTION_SUBPLOTS 10
 #define EXPERIMENTAL_GFX_API 0
+#define FRAME_ALLOC_RESERVATION GIGABYTES(4)
 #define PICKING_JITTER_HACK 0
 #define COMPILATION_TIME_DELAY_IN_SECONDS 1.0
 #define NOTIFICATION_DISPLAY_TIME_IN_SECONDS 5.0
@@ -97,6 +103,13 @@
 static md_allocator_i* frame_alloc = 0; // Linear allocator for scratch data which only is valid for the frame and then is reset
 static md_allocator_i* persistent_alloc = 0;
 
+// Persistent allocations per subsystem, these forward to persistent_alloc and are accounted for in the memory window
+static md_allocator_i* molecule_alloc = 0;
+static md_allocator_i* trajectory_data_alloc = 0;
+static md_allocator_i* script_alloc = 0;
+static md_allocator_i* representation_alloc = 0;
+static md_allocator_i* volume_alloc = 0;
+
 static TextEditor editor {};
 static bool use_gfx = false;
 
@@ -385,6 +398,11 @@ static inline uint64_t generate_fingerprint() {
     return (uint64_t)md_time_current();
 }
 
+// Name shown for an event handler in the startup log and the debug window, handlers registered without a name have an empty one
+static inline const char* handler_display_name(const viamd::EventHandlerStats& s) {
+    return (s.name && s.name[0]) ? s.name : "(unnamed)";
+}
+
 static void free_histogram(DisplayProperty::Histogram* hist) {
     ASSERT(hist);
     ASSERT(hist->alloc);
@@ -431,52 +449,11 @@ static void compute_histogram_masked(DisplayProperty::Histogram* hist, int num_b
     ASSERT(mask);
     ASSERT(dim > 0);
 
-    md_vm_arena_temp_t temp = md_vm_arena_temp_begin(frame_alloc);
-    defer { md_vm_arena_temp_end(temp); };
-
     hist->dim = aggregate ? 1 : dim;
     md_array_resize(hist->bins, (size_t)(hist->dim * num_bins), hist->alloc);
-    MEMSET(hist->bins, 0, md_array_bytes(hist->bins));
 
-    const size_t num_samples = md_bitfield_popcount(mask) * dim;
-    if (num_samples == 0) return;
-
-    const float range_ext = value_range_max - value_range_min;
-    const float inv_range = range_ext > 0.0f ? 1.0f / range_ext : 0.0f;
-
-    int* count = (int*)md_vm_arena_push_zero_array(frame_alloc, int, hist->dim);
-
-    // We evaluate each frame, one at a time
-    md_bitfield_iter_t it = md_bitfield_iter_create(mask);
-    while (md_bitfield_iter_next(&it)) {
-        const int val_idx = dim * (int)md_bitfield_iter_idx(&it);
-        for (int i = 0; i < dim; ++i) {
-            const float val = values[val_idx + i];
-            if (val < value_range_min || value_range_max < val) continue;
-            const int bin_idx = CLAMP((int)(((val - value_range_min) * inv_range) * num_bins), 0, num_bins - 1);
-
-            if (aggregate) {
-                hist->bins[bin_idx] += 1.0f;
-                count[0] += 1;
-            } else {
-                hist->bins[num_bins * i + bin_idx] += 1.0f;
-                count[i] += 1;
-            }
-        }
-    }
-
-    float min_bin =  FLT_MAX;
-    float max_bin = -FLT_MAX;
-    const float width = range_ext / num_bins;
-    for (int i = 0; i < hist->dim; ++i) {
-        const float scl = 1.0f / (width * count[i]);
-        for (int j = 0; j < num_bins; ++j) {
-            float& val = hist->bins[num_bins * i + j];
-            val *= scl;
-            min_bin = MIN(min_bin, val);
-            max_bin = MAX(max_bin, val);
-        }
-    }
+    float min_bin, max_bin;
+    if (!histogram_compute_masked(hist->bins, num_bins, value_range_min, value_range_max, values, dim, mask, aggregate, &min_bin, &max_bin, frame_alloc)) return;
 
     hist->num_bins = num_bins;
     hist->x_min = value_range_min;
@@ -606,6 +583,8 @@ static void draw_density_volume_window(ApplicationState* data);
 static void draw_script_editor_window(ApplicationState* data);
 static void draw_dataset_window(ApplicationState* data);
 static void draw_debug_window(ApplicationState* data);
+static void draw_memory_window(ApplicationState* data);
+static bool write_cache_stats_json(const ApplicationState* data, str_t filename);
 static void draw_property_export_window(ApplicationState* data);
 static void draw_notifications_window();
 
@@ -613,6 +592,7 @@ static void update_md_buffers(ApplicationState* data);
 
 static void init_molecule_data(ApplicationState* data);
 static void init_trajectory_data(ApplicationState* data);
+static void free_trajectory_data(ApplicationState* data);
 
 static void interrupt_async_tasks(ApplicationState* data);
 
@@ -624,7 +604,11 @@ struct MainEventHandler : viamd::EventHandler {
     ApplicationState* app_state = nullptr;
     
     MainEventHandler(ApplicationState* state) : app_state(state) {
-        viamd::event_system_register_handler(*this);
+        viamd::event_system_register_handler(*this, {
+            viamd::EventType_ViamdTopologyInit,
+            viamd::EventType_ViamdTrajectoryReplace,
+            viamd::EventType_ViamdRepresentationsClear,
+        }, "Main");
     }
     
     void process_events(const viamd::Event* events, size_t num_events) final {
@@ -642,6 +626,18 @@ struct MainEventHandler : viamd::EventHandler {
                     }
                     break;
                 }
+                case viamd::EventType_ViamdTrajectoryReplace: {
+                    if (e.payload_type == viamd::EventPayloadType_Trajectory && app_state) {
+                        // Trajectories which are not backed by a file, e.g. frames captured from a simulation
+                        free_trajectory_data(app_state);
+                        if (e.payload) {
+                            app_state->mold.traj = (md_trajectory_i*)e.payload;
+                            init_trajectory_data(app_state);
+                            app_state->animation.frame = 0;
+                        }
+                    }
+                    break;
+                }
                 case viamd::EventType_ViamdRepresentationsClear: {
                     if (e.payload_type == viamd::EventPayloadType_ApplicationState && app_state) {
                         MD_LOG_DEBUG("Clearing all representations");
@@ -702,7 +698,101 @@ static void set_hovered_property(ApplicationState* data, str_t label, int popula
     data->hovered_display_property_pop_idx = population_idx;
 }
 
+struct RuntimeOptions {
+    int  num_threads = VIAMD_NUM_WORKER_THREADS;
+    bool pin_threads = false;
+    large_pages::Config large_pages = {};
+};
+
+// Reads the runtime options from the environment and the command line, the command line takes precedence.
+//   --threads N, -t N              VIAMD_NUM_THREADS       Total number of threads in the task pool, 0 = one per physical core
+//   --pin-threads                  VIAMD_PIN_THREADS       Pin worker threads to processors
+//   --huge-pages [thp|explicit]    VIAMD_HUGE_PAGES        Back large allocations (frame cache, property arrays) by huge pages
+//   --numa-interleave              VIAMD_NUMA_INTERLEAVE   Interleave large allocations across NUMA nodes
+//   --prefault                     VIAMD_PREFAULT          Fault in large allocations up front
+// Consumed arguments are removed from argv and the remaining count is returned.
+// Parses a complete non-negative decimal integer, clamped to INT32_MAX. Returns false for empty, partial or negative input
+static bool parse_non_negative_int(int* out, const char* str) {
+    char* end = NULL;
+    const long val = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || val < 0) {
+        return false;
+    }
+    *out = (int)MIN(val, (long)INT32_MAX);
+    return true;
+}
+
+// Parses an on / off flag given as a number (0 = off), invalid values are reported and leave the flag unchanged
+static void parse_flag(bool* out, const char* str, const char* name) {
+    int val = 0;
+    if (parse_non_negative_int(&val, str)) {
+        *out = val != 0;
+    } else {
+        MD_LOG_ERROR("Invalid value '%s' for '%s', expected 0 or 1", str, name);
+    }
+}
+
+static int parse_runtime_options(int argc, char** argv, RuntimeOptions* opt) {
+    if (const char* env = getenv("VIAMD_NUM_THREADS")) {
+        if (!parse_non_negative_int(&opt->num_threads, env)) {
+            MD_LOG_ERROR("Invalid value '%s' for '%s', expected a number of worker threads (0 = one per physical core)", env, "VIAMD_NUM_THREADS");
+        }
+    }
+    if (const char* env = getenv("VIAMD_PIN_THREADS")) {
+        parse_flag(&opt->pin_threads, env, "VIAMD_PIN_THREADS");
+    }
+    if (const char* env = getenv("VIAMD_HUGE_PAGES")) {
+        if (!large_pages::parse_mode(&opt->large_pages.mode, env)) {
+            MD_LOG_ERROR("Invalid value '%s' for VIAMD_HUGE_PAGES, expected off, thp or explicit", env);
+        }
+    }
+    if (const char* env = getenv("VIAMD_NUMA_INTERLEAVE")) {
+        parse_flag(&opt->large_pages.numa_interleave, env, "VIAMD_NUMA_INTERLEAVE");
+    }
+    if (const char* env = getenv("VIAMD_PREFAULT")) {
+        parse_flag(&opt->large_pages.prefault, env, "VIAMD_PREFAULT");
+    }
+
+    int count = 1;
+    for (int i = 1; i < argc; ++i) {
+        str_t arg = str_from_cstr(argv[i]);
+        if (str_eq_cstr(arg, "--threads") || str_eq_cstr(arg, "-t")) {
+            // Consume the option even when the value is missing or invalid, so it is never mistaken for a file to load
+            if (i + 1 >= argc) {
+                MD_LOG_ERROR("Missing value for '%s', expected a number of worker threads (0 = one per physical core)", argv[i]);
+                continue;
+            }
+            if (!parse_non_negative_int(&opt->num_threads, argv[i + 1])) {
+                MD_LOG_ERROR("Invalid value '%s' for '%s', expected a number of worker threads (0 = one per physical core)", argv[i + 1], argv[i]);
+            }
+            ++i;
+        } else if (str_eq_cstr(arg, "--pin-threads")) {
+            opt->pin_threads = true;
+        } else if (str_eq_cstr(arg, "--huge-pages")) {
+            // The mode is optional
+            if (i + 1 < argc && large_pages::parse_mode(&opt->large_pages.mode, argv[i + 1])) {
+                ++i;
+            } else {
+                opt->large_pages.mode = large_pages::Mode_Transparent;
+            }
+        } else if (str_eq_cstr(arg, "--numa-interleave")) {
+            opt->large_pages.numa_interleave = true;
+        } else if (str_eq_cstr(arg, "--prefault")) {
+            opt->large_pages.prefault = true;
+        } else {
+            argv[count++] = argv[i];
+        }
+    }
+    opt->num_threads = MAX(opt->num_threads, 0);
+    return count;
+}
+
 int main(int argc, char** argv) {
+    // Cold start timing, reported once for the first rendered frame and once for the first frame which shows a loaded dataset
+    const md_timestamp_t startup_beg = md_time_current();
+    bool first_frame_reported = false;
+    bool first_dataset_frame_reported = false;
+
 #if DEBUG
     persistent_alloc = md_tracking_allocator_create(md_get_heap_allocator());
 #elif RELEASE
@@ -710,7 +800,18 @@ int main(int argc, char** argv) {
 #else
 #error "Must define DEBUG or RELEASE"
 #endif
-    frame_alloc = md_vm_arena_create(GIGABYTES(4));
+    frame_alloc = md_vm_arena_create(FRAME_ALLOC_RESERVATION);
+
+    RuntimeOptions options;
+    argc = parse_runtime_options(argc, argv, &options);
+    large_pages::configure(options.large_pages);
+
+    // Per-frame data is large and long-lived, which makes it a good fit for huge pages (when enabled)
+    molecule_alloc        = memory_budget::create_allocator("Molecule", persistent_alloc);
+    trajectory_data_alloc = memory_budget::create_allocator("Trajectory Data", large_pages::create_allocator(persistent_alloc));
+    script_alloc          = memory_budget::create_allocator("Script Properties", large_pages::create_allocator(persistent_alloc));
+    representation_alloc  = memory_budget::create_allocator("Representations", persistent_alloc);
+    volume_alloc          = memory_budget::create_allocator("Volumes", persistent_alloc);
 
     struct NotificationState {
         md_mutex_t lock;
@@ -765,9 +866,9 @@ int main(int argc, char** argv) {
     ApplicationState data;
     data.allocator.persistent = persistent_alloc;
     data.allocator.frame = frame_alloc;
-    data.representation.info.alloc = md_arena_allocator_create(persistent_alloc, MEGABYTES(1));
+    data.representation.info.alloc = md_arena_allocator_create(representation_alloc, MEGABYTES(1));
     data.file_queue.ring = md_ring_allocator_create(md_alloc(persistent_alloc, MEGABYTES(1)), MEGABYTES(1));
-    data.mold.mol_alloc  = md_arena_allocator_create(persistent_alloc, MEGABYTES(1));
+    data.mold.mol_alloc  = md_arena_allocator_create(molecule_alloc, MEGABYTES(1));
 
     md_bitfield_init(&data.selection.selection_mask, persistent_alloc);
     md_bitfield_init(&data.selection.highlight_mask, persistent_alloc);
@@ -812,8 +913,10 @@ int main(int argc, char** argv) {
     LOG_DEBUG("Initializing volume...");
     volume::initialize();
     LOG_DEBUG("Initializing task system...");
-    const size_t num_threads = VIAMD_NUM_WORKER_THREADS == 0 ? md_os_num_processors() : VIAMD_NUM_WORKER_THREADS;
-    task_system::initialize(CLAMP(num_threads, 2, (uint32_t)md_os_num_processors()));
+    data.settings.num_threads = options.num_threads;
+    data.settings.pin_threads = options.pin_threads;
+    task_system::initialize(data.settings.num_threads, data.settings.pin_threads);
+    data.settings.num_threads = (int)task_system::pool_num_threads();
 
     md_gl_initialize();
     data.mold.gl_shaders                = md_gl_shaders_create(shader_output_snippet);
@@ -824,6 +927,18 @@ int main(int argc, char** argv) {
 
     viamd::event_system_broadcast_event(viamd::EventType_ViamdInitialize, viamd::EventPayloadType_ApplicationState, &data);
 
+    {
+        // Components are expected to defer heavy initialization (shaders, reference data, library probing) to first use
+        viamd::EventHandlerStats handler_stats[64];
+        const size_t num_handlers = MIN(viamd::event_system_handler_stats(handler_stats, ARRAY_SIZE(handler_stats)), ARRAY_SIZE(handler_stats));
+        for (size_t i = 0; i < num_handlers; ++i) {
+            if (handler_stats[i].num_calls > 0) {
+                MD_LOG_DEBUG("Initialized '%s' in %.2f ms", handler_display_name(handler_stats[i]), handler_stats[i].last_ms);
+            }
+        }
+        MD_LOG_DEBUG("Startup: Subsystems and components initialized after %.2f ms", md_time_as_seconds(md_time_current() - startup_beg) * 1000.0);
+    }
+
 #if EXPERIMENTAL_GFX_API
     md_gfx_initialize(data.gbuffer.width, data.gbuffer.height, 0);
 #endif
@@ -854,7 +969,7 @@ int main(int argc, char** argv) {
 #endif
         if (argc > 1) {
             // Assume argv[1..] are files to load
-            // Currently we do not support any command line flags
+            // The runtime options have already been consumed by parse_runtime_options
             // So anything here which is a file path is assumed to be a file to load
             for (int i = 1; i < argc; ++i) {
                 str_t path = str_from_cstr(argv[i]);
@@ -977,6 +1092,7 @@ int main(int argc, char** argv) {
         if (data.selection.grow.show_window) draw_selection_grow_window(&data);
         if (data.show_property_export_window) draw_property_export_window(&data);
         if (data.show_debug_window) draw_debug_window(&data);
+        if (data.show_memory_window) draw_memory_window(&data);
 
         data.selection.selecting = false;
 
@@ -1190,7 +1306,7 @@ int main(int argc, char** argv) {
                     data.script.compile_ir = false;
                     data.script.time_since_last_change = 0;
                     
-                    data.script.ir = md_script_ir_create(persistent_alloc);
+                    data.script.ir = md_script_ir_create(script_alloc);
 
                     std::string src = editor.GetText();
                     str_t src_str {src.data(), src.length()};
@@ -1315,8 +1431,8 @@ int main(int argc, char** argv) {
                             md_script_ir_free(data.script.eval_ir);
                             data.script.eval_ir = data.script.ir;
                         }
-                        data.script.full_eval = md_script_eval_create(num_frames, data.script.eval_ir, persistent_alloc);
-                        data.script.filt_eval = md_script_eval_create(num_frames, data.script.eval_ir, persistent_alloc);
+                        data.script.full_eval = md_script_eval_create(num_frames, data.script.eval_ir, script_alloc);
+                        data.script.filt_eval = md_script_eval_create(num_frames, data.script.eval_ir, script_alloc);
                     }
 
                     init_display_properties(&data);
@@ -1555,14 +1671,28 @@ int main(int argc, char** argv) {
         md_script_vis_free(&data.script.vis);
 
         // Reset frame allocator
+        memory_budget::record_frame_arena(md_vm_arena_temp_begin(frame_alloc).pos, FRAME_ALLOC_RESERVATION);
         md_vm_arena_reset(frame_alloc);
 
         // Swap buffers
         application::swap_buffers(&data.app);
+
+        if (!first_frame_reported) {
+            first_frame_reported = true;
+            MD_LOG_INFO("Startup: First frame rendered after %.2f ms", md_time_as_seconds(md_time_current() - startup_beg) * 1000.0);
+        }
+        if (!first_dataset_frame_reported && data.mold.mol.atom.count > 0) {
+            first_dataset_frame_reported = true;
+            MD_LOG_INFO("Startup: First frame with the loaded dataset (%zu atoms) rendered after %.2f ms", data.mold.mol.atom.count, md_time_as_seconds(md_time_current() - startup_beg) * 1000.0);
+        }
     }
 
     interrupt_async_tasks(&data);
 
+    if (const char* path = getenv("VIAMD_CACHE_STATS_JSON")) {
+        write_cache_stats_json(&data, str_from_cstr(path));
+    }
+
     viamd::event_system_broadcast_event(viamd::EventType_ViamdShutdown);
 
     // shutdown subsystems
@@ -1731,7 +1861,7 @@ static void init_display_properties(ApplicationState* data) {
             item.temporal_subplot_mask = 0;
             item.distribution_subplot_mask = 0;
             item.hist = {};
-            item.hist.alloc = persistent_alloc;
+            item.hist.alloc = script_alloc;
             item.partial_evaluation = partial_evaluation;
 
             md_unit_print(item.unit_str[0], sizeof(item.unit_str), item.unit[0]);
@@ -1918,7 +2048,7 @@ static void init_display_properties(ApplicationState* data) {
         free_histogram(&old_items[i].hist);
     }
 
-    md_array_resize(data->display_properties, md_array_size(new_items), persistent_alloc);
+    md_array_resize(data->display_properties, md_array_size(new_items), script_alloc);
     MEMCPY(data->display_properties, new_items, md_array_size(new_items) * sizeof(DisplayProperty));
 }
 
@@ -2042,8 +2172,8 @@ static void update_density_volume(ApplicationState* data) {
                     md_gl_rep_destroy(data->density_volume.gl_reps[i]);
                 }
             }
-            md_array_resize(data->density_volume.gl_reps, num_reps, persistent_alloc);
-            md_array_resize(data->density_volume.rep_model_mats, num_reps, persistent_alloc);
+            md_array_resize(data->density_volume.gl_reps, num_reps, volume_alloc);
+            md_array_resize(data->density_volume.rep_model_mats, num_reps, volume_alloc);
 
             for (size_t i = old_size; i < num_reps; ++i) {
                 // Only init new entries
@@ -2154,7 +2284,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
     const size_t bytes = stride * sizeof(float) * 3 * 4;
     
     // The number of atoms to be processed per thread when divided into chunks
-    const uint32_t grain_size = 1024;
+    const uint32_t grain_size = hot_paths::ATOM_GRAIN_SIZE;
 
     md_vm_arena_temp_t tmp = md_vm_arena_temp_begin(frame_alloc);
     defer { md_vm_arena_temp_end(tmp); };
@@ -2243,15 +2373,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
 
             task_system::ID interp_coord_task = task_system::create_pool_task(STR_LIT("## Interp Coord Data"), (uint32_t)mol.atom.count, [data = &payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
                 (void)thread_num;
-                size_t count = range_end - range_beg;
-                float* dst_x = data->dst_x + range_beg;
-                float* dst_y = data->dst_y + range_beg;
-                float* dst_z = data->dst_z + range_beg;
-                const float* src_x[2] = { data->src_x[0] + range_beg, data->src_x[1] + range_beg};
-                const float* src_y[2] = { data->src_y[0] + range_beg, data->src_y[1] + range_beg};
-                const float* src_z[2] = { data->src_z[0] + range_beg, data->src_z[1] + range_beg};
-
-                md_util_interpolate_linear(dst_x, dst_y, dst_z, src_x, src_y, src_z, count, &data->unit_cell, data->t);
+                hot_paths::interpolate_linear(data->dst_x, data->dst_y, data->dst_z, data->src_x, data->src_y, data->src_z, &data->unit_cell, data->t, range_beg, range_end);
             }, grain_size);
 
             tasks[num_tasks++] = load_task;
@@ -2291,15 +2413,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
 
             task_system::ID interp_coord_task = task_system::create_pool_task(STR_LIT("## Interp Coord Data"), (uint32_t)mol.atom.count, [data = &payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
                 (void)thread_num;
-                size_t count = range_end - range_beg;
-                float* dst_x = data->dst_x + range_beg;
-                float* dst_y = data->dst_y + range_beg;
-                float* dst_z = data->dst_z + range_beg;
-                const float* src_x[4] = { data->src_x[0] + range_beg, data->src_x[1] + range_beg, data->src_x[2] + range_beg, data->src_x[3] + range_beg};
-                const float* src_y[4] = { data->src_y[0] + range_beg, data->src_y[1] + range_beg, data->src_y[2] + range_beg, data->src_y[3] + range_beg};
-                const float* src_z[4] = { data->src_z[0] + range_beg, data->src_z[1] + range_beg, data->src_z[2] + range_beg, data->src_z[3] + range_beg};
-
-                md_util_interpolate_cubic_spline(dst_x, dst_y, dst_z, src_x, src_y, src_z, count, &data->unit_cell, data->t, data->s);
+                hot_paths::interpolate_cubic(data->dst_x, data->dst_y, data->dst_z, data->src_x, data->src_y, data->src_z, &data->unit_cell, data->t, data->s, range_beg, range_end);
             }, grain_size);
 
             tasks[num_tasks++] = load_task;
@@ -2347,11 +2461,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
                         break;
                     };
 
-                    //md_allocator_i* arena = md_arena_allocator_create(md_get_heap_allocator(), MEGABYTES(4));
-                    //md_bond_data_t* bond  = (md_bond_data_t*)md_arena_allocator_push_zero(arena, sizeof(md_bond_data_t));
-                    md_bond_data_t* bonds = &data->state->mold.mol.bond; 
-                    md_bond_data_clear(bonds);
-                    md_util_covalent_bonds_compute_exp(bonds, x, y, z, mol.atom.element, mol.atom.count, nullptr, cell, data->state->mold.mol_alloc);
+                    hot_paths::recalc_bonds(&data->state->mold.mol.bond, x, y, z, mol.atom.element, mol.atom.count, cell, data->state->mold.mol_alloc);
                     data->state->mold.dirty_buffers |= MolBit_DirtyBonds;
                     });
                 tasks[num_tasks++] = recalc_bond_task;
@@ -2362,11 +2472,7 @@ static void interpolate_atomic_properties(ApplicationState* state) {
     if (state->operations.apply_pbc) {
         task_system::ID pbc_task = task_system::create_pool_task(STR_LIT("## Apply PBC"), (uint32_t)mol.atom.count, [data = &payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
             (void)thread_num;
-            size_t count = range_end - range_beg;
-            float* x = data->dst_x + range_beg;
-            float* y = data->dst_y + range_beg;
-            float* z = data->dst_z + range_beg;
-            md_util_pbc(x, y, z, 0, count, &data->unit_cell);
+            hot_paths::apply_pbc(data->dst_x, data->dst_y, data->dst_z, &data->unit_cell, range_beg, range_end);
         });
         tasks[num_tasks++] = pbc_task;
     } 
@@ -2374,30 +2480,21 @@ static void interpolate_atomic_properties(ApplicationState* state) {
         size_t num_structures = md_index_data_num_ranges(mol.structure);
         task_system::ID unwrap_task = task_system::create_pool_task(STR_LIT("## Unwrap Structures"), (uint32_t)num_structures, [data = &payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
             (void)thread_num;
-            for (uint32_t i = range_beg; i < range_end; ++i) {
-                int32_t* s_idx = md_index_range_beg(data->state->mold.mol.structure, i);
-                size_t   s_len = md_index_range_size(data->state->mold.mol.structure, i);
-                md_util_unwrap(data->dst_x, data->dst_y, data->dst_z, s_idx, s_len, &data->unit_cell);
-            }
+            hot_paths::unwrap_structures(data->dst_x, data->dst_y, data->dst_z, &data->state->mold.mol.structure, &data->unit_cell, range_beg, range_end);
         });
         tasks[num_tasks++] = unwrap_task;
     }
 
     {
         // Calculate a global AABB for the molecule
+        // A thread may pick up several ranges, the bounds are accumulated per thread
+        for (size_t i = 0; i < num_threads; ++i) {
+            payload.aabb_min[i] = vec3_set1( FLT_MAX);
+            payload.aabb_max[i] = vec3_set1(-FLT_MAX);
+        }
         task_system::ID aabb_task = task_system::create_pool_task(STR_LIT("## Compute AABB"), (uint32_t)mol.atom.count, [data = &payload](uint32_t range_beg, uint32_t range_end, uint32_t thread_num) {
-            size_t count = range_end - range_beg;
-            const float* x = data->state->mold.mol.atom.x + range_beg;
-            const float* y = data->state->mold.mol.atom.y + range_beg;
-            const float* z = data->state->mold.mol.atom.z + range_beg;
-            const float* r = data->state->mold.mol.atom.radius + range_beg;
-
-            vec3_t aabb_min = vec3_set1(FLT_MAX);
-            vec3_t aabb_max = vec3_set1(-FLT_MAX);
-            md_util_aabb_compute(aabb_min.elem, aabb_max.elem, x, y, z, r, 0, count);
-
-            data->aabb_min[thread_num] = aabb_min;
-            data->aabb_max[thread_num] = aabb_max;
+            const md_molecule_t& mol = data->state->mold.mol;
+            hot_paths::compute_aabb(&data->aabb_min[thread_num], &data->aabb_max[thread_num], mol.atom.x, mol.atom.y, mol.atom.z, mol.atom.radius, range_beg, range_end);
         });
         tasks[num_tasks++] = aabb_task;
     }
@@ -2881,6 +2978,7 @@ static void draw_main_menu(ApplicationState* data) {
             ImGui::Checkbox("Distributions", &data->distributions.show_window);
             ImGui::Checkbox("Density Volumes", &data->density_volume.show_window);
             ImGui::Checkbox("Dataset", &data->dataset.show_window);
+            ImGui::Checkbox("Memory", &data->show_memory_window);
 #ifdef VIAMD_ENABLE_OPENMM
             ImGui::Checkbox("OpenMM Simulation", &data->simulation.show_window);
 #endif
@@ -3155,6 +3253,30 @@ static void draw_main_menu(ApplicationState* data) {
             ImGui::Checkbox("Keep Representations", &data->settings.keep_representations);
             ImGui::SetItemTooltip("Keep representations when loading new topology (Does not apply for workspaces)\n");
 
+            // Worker threads
+            {
+                const int max_threads = (int)MAX(task_system::num_logical_processors(), 2);
+                ImGui::SliderInt("Worker Threads", &data->settings.num_threads, 2, max_threads);
+                ImGui::SetItemTooltip("Total number of threads used for evaluation, including the main thread\n"
+                    "This system has %zu physical cores and %zu logical processors\n"
+                    "Decrease if you run out of memory during evaluation", task_system::num_physical_cores(), task_system::num_logical_processors());
+                ImGui::Checkbox("Pin Threads", &data->settings.pin_threads);
+                ImGui::SetItemTooltip("Bind each worker thread to its own processor, physical cores are used before SMT siblings\n");
+
+                const bool changed = (size_t)data->settings.num_threads != task_system::pool_num_threads() || data->settings.pin_threads != task_system::pool_threads_pinned();
+                task_system::ID running[1];
+                const bool busy = task_system::pool_running_tasks(running, 1) > 0;
+                ImGui::BeginDisabled(!changed || busy);
+                if (ImGui::Button("Apply Thread Settings")) {
+                    task_system::reinitialize(data->settings.num_threads, data->settings.pin_threads);
+                    data->settings.num_threads = (int)task_system::pool_num_threads();
+                }
+                ImGui::EndDisabled();
+                if (busy && changed) {
+                    ImGui::SetItemTooltip("Wait for running tasks to complete before changing the thread settings");
+                }
+            }
+
             // Font
             ImFont* font_current = ImGui::GetFont();
             if (ImGui::BeginCombo("Font Size", font_current->GetDebugName()))
@@ -6934,6 +7056,39 @@ static void draw_debug_window(ApplicationState* data) {
             }
         }
 
+        if (ImGui::CollapsingHeader("Event Handlers")) {
+            viamd::EventHandlerStats stats[64];
+            size_t num_handlers = MIN(viamd::event_system_handler_stats(stats, ARRAY_SIZE(stats)), ARRAY_SIZE(stats));
+            if (ImGui::Button("Reset")) {
+                viamd::event_system_reset_handler_stats();
+            }
+            const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+            if (ImGui::BeginTable("Event Handler Timings", 7, flags)) {
+                ImGui::TableSetupColumn("Handler");
+                ImGui::TableSetupColumn("Types");
+                ImGui::TableSetupColumn("Calls");
+                ImGui::TableSetupColumn("Events");
+                ImGui::TableSetupColumn("Last (ms)");
+                ImGui::TableSetupColumn("Max (ms)");
+                ImGui::TableSetupColumn("Avg (ms)");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < num_handlers; ++i) {
+                    const viamd::EventHandlerStats& s = stats[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(handler_display_name(s));
+                    ImGui::TableNextColumn();
+                    if (s.num_subscribed_types) ImGui::Text("%u", s.num_subscribed_types);
+                    else ImGui::TextUnformatted("all");
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)s.num_calls);
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)s.num_events);
+                    ImGui::TableNextColumn(); ImGui::Text("%.3f", s.last_ms);
+                    ImGui::TableNextColumn(); ImGui::Text("%.3f", s.max_ms);
+                    ImGui::TableNextColumn(); ImGui::Text("%.3f", s.num_calls ? s.total_ms / (double)s.num_calls : 0.0);
+                }
+                ImGui::EndTable();
+            }
+        }
+
         ImGuiID active = ImGui::GetActiveID();
         ImGuiID hover  = ImGui::GetHoveredID();
         ImGui::Text("Active ID: %u, Hover ID: %u", active, hover);
@@ -6952,6 +7107,192 @@ static void draw_debug_window(ApplicationState* data) {
     ImGui::End();
 }
 
+// Writes a human readable byte count (B, KB, MB, GB) into buf
+static const char* format_bytes(char* buf, size_t cap, double bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit = 0;
+    double value = bytes < 0 ? -bytes : bytes;
+    while (value >= 1024.0 && unit < (int)ARRAY_SIZE(units) - 1) {
+        value /= 1024.0;
+        unit += 1;
+    }
+    snprintf(buf, cap, "%s%.*f %s", bytes < 0 ? "-" : "", unit == 0 ? 0 : 2, value, units[unit]);
+    return buf;
+}
+
+// Copies str into buf as the contents of a JSON string: quotes, backslashes and control characters are escaped,
+// other bytes (including UTF-8 sequences) are copied as is. Escape sequences are never split when the output is truncated to fit cap.
+static void json_escape(char* buf, size_t cap, const char* str) {
+    ASSERT(cap > 0);
+    size_t len = 0;
+    for (const unsigned char* c = (const unsigned char*)str; *c; ++c) {
+        char esc[8];
+        int n = 0;
+        switch (*c) {
+        case '"':  n = snprintf(esc, sizeof(esc), "\\\""); break;
+        case '\\': n = snprintf(esc, sizeof(esc), "\\\\"); break;
+        case '\b': n = snprintf(esc, sizeof(esc), "\\b"); break;
+        case '\f': n = snprintf(esc, sizeof(esc), "\\f"); break;
+        case '\n': n = snprintf(esc, sizeof(esc), "\\n"); break;
+        case '\r': n = snprintf(esc, sizeof(esc), "\\r"); break;
+        case '\t': n = snprintf(esc, sizeof(esc), "\\t"); break;
+        default:
+            if (*c < 0x20) {
+                n = snprintf(esc, sizeof(esc), "\\u%04x", *c);
+            } else {
+                esc[0] = (char)*c;
+                n = 1;
+            }
+        }
+        if (len + n >= cap) break;
+        MEMCPY(buf + len, esc, n);
+        len += n;
+    }
+    buf[len] = '\0';
+}
+
+// Writes the frame cache statistics of the current trajectory along with the settings which affect them,
+// so that runs with different cache sizes or prefetch settings can be compared
+static bool write_cache_stats_json(const ApplicationState* data, str_t filename) {
+    load::traj::CacheStats cache = {};
+    if (!data->mold.traj || !load::traj::cache_stats(data->mold.traj, &cache)) {
+        MD_LOG_INFO("No trajectory frame cache, skipping cache statistics");
+        return false;
+    }
+
+    md_file_o* file = md_file_open(filename, MD_FILE_WRITE);
+    if (!file) {
+        LOG_ERROR("Failed to open file '" STR_FMT "' to write cache statistics.", STR_ARG(filename));
+        return false;
+    }
+
+    // Every byte may expand to a \u00XX escape
+    char path[6 * sizeof(data->files.trajectory)];
+    json_escape(path, sizeof(path), data->files.trajectory);
+
+    md_file_printf(file, "{\n");
+    md_file_printf(file, "  \"trajectory\": \"%s\",\n", path);
+    md_file_printf(file, "  \"num_frames\": %zu,\n", cache.num_frames);
+    md_file_printf(file, "  \"cache_bytes\": %zu,\n", cache.budget_bytes);
+    md_file_printf(file, "  \"prefetch_frames\": %s,\n", data->settings.prefetch_frames ? "true" : "false");
+    md_file_printf(file, "  \"num_threads\": %zu,\n", task_system::pool_num_threads());
+    md_file_printf(file, "  \"huge_pages\": \"%s\",\n", large_pages::mode_name(large_pages::config().mode));
+    md_file_printf(file, "  \"numa_interleave\": %s,\n", large_pages::config().numa_interleave ? "true" : "false");
+    md_file_printf(file, "  \"capacity_frames\": %zu,\n", cache.capacity);
+    md_file_printf(file, "  \"resident_frames\": %zu,\n", cache.resident);
+    md_file_printf(file, "  \"frame_bytes\": %zu,\n", cache.frame_bytes);
+    md_file_printf(file, "  \"resident_bytes\": %zu,\n", cache.resident_bytes);
+    md_file_printf(file, "  \"hits\": %llu,\n", (unsigned long long)cache.hits);
+    md_file_printf(file, "  \"misses\": %llu,\n", (unsigned long long)cache.misses);
+    md_file_printf(file, "  \"evictions\": %llu,\n", (unsigned long long)cache.evictions);
+    md_file_printf(file, "  \"decode_ns\": %llu,\n", (unsigned long long)cache.decode_ns);
+    md_file_printf(file, "  \"decode_max_ns\": %llu,\n", (unsigned long long)cache.decode_max_ns);
+    md_file_printf(file, "  \"decoded_bytes\": %llu\n", (unsigned long long)cache.decoded_bytes);
+    md_file_printf(file, "}\n");
+    md_file_close(file);
+
+    MD_LOG_INFO("Wrote frame cache statistics to '" STR_FMT "'", STR_ARG(filename));
+    return true;
+}
+
+static void draw_memory_window(ApplicationState* data) {
+    ASSERT(data);
+
+    ImGui::SetNextWindowSize(ImVec2(560, 520), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Memory", &data->show_memory_window)) {
+        char buf[3][32];
+
+        if (ImGui::Button("Reset Peaks")) {
+            memory_budget::reset_peaks();
+        }
+
+        ImGui::SeparatorText("Subsystems");
+        memory_budget::Stats stats[32];
+        const size_t num_stats = MIN(memory_budget::stats(stats, ARRAY_SIZE(stats)), ARRAY_SIZE(stats));
+        int64_t total_current = 0;
+        int64_t total_peak = 0;
+        const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+        if (ImGui::BeginTable("Memory Budget", 5, flags)) {
+            ImGui::TableSetupColumn("Subsystem");
+            ImGui::TableSetupColumn("Current");
+            ImGui::TableSetupColumn("Peak");
+            ImGui::TableSetupColumn("Live Allocations");
+            ImGui::TableSetupColumn("Total Allocations");
+            ImGui::TableHeadersRow();
+            for (size_t i = 0; i < num_stats; ++i) {
+                const memory_budget::Stats& s = stats[i];
+                total_current += s.current_bytes;
+                total_peak    += s.peak_bytes;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(s.name);
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(format_bytes(buf[0], sizeof(buf[0]), (double)s.current_bytes));
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(format_bytes(buf[1], sizeof(buf[1]), (double)s.peak_bytes));
+                ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)s.live_allocations);
+                ImGui::TableNextColumn(); ImGui::Text("%lld", (long long)s.total_allocations);
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted("Total");
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(format_bytes(buf[0], sizeof(buf[0]), (double)total_current));
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(format_bytes(buf[1], sizeof(buf[1]), (double)total_peak));
+            ImGui::EndTable();
+        }
+        ImGui::SetItemTooltip("Peaks are per subsystem, so the total peak is an upper bound of the combined peak");
+
+        ImGui::SeparatorText("Frame Cache");
+        load::traj::CacheStats cache = {};
+        if (data->mold.traj && load::traj::cache_stats(data->mold.traj, &cache)) {
+            const uint64_t lookups = cache.hits + cache.misses;
+            const float occupancy = cache.capacity ? (float)cache.resident / (float)cache.capacity : 0.0f;
+            snprintf(buf[0], sizeof(buf[0]), "%zu / %zu frames", cache.resident, cache.capacity);
+            ImGui::ProgressBar(occupancy, ImVec2(-FLT_MIN, 0), buf[0]);
+            ImGui::Text("Capacity covers %.1f%% of the %zu trajectory frames", cache.num_frames ? 100.0 * (double)cache.capacity / (double)cache.num_frames : 0.0, cache.num_frames);
+            ImGui::Text("Resident: %s (%s per frame)", format_bytes(buf[0], sizeof(buf[0]), (double)cache.resident_bytes), format_bytes(buf[1], sizeof(buf[1]), (double)cache.frame_bytes));
+            ImGui::Text("Hits: %llu, Misses: %llu, Hit rate: %.1f%%", (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+                lookups ? 100.0 * (double)cache.hits / (double)lookups : 0.0);
+            ImGui::Text("Evictions: %llu", (unsigned long long)cache.evictions);
+            const double decode_s = (double)cache.decode_ns * 1.0e-9;
+            ImGui::Text("Decode: %.3f s total, %.3f ms avg, %.3f ms max, %s/s", decode_s,
+                cache.misses ? (double)cache.decode_ns * 1.0e-6 / (double)cache.misses : 0.0, (double)cache.decode_max_ns * 1.0e-6,
+                format_bytes(buf[2], sizeof(buf[2]), decode_s > 0.0 ? (double)cache.decoded_bytes / decode_s : 0.0));
+            ImGui::Text("Cache size: %s (configured %s)", format_bytes(buf[0], sizeof(buf[0]), (double)cache.budget_bytes), format_bytes(buf[1], sizeof(buf[1]), (double)MEGABYTES(VIAMD_FRAME_CACHE_SIZE)));
+            ImGui::SetItemTooltip("VIAMD_FRAME_CACHE_SIZE_MB clamped to between 4 MB and a quarter of the physical memory");
+            if (ImGui::Button("Reset Counters")) {
+                load::traj::reset_cache_stats(data->mold.traj);
+            }
+            ImGui::SetItemTooltip("Set the environment variable VIAMD_CACHE_STATS_JSON to a file path to write these statistics on exit");
+        } else {
+            ImGui::TextDisabled("No trajectory frame cache");
+        }
+
+        ImGui::SeparatorText("Large Pages");
+        if (large_pages::enabled()) {
+            const large_pages::Config& lp = large_pages::config();
+            const large_pages::Stats lps = large_pages::stats();
+            ImGui::Text("%s%s%s", large_pages::mode_name(lp.mode), lp.numa_interleave ? ", NUMA interleaved" : "", lp.prefault ? ", prefaulted" : "");
+            ImGui::Text("Mapped: %s in %lld blocks, Explicit huge pages: %s",
+                format_bytes(buf[0], sizeof(buf[0]), (double)lps.mapped_bytes), (long long)lps.mapped_blocks,
+                format_bytes(buf[1], sizeof(buf[1]), (double)lps.explicit_bytes));
+        } else {
+            ImGui::TextDisabled("Off (enable with --huge-pages or VIAMD_HUGE_PAGES)");
+        }
+
+        ImGui::SeparatorText("Frame Allocator");
+        const memory_budget::ArenaStats arena = memory_budget::frame_arena_stats();
+        ImGui::Text("Last frame: %s, High-water: %s, Reserved: %s",
+            format_bytes(buf[0], sizeof(buf[0]), (double)arena.last_frame_bytes),
+            format_bytes(buf[1], sizeof(buf[1]), (double)arena.peak_bytes),
+            format_bytes(buf[2], sizeof(buf[2]), (double)arena.reserved_bytes));
+        if (arena.history_len > 0) {
+            float max_mb = 0.0f;
+            for (size_t i = 0; i < arena.history_len; ++i) {
+                max_mb = MAX(max_mb, arena.history[i]);
+            }
+            ImGui::PlotLines("##frame_arena", arena.history, (int)arena.history_len, 0, "Usage per frame (MB)", 0.0f, MAX(max_mb * 1.1f, 1.0f), ImVec2(-FLT_MIN, 80));
+        }
+    }
+    ImGui::End();
+}
+
 static void draw_script_editor_window(ApplicationState* data) {
     ASSERT(data);
 
@@ -7562,6 +7903,9 @@ static void update_md_buffers(ApplicationState* data) {
     if (mol.atom.count == 0) return;
 
     if (data->mold.dirty_buffers & MolBit_DirtyPosition) {
+#ifdef VIAMD_ENABLE_OPENMM
+        const md_timestamp_t t0 = md_time_current();
+#endif
         const vec3_t pbc_ext = data->mold.mol.unit_cell.basis * vec3_t{1,1,1};
         md_gl_mol_set_atom_position(data->mold.gl_mol, 0, (uint32_t)mol.atom.count, mol.atom.x, mol.atom.y, mol.atom.z, 0);
         if (!(data->mold.dirty_buffers & MolBit_ClearVelocity)) {
@@ -7570,6 +7914,9 @@ static void update_md_buffers(ApplicationState* data) {
 #if EXPERIMENTAL_GFX_API
         md_gfx_structure_set_atom_position(data->mold.gfx_structure, 0, (uint32_t)mol.atom.count, mol.atom.x, mol.atom.y, mol.atom.z, 0);
         md_gfx_structure_set_aabb(data->mold.gfx_structure, &data->mold.mol_aabb_min, &data->mold.mol_aabb_max);
+#endif
+#ifdef VIAMD_ENABLE_OPENMM
+        data->simulation.upload_time = md_time_as_seconds(md_time_current() - t0);
 #endif
     }
 
@@ -7649,11 +7996,11 @@ static void free_trajectory_data(ApplicationState* data) {
     data->files.trajectory[0] = '\0';
     
     data->mold.mol.unit_cell = {};
-    md_array_free(data->timeline.x_values,  persistent_alloc);
-    md_array_free(data->display_properties, persistent_alloc);
+    md_array_free(data->timeline.x_values,  trajectory_data_alloc);
+    md_array_free(data->display_properties, script_alloc);
 
-    md_array_free(data->trajectory_data.backbone_angles.data,     persistent_alloc);
-    md_array_free(data->trajectory_data.secondary_structure.data, persistent_alloc);
+    md_array_free(data->trajectory_data.backbone_angles.data,     trajectory_data_alloc);
+    md_array_free(data->trajectory_data.secondary_structure.data, trajectory_data_alloc);
 }
 
 static void init_trajectory_data(ApplicationState* data) {
@@ -7671,7 +8018,7 @@ static void init_trajectory_data(ApplicationState* data) {
         data->timeline.filter.beg_frame = min_frame;
         data->timeline.filter.end_frame = max_frame;
 
-        md_array_resize(data->timeline.x_values, num_frames, persistent_alloc);
+        md_array_resize(data->timeline.x_values, num_frames, trajectory_data_alloc);
         for (size_t i = 0; i < num_frames; ++i) {
             data->timeline.x_values[i] = header.frame_times[i];
         }
@@ -7686,7 +8033,7 @@ static void init_trajectory_data(ApplicationState* data) {
         if (data->mold.mol.protein_backbone.count > 0) {
             data->trajectory_data.secondary_structure.stride = data->mold.mol.protein_backbone.count;
             data->trajectory_data.secondary_structure.count = data->mold.mol.protein_backbone.count * num_frames;
-            md_array_resize(data->trajectory_data.secondary_structure.data, data->mold.mol.protein_backbone.count * num_frames, persistent_alloc);
+            md_array_resize(data->trajectory_data.secondary_structure.data, data->mold.mol.protein_backbone.count * num_frames, trajectory_data_alloc);
             for (size_t i = 0; i < md_array_size(data->trajectory_data.secondary_structure.data); ++i) {
                 data->trajectory_data.secondary_structure.data[i] = MD_SECONDARY_STRUCTURE_COIL;
             }
@@ -7694,7 +8041,7 @@ static void init_trajectory_data(ApplicationState* data) {
 
             data->trajectory_data.backbone_angles.stride = data->mold.mol.protein_backbone.count;
             data->trajectory_data.backbone_angles.count = data->mold.mol.protein_backbone.count * num_frames;
-            md_array_resize(data->trajectory_data.backbone_angles.data, data->mold.mol.protein_backbone.count * num_frames, persistent_alloc);
+            md_array_resize(data->trajectory_data.backbone_angles.data, data->mold.mol.protein_backbone.count * num_frames, trajectory_data_alloc);
             MEMSET(data->trajectory_data.backbone_angles.data, 0, md_array_size(data->trajectory_data.backbone_angles.data) * sizeof (md_backbone_angles_t));
 
             // Launch work to compute the values
@@ -8320,7 +8667,7 @@ void create_screenshot(str_t path) {
 // #representation
 static Representation* create_representation(ApplicationState* data, RepresentationType type, ColorMapping color_mapping, str_t filter) {
     ASSERT(data);
-    md_array_push(data->representation.reps, Representation(), persistent_alloc);
+    md_array_push(data->representation.reps, Representation(), representation_alloc);
     Representation* rep = md_array_last(data->representation.reps);
     rep->type = type;
     rep->color_mapping = color_mapping;
@@ -8335,7 +8682,7 @@ static Representation* create_representation(ApplicationState* data, Representat
 
 static Representation* clone_representation(ApplicationState* state, const Representation& rep) {
     ASSERT(state);
-    md_array_push(state->representation.reps, rep, persistent_alloc);
+    md_array_push(state->representation.reps, rep, representation_alloc);
     Representation* clone = md_array_last(state->representation.reps);
     clone->md_rep = {0};
     clone->atom_mask = {0};
@@ -8630,7 +8977,7 @@ static void init_representation(ApplicationState* state, Representation* rep) {
     rep->gfx_rep = md_gfx_rep_create(state->mold.mol.atom.count);
 #endif
     rep->md_rep = md_gl_rep_create(state->mold.gl_mol);
-    md_bitfield_init(&rep->atom_mask, persistent_alloc);
+    md_bitfield_init(&rep->atom_mask, representation_alloc);
 
     size_t num_props = md_array_size(state->representation.info.atom_properties);
     if (num_props > 0) {
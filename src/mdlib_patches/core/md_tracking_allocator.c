@@ -8,52 +8,214 @@
 #include <core/md_log.h>
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 // We need to protect this via a mutex lock since we don't know in which context this allocator is used.
 // Better safe than sorry.
 
 #define MAGIC_NUMBER 0xdc1728367bca6273
 
+// Live allocations are indexed by pointer in an open addressing table (linear probing, backward shift deletion)
+// so that realloc and free are O(1) even with hundreds of thousands of live blocks.
+#define INITIAL_TABLE_CAP 1024
+#define INVALID_SITE UINT32_MAX
+
 typedef struct {
     void* ptr;
     size_t size;
+    uint32_t site;      // Index of the call site which (re)allocated the block
+} allocation_t;
+
+// Aggregate statistics per call site, identified by the (file, line) pair passed along with the allocation.
+// File names are compared by content: the same __FILE__ string may live at different addresses (e.g. one copy per translation unit
+// which includes a header), and all of them belong to the same call site. The strings are stable for the lifetime of the program.
+typedef struct {
     const char* file;
     size_t line;
-} allocation_t;
+    size_t hash;        // hash_site(file, line)
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t live_count;
+    size_t total_count;
+} call_site_t;
 
 typedef struct {
     md_allocator_i* backing;
-    md_array(allocation_t) allocations;
+
+    allocation_t* table;                // Open addressing table of live allocations, NULL ptr marks an empty slot
+    size_t table_cap;                   // Power of two
+    size_t num_allocations;
+
+    md_array(call_site_t) sites;
+    uint32_t* site_table;               // Open addressing table of indices into sites, INVALID_SITE marks an empty slot
+    size_t site_table_cap;              // Power of two
+
+    size_t live_bytes;
+    size_t peak_bytes;
+
     md_allocator_i* arena;
     md_mutex_t mutex;
     uint64_t magic;
 } tracking_t;
 
-allocation_t* find_allocation(tracking_t* tracking, void* ptr) {
-    for (size_t i = 0; i < md_array_size(tracking->allocations); ++i) {
-        if (tracking->allocations[i].ptr == ptr) return &tracking->allocations[i];
+static inline size_t hash_ptr(const void* ptr) {
+    uint64_t x = (uint64_t)(uintptr_t)ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+// FNV-1a over the file name, mixed with the line
+static inline size_t hash_site(const char* file, size_t line) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char* c = file; *c; ++c) {
+        h ^= (uint8_t)*c;
+        h *= 0x100000001b3ULL;
+    }
+    return hash_ptr((const void*)(uintptr_t)(h ^ (line * 0x9e3779b97f4a7c15ULL)));
+}
+
+static inline bool site_equal(const call_site_t* site, const char* file, size_t line, size_t hash) {
+    return site->hash == hash && site->line == line && (site->file == file || strcmp(site->file, file) == 0);
+}
+
+// Returns the slot holding ptr, or the empty slot where it would be inserted
+static size_t find_slot(const tracking_t* tracking, const void* ptr) {
+    const size_t mask = tracking->table_cap - 1;
+    size_t i = hash_ptr(ptr) & mask;
+    while (tracking->table[i].ptr && tracking->table[i].ptr != ptr) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static allocation_t* find_allocation(tracking_t* tracking, void* ptr) {
+    allocation_t* slot = &tracking->table[find_slot(tracking, ptr)];
+    return slot->ptr ? slot : NULL;
+}
+
+static void grow_table(tracking_t* tracking) {
+    allocation_t* old_table = tracking->table;
+    const size_t old_cap = tracking->table_cap;
+
+    tracking->table_cap = old_cap ? old_cap * 2 : INITIAL_TABLE_CAP;
+    tracking->table = (allocation_t*)md_alloc(tracking->backing, sizeof(allocation_t) * tracking->table_cap);
+    MEMSET(tracking->table, 0, sizeof(allocation_t) * tracking->table_cap);
+
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old_table[i].ptr) {
+            tracking->table[find_slot(tracking, old_table[i].ptr)] = old_table[i];
+        }
+    }
+    if (old_table) {
+        md_free(tracking->backing, old_table, sizeof(allocation_t) * old_cap);
+    }
+}
+
+static uint32_t get_call_site(tracking_t* tracking, const char* file, size_t line) {
+    if (!file) file = "";
+
+    // Keep the load factor at or below 1/2
+    if ((md_array_size(tracking->sites) + 1) * 2 > tracking->site_table_cap) {
+        const size_t old_cap = tracking->site_table_cap;
+        if (tracking->site_table) {
+            md_free(tracking->backing, tracking->site_table, sizeof(uint32_t) * old_cap);
+        }
+        tracking->site_table_cap = old_cap ? old_cap * 2 : INITIAL_TABLE_CAP;
+        tracking->site_table = (uint32_t*)md_alloc(tracking->backing, sizeof(uint32_t) * tracking->site_table_cap);
+        MEMSET(tracking->site_table, 0xFF, sizeof(uint32_t) * tracking->site_table_cap);
+
+        const size_t mask = tracking->site_table_cap - 1;
+        for (uint32_t s = 0; s < (uint32_t)md_array_size(tracking->sites); ++s) {
+            size_t i = tracking->sites[s].hash & mask;
+            while (tracking->site_table[i] != INVALID_SITE) {
+                i = (i + 1) & mask;
+            }
+            tracking->site_table[i] = s;
+        }
+    }
+
+    const size_t hash = hash_site(file, line);
+    const size_t mask = tracking->site_table_cap - 1;
+    size_t i = hash & mask;
+    while (tracking->site_table[i] != INVALID_SITE) {
+        const call_site_t* site = &tracking->sites[tracking->site_table[i]];
+        if (site_equal(site, file, line, hash)) {
+            return tracking->site_table[i];
+        }
+        i = (i + 1) & mask;
     }
-    return NULL;
+
+    call_site_t site = {
+        .file = file,
+        .line = line,
+        .hash = hash,
+    };
+    const uint32_t idx = (uint32_t)md_array_size(tracking->sites);
+    md_array_push(tracking->sites, site, tracking->arena);
+    tracking->site_table[i] = idx;
+    return idx;
 }
 
-allocation_t* new_allocation(tracking_t* tracking) {
-    allocation_t item = {0};
-    md_array_push(tracking->allocations, item, tracking->arena);
-    return md_array_last(tracking->allocations);
+static void add_to_site(tracking_t* tracking, uint32_t site_idx, size_t size) {
+    call_site_t* site = &tracking->sites[site_idx];
+    site->live_bytes  += size;
+    site->live_count  += 1;
+    site->total_count += 1;
+    site->peak_bytes = MAX(site->peak_bytes, site->live_bytes);
+
+    tracking->live_bytes += size;
+    tracking->peak_bytes = MAX(tracking->peak_bytes, tracking->live_bytes);
 }
 
-void register_deallocation(tracking_t* tracking, allocation_t* alloc) {
-    ASSERT(find_allocation(tracking, alloc->ptr));
-    size_t idx = alloc - tracking->allocations;
-    md_array_swap_back_and_pop(tracking->allocations, idx);
-    //*alloc = *md_array_last(tracking->allocations);
-    //tracking->allocations[idx] = *alloc;
-    //md_array_pop(tracking->allocations);
+static void remove_from_site(tracking_t* tracking, uint32_t site_idx, size_t size) {
+    call_site_t* site = &tracking->sites[site_idx];
+    ASSERT(site->live_bytes >= size && site->live_count > 0);
+    site->live_bytes -= size;
+    site->live_count -= 1;
+
+    tracking->live_bytes -= size;
+}
+
+static void register_allocation(tracking_t* tracking, void* ptr, size_t size, const char* file, size_t line) {
+    // Keep the load factor below 3/4
+    if ((tracking->num_allocations + 1) * 4 > tracking->table_cap * 3) {
+        grow_table(tracking);
+    }
+    allocation_t* slot = &tracking->table[find_slot(tracking, ptr)];
+    ASSERT(slot->ptr == NULL);
+    slot->ptr  = ptr;
+    slot->size = size;
+    slot->site = get_call_site(tracking, file, line);
+    tracking->num_allocations += 1;
+    add_to_site(tracking, slot->site, size);
+}
+
+static void register_deallocation(tracking_t* tracking, allocation_t* alloc) {
+    remove_from_site(tracking, alloc->site, alloc->size);
+
+    // Backward shift deletion: move later entries of the probe sequence into the hole so no tombstones are needed
+    const size_t mask = tracking->table_cap - 1;
+    size_t hole = (size_t)(alloc - tracking->table);
+    size_t i = hole;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (!tracking->table[i].ptr) break;
+        const size_t home = hash_ptr(tracking->table[i].ptr) & mask;
+        // Move the entry if its home slot is not within (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            tracking->table[hole] = tracking->table[i];
+            hole = i;
+        }
+    }
+    tracking->table[hole].ptr = NULL;
+    tracking->num_allocations -= 1;
 }
 
 static void* tracking_realloc(struct md_allocator_o *inst, void *ptr, size_t old_size, size_t new_size, const char* file, size_t line) {
-    (void)file;
-    (void)line;
     tracking_t* tracking = (tracking_t*)inst;
     ASSERT(tracking && tracking->magic == MAGIC_NUMBER);
 
@@ -68,18 +230,21 @@ static void* tracking_realloc(struct md_allocator_o *inst, void *ptr, size_t old
         if (alloc) {
             // Tracked allocation - normal behavior
             ASSERT(alloc->size == old_size);
+            register_deallocation(tracking, alloc);
 
             if (new_size) {
-                // REALLOC
-                alloc->ptr = tracking->backing->realloc(tracking->backing->inst, ptr, old_size, new_size, file, line);
-                alloc->size = new_size;
-                alloc->file = file;
-                alloc->line = line;
-                result = alloc->ptr;
+                // REALLOC, the block is attributed to the call site of the realloc
+                result = tracking->backing->realloc(tracking->backing->inst, ptr, old_size, new_size, file, line);
+                if (result) {
+                    register_allocation(tracking, result, new_size, file, line);
+                } else {
+                    // The old block is still valid
+                    register_allocation(tracking, ptr, old_size, file, line);
+                }
             }
             else {
                 // FREE
-                register_deallocation(tracking, alloc);
+                tracking->backing->realloc(tracking->backing->inst, ptr, old_size, 0, file, line);
                 result = NULL;
             }
         } else {
@@ -88,11 +253,7 @@ static void* tracking_realloc(struct md_allocator_o *inst, void *ptr, size_t old
                 // REALLOC - forward to backing allocator and start tracking
                 result = tracking->backing->realloc(tracking->backing->inst, ptr, old_size, new_size, file, line);
                 if (result) {
-                    allocation_t* new_alloc = new_allocation(tracking);
-                    new_alloc->ptr = result;
-                    new_alloc->size = new_size;
-                    new_alloc->file = file;
-                    new_alloc->line = line;
+                    register_allocation(tracking, result, new_size, file, line);
                 }
             } else {
                 // FREE - forward to backing allocator
@@ -101,12 +262,10 @@ static void* tracking_realloc(struct md_allocator_o *inst, void *ptr, size_t old
         }
     } else if (new_size) {
         // MALLOC
-        allocation_t* alloc = new_allocation(tracking);
-        alloc->ptr = tracking->backing->realloc(tracking->backing->inst, ptr, old_size, new_size, file, line);
-        alloc->size = new_size;
-        alloc->file = file;
-        alloc->line = line;
-        result = alloc->ptr;
+        result = tracking->backing->realloc(tracking->backing->inst, ptr, old_size, new_size, file, line);
+        if (result) {
+            register_allocation(tracking, result, new_size, file, line);
+        }
     }
     md_mutex_unlock(&tracking->mutex);
     return result;
@@ -115,11 +274,12 @@ static void* tracking_realloc(struct md_allocator_o *inst, void *ptr, size_t old
 struct md_allocator_i* md_tracking_allocator_create(struct md_allocator_i* backing) {
     ASSERT(backing);
     tracking_t* inst = (tracking_t*)md_alloc(backing, sizeof(tracking_t) + sizeof(md_allocator_i));
+    MEMSET(inst, 0, sizeof(tracking_t));
     inst->backing = backing;
-    inst->allocations = 0;
     inst->arena = md_vm_arena_create(GIGABYTES(1));
     inst->mutex = md_mutex_create();
     inst->magic = MAGIC_NUMBER;
+    grow_table(inst);
 
     md_allocator_i* alloc = (md_allocator_i*)((char*)inst + sizeof(tracking_t));
     alloc->inst = (md_allocator_o*)inst;
@@ -135,18 +295,34 @@ void md_tracking_allocator_destroy(struct md_allocator_i* alloc) {
     ASSERT(tracking->magic == MAGIC_NUMBER);
 
     md_mutex_lock(&tracking->mutex);
-    size_t size = md_array_size(tracking->allocations);
-    for (size_t i = 0; i < size; ++i) {
-        MD_LOG_DEBUG("Allocation never freed, in file '%s', at line '%i'.", tracking->allocations[i].file, tracking->allocations[i].line);
+    for (size_t i = 0; i < md_array_size(tracking->sites); ++i) {
+        const call_site_t* site = &tracking->sites[i];
+        if (site->live_count) {
+            MD_LOG_DEBUG("%zu allocation(s) (%zu bytes) never freed, in file '%s', at line '%i'.", site->live_count, site->live_bytes, site->file, (int)site->line);
+        }
     }
     md_mutex_unlock(&tracking->mutex);
     md_mutex_destroy(&tracking->mutex);
 
+    if (tracking->table) {
+        md_free(tracking->backing, tracking->table, sizeof(allocation_t) * tracking->table_cap);
+    }
+    if (tracking->site_table) {
+        md_free(tracking->backing, tracking->site_table, sizeof(uint32_t) * tracking->site_table_cap);
+    }
     md_vm_arena_destroy(tracking->arena);
 
     md_free(tracking->backing, tracking, sizeof(tracking_t) + sizeof(md_allocator_i));
 }
 
+static int compare_sites_by_live_bytes(const void* a, const void* b) {
+    const call_site_t* sa = *(const call_site_t* const*)a;
+    const call_site_t* sb = *(const call_site_t* const*)b;
+    if (sa->live_bytes != sb->live_bytes) return sa->live_bytes < sb->live_bytes ? 1 : -1;
+    if (sa->peak_bytes != sb->peak_bytes) return sa->peak_bytes < sb->peak_bytes ? 1 : -1;
+    return 0;
+}
+
 void md_tracking_allocator_print(struct md_allocator_i* alloc) {
     ASSERT(alloc);
     ASSERT(alloc->inst);
@@ -155,13 +331,24 @@ void md_tracking_allocator_print(struct md_allocator_i* alloc) {
 
     md_mutex_lock(&tracking->mutex);
 
+    // Call sites sorted by live bytes, the largest consumers (and likely leaks) come first
+    const size_t num_sites = md_array_size(tracking->sites);
+    const call_site_t** sorted = (const call_site_t**)md_alloc(tracking->backing, sizeof(call_site_t*) * MAX(num_sites, 1));
+    for (size_t i = 0; i < num_sites; ++i) {
+        sorted[i] = &tracking->sites[i];
+    }
+    qsort(sorted, num_sites, sizeof(call_site_t*), compare_sites_by_live_bytes);
+
     MD_LOG_DEBUG("### Beg of Allocated Data ###");
-    size_t size = md_array_size(tracking->allocations);
-    for (size_t i = 0; i < size; ++i) {
-        MD_LOG_DEBUG("'%s':%i", tracking->allocations[i].file, tracking->allocations[i].line);
+    MD_LOG_DEBUG("Live: %zu bytes in %zu allocations, peak: %zu bytes, call sites: %zu", tracking->live_bytes, tracking->num_allocations, tracking->peak_bytes, num_sites);
+    for (size_t i = 0; i < num_sites; ++i) {
+        const call_site_t* site = sorted[i];
+        MD_LOG_DEBUG("'%s':%i live: %zu bytes in %zu allocations, peak: %zu bytes, total allocations: %zu",
+            site->file, (int)site->line, site->live_bytes, site->live_count, site->peak_bytes, site->total_count);
     }
     MD_LOG_DEBUG("### End of Allocated Data ###");
 
+    md_free(tracking->backing, sorted, sizeof(call_site_t*) * MAX(num_sites, 1));
+
     md_mutex_unlock(&tracking->mutex);
 }
-
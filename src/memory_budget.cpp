@@ -0,0 +1,142 @@
+#include "memory_budget.h"
+
+#include <core/md_common.h>
+#include <core/md_allocator.h>
+#include <core/md_log.h>
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+namespace memory_budget {
+
+#define MAX_ALLOCATORS 32
+#define NAME_SIZE 32
+#define HISTORY_LENGTH 256
+
+struct Entry {
+    md_allocator_i  iface;
+    md_allocator_i* backing;
+    char name[NAME_SIZE];
+    std::atomic_int64_t current_bytes;
+    std::atomic_int64_t peak_bytes;
+    std::atomic_int64_t live_allocations;
+    std::atomic_int64_t total_allocations;
+};
+
+static Entry entries[MAX_ALLOCATORS];
+static std::atomic_uint32_t num_entries = 0;
+static std::mutex create_mutex;
+
+static struct {
+    size_t last_frame_bytes;
+    size_t peak_bytes;
+    size_t reserved_bytes;
+    float  history[2 * HISTORY_LENGTH];  // Written twice so that the latest HISTORY_LENGTH samples are always contiguous
+    size_t head;
+    size_t count;
+} frame_arena = {};
+
+static inline void update_peak(std::atomic_int64_t& peak, int64_t value) {
+    int64_t prev = peak.load(std::memory_order_relaxed);
+    while (value > prev && !peak.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+
+static void* counting_realloc(md_allocator_o* inst, void* ptr, size_t old_size, size_t new_size, const char* file, size_t line) {
+    Entry* entry = (Entry*)inst;
+    void* result = entry->backing->realloc(entry->backing->inst, ptr, old_size, new_size, file, line);
+
+    if (new_size == 0) {
+        // FREE
+        if (ptr) {
+            entry->current_bytes.fetch_sub((int64_t)old_size, std::memory_order_relaxed);
+            entry->live_allocations.fetch_sub(1, std::memory_order_relaxed);
+        }
+    } else if (result) {
+        const bool is_new = !ptr || !old_size;
+        const int64_t delta = (int64_t)new_size - (is_new ? 0 : (int64_t)old_size);
+        const int64_t current = entry->current_bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+        update_peak(entry->peak_bytes, current);
+        if (is_new) {
+            entry->live_allocations.fetch_add(1, std::memory_order_relaxed);
+            entry->total_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+md_allocator_i* create_allocator(const char* name, md_allocator_i* backing) {
+    ASSERT(name);
+    ASSERT(backing);
+    std::lock_guard<std::mutex> lock(create_mutex);
+
+    const uint32_t count = num_entries.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (entries[i].backing == backing && strncmp(entries[i].name, name, NAME_SIZE - 1) == 0) {
+            return &entries[i].iface;
+        }
+    }
+
+    if (count == MAX_ALLOCATORS) {
+        MD_LOG_ERROR("Memory budget: Too many allocators, '%s' will not be tracked", name);
+        return backing;
+    }
+
+    Entry* entry = &entries[count];
+    entry->backing = backing;
+    strncpy(entry->name, name, NAME_SIZE - 1);
+    entry->name[NAME_SIZE - 1] = '\0';
+    entry->iface.inst = (md_allocator_o*)entry;
+    entry->iface.realloc = counting_realloc;
+    num_entries.store(count + 1, std::memory_order_release);
+
+    return &entry->iface;
+}
+
+size_t stats(Stats* out_stats, size_t cap) {
+    const uint32_t count = num_entries.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < MIN(cap, (size_t)count); ++i) {
+        const Entry& e = entries[i];
+        out_stats[i] = {
+            .name = e.name,
+            .current_bytes = e.current_bytes.load(std::memory_order_relaxed),
+            .peak_bytes = e.peak_bytes.load(std::memory_order_relaxed),
+            .live_allocations = e.live_allocations.load(std::memory_order_relaxed),
+            .total_allocations = e.total_allocations.load(std::memory_order_relaxed),
+        };
+    }
+    return count;
+}
+
+void record_frame_arena(size_t used_bytes, size_t reserved_bytes) {
+    frame_arena.last_frame_bytes = used_bytes;
+    frame_arena.peak_bytes = MAX(frame_arena.peak_bytes, used_bytes);
+    frame_arena.reserved_bytes = reserved_bytes;
+
+    const float mb = (float)((double)used_bytes / (1024.0 * 1024.0));
+    frame_arena.history[frame_arena.head] = mb;
+    frame_arena.history[frame_arena.head + HISTORY_LENGTH] = mb;
+    frame_arena.head = (frame_arena.head + 1) % HISTORY_LENGTH;
+    frame_arena.count = MIN(frame_arena.count + 1, (size_t)HISTORY_LENGTH);
+}
+
+ArenaStats frame_arena_stats() {
+    const size_t beg = frame_arena.head + HISTORY_LENGTH - frame_arena.count;
+    return {
+        .last_frame_bytes = frame_arena.last_frame_bytes,
+        .peak_bytes = frame_arena.peak_bytes,
+        .reserved_bytes = frame_arena.reserved_bytes,
+        .history = frame_arena.history + beg,
+        .history_len = frame_arena.count,
+    };
+}
+
+void reset_peaks() {
+    const uint32_t count = num_entries.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i) {
+        entries[i].peak_bytes.store(entries[i].current_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    frame_arena.peak_bytes = frame_arena.last_frame_bytes;
+}
+
+}  // namespace memory_budget
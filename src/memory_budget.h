@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_allocator_i;
+
+// Keeps track of how much memory each subsystem holds on to.
+// Subsystems allocate through named counting allocators which forward to a backing allocator and record current and peak bytes.
+namespace memory_budget {
+
+struct Stats {
+    const char* name;
+    int64_t current_bytes;
+    int64_t peak_bytes;
+    int64_t live_allocations;
+    int64_t total_allocations;
+};
+
+struct ArenaStats {
+    size_t last_frame_bytes;    // Bytes in use when the arena was last reset
+    size_t peak_bytes;          // High-water mark since start (or the last reset_peaks)
+    size_t reserved_bytes;
+    const float* history;       // Per-frame usage in MB, oldest first
+    size_t history_len;
+};
+
+// Returns a counting allocator which forwards to backing. Calling this again with the same name and backing returns the same allocator.
+// The allocators live until shutdown, so they are safe to store for the lifetime of the application.
+// Thread-safe, the counters are updated atomically.
+md_allocator_i* create_allocator(const char* name, md_allocator_i* backing);
+
+// Writes up to cap entries (in creation order) and returns the total number of allocators
+size_t stats(Stats* out_stats, size_t cap);
+
+// Call right before the frame arena is reset with the number of bytes it currently holds (Main thread only)
+void record_frame_arena(size_t used_bytes, size_t reserved_bytes);
+ArenaStats frame_arena_stats();
+
+void reset_peaks();
+
+}  // namespace memory_budget
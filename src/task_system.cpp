@@ -11,8 +11,21 @@
 #include <core/md_os.h>
 
 #include <string.h>
+#include <stdio.h>
 #include <atomic_queue.h>
 
+#if MD_PLATFORM_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#elif MD_PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#elif MD_PLATFORM_OSX
+#include <sys/sysctl.h>
+#endif
+
 // Blatantly stolen from ImGui (thanks Omar!)
 struct NewDummy {};
 inline void* operator new(size_t, NewDummy, void* ptr) { return ptr; }
@@ -145,16 +158,187 @@ static inline enki::ICompletable* get_task(ID id) {
 
 static enki::TaskScheduler ts{};
 
-void initialize(size_t num_threads = 0) {
-    ts.Initialize((uint32_t)num_threads);
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        pool::free_slots.push(i);
-        main::free_slots.push(i);
+#define MAX_PROCESSORS 1024
+
+// Logical processors ordered such that the first of every physical core comes before any SMT sibling.
+// Worker threads are pinned in this order, so a pool smaller than the number of logical processors gets one thread per core.
+static struct {
+    bool     detected;
+    uint32_t num_logical;
+    uint32_t num_physical;
+    uint32_t num_order;
+    uint32_t order[MAX_PROCESSORS];
+} topology = {};
+
+static bool pin_threads_enabled = false;
+static bool slots_initialized = false;
+
+#if MD_PLATFORM_LINUX
+static bool read_sys_int(int* value, const char* fmt, uint32_t cpu) {
+    char path[128];
+    snprintf(path, sizeof(path), fmt, cpu);
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    const bool ok = fscanf(file, "%d", value) == 1;
+    fclose(file);
+    return ok;
+}
+#endif
+
+static void detect_topology() {
+    if (topology.detected) return;
+    topology.detected = true;
+    topology.num_logical = (uint32_t)md_os_num_processors();
+
+#if MD_PLATFORM_LINUX
+    // Physical cores are identified by (package, core) pairs, CPUs can be offline, so the indices are not necessarily contiguous
+    uint64_t core_keys[MAX_PROCESSORS];
+    uint32_t secondary[MAX_PROCESSORS];
+    uint32_t num_secondary = 0;
+    uint32_t num_found = 0;
+    for (uint32_t cpu = 0; cpu < MAX_PROCESSORS && num_found < topology.num_logical; ++cpu) {
+        int core = 0, pkg = 0;
+        if (!read_sys_int(&core, "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu)) continue;
+        read_sys_int(&pkg, "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+        num_found += 1;
+
+        const uint64_t key = ((uint64_t)(uint32_t)pkg << 32) | (uint32_t)core;
+        bool seen = false;
+        for (uint32_t i = 0; i < topology.num_physical; ++i) {
+            if (core_keys[i] == key) { seen = true; break; }
+        }
+        if (seen) {
+            secondary[num_secondary++] = cpu;
+        } else {
+            core_keys[topology.num_physical++] = key;
+            topology.order[topology.num_order++] = cpu;
+        }
+    }
+    for (uint32_t i = 0; i < num_secondary; ++i) {
+        topology.order[topology.num_order++] = secondary[i];
+    }
+#elif MD_PLATFORM_WINDOWS
+    auto lowest_bit = [](uint64_t mask) { uint32_t i = 0; while (!(mask & 1)) { mask >>= 1; ++i; } return i; };
+
+    // Only processor group 0 is considered, which covers systems with up to 64 logical processors
+    DWORD len = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &len);
+    if (len > 0) {
+        char* buf = (char*)md_alloc(md_get_heap_allocator(), len);
+        if (GetLogicalProcessorInformationEx(RelationProcessorCore, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buf, &len)) {
+            uint64_t secondary_mask = 0;
+            for (DWORD offset = 0; offset < len;) {
+                const PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buf + offset);
+                offset += info->Size;
+                if (info->Processor.GroupMask[0].Group != 0) continue;
+                uint64_t mask = (uint64_t)info->Processor.GroupMask[0].Mask;
+                if (!mask) continue;
+                const uint32_t first = lowest_bit(mask);
+                topology.order[topology.num_order++] = first;
+                topology.num_physical += 1;
+                secondary_mask |= mask & ~(1ULL << first);
+            }
+            while (secondary_mask && topology.num_order < MAX_PROCESSORS) {
+                const uint32_t cpu = lowest_bit(secondary_mask);
+                topology.order[topology.num_order++] = cpu;
+                secondary_mask &= secondary_mask - 1;
+            }
+        }
+        md_free(md_get_heap_allocator(), buf, len);
+    }
+#elif MD_PLATFORM_OSX
+    // There is no API for hard affinity on macOS, so only the core count is detected
+    int physical = 0;
+    size_t size = sizeof(physical);
+    if (sysctlbyname("hw.physicalcpu", &physical, &size, NULL, 0) == 0 && physical > 0) {
+        topology.num_physical = (uint32_t)physical;
+    }
+#endif
+
+    if (topology.num_physical == 0 || topology.num_physical > topology.num_logical) {
+        topology.num_physical = topology.num_logical;
+    }
+    MD_LOG_DEBUG("Task system: %u physical cores, %u logical processors", topology.num_physical, topology.num_logical);
+}
+
+// Executed on each worker thread as it starts, thread 0 is the main thread and is left unpinned
+static void pin_worker_thread(uint32_t thread_num) {
+    if (!pin_threads_enabled || thread_num == 0 || topology.num_order == 0) return;
+    const uint32_t cpu = topology.order[thread_num % topology.num_order];
+#if MD_PLATFORM_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        MD_LOG_DEBUG("Task system: Failed to pin worker thread %u to processor %u", thread_num, cpu);
+    }
+#elif MD_PLATFORM_WINDOWS
+    if (cpu < 64 && !SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu)) {
+        MD_LOG_DEBUG("Task system: Failed to pin worker thread %u to processor %u", thread_num, cpu);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+static uint32_t clamp_num_threads(size_t num_threads) {
+    detect_topology();
+    if (num_threads == 0) {
+        num_threads = topology.num_physical;
+    }
+    return (uint32_t)CLAMP(num_threads, 2, (size_t)MAX(topology.num_logical, 2));
+}
+
+static void start_scheduler(size_t num_threads, bool pin_threads) {
+    const uint32_t count = clamp_num_threads(num_threads);
+    pin_threads_enabled = pin_threads && topology.num_order > 0;
+    if (pin_threads && !pin_threads_enabled) {
+        MD_LOG_INFO("Task system: Pinning worker threads is not supported on this platform");
+    }
+
+    enki::TaskSchedulerConfig config;
+    config.numTaskThreadsToCreate = count - 1;
+    config.profilerCallbacks.threadStart = pin_worker_thread;
+    ts.Initialize(config);
+    MD_LOG_INFO("Task system: Running with %u threads%s", count, pin_threads_enabled ? " (pinned)" : "");
+}
+
+void initialize(size_t num_threads, bool pin_threads) {
+    start_scheduler(num_threads, pin_threads);
+    if (!slots_initialized) {
+        for (uint32_t i = 0; i < MAX_TASKS; i++) {
+            pool::free_slots.push(i);
+            main::free_slots.push(i);
+        }
+        slots_initialized = true;
     }
 }
 
 void shutdown() { ts.WaitforAllAndShutdown(); }
 
+bool reinitialize(size_t num_threads, bool pin_threads) {
+    ID running[1];
+    if (pool_running_tasks(running, 1) > 0) {
+        MD_LOG_INFO("Task system: Cannot change the number of threads while tasks are running");
+        return false;
+    }
+    ts.WaitforAllAndShutdown();
+    start_scheduler(num_threads, pin_threads);
+    return true;
+}
+
+size_t num_physical_cores() {
+    detect_topology();
+    return topology.num_physical;
+}
+
+size_t num_logical_processors() {
+    detect_topology();
+    return topology.num_logical;
+}
+
+bool pool_threads_pinned() { return pin_threads_enabled; }
+
 ID create_main_task(str_t label, Task func) {
     const uint32_t idx = main::free_slots.pop();
     ID id = generate_id(idx);
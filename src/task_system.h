@@ -19,9 +19,20 @@ using Task      = void (*)(void* user_data);
 using RangeTask = void (*)(uint32_t range_beg, uint32_t range_end, void* user_data, uint32_t thread_num);
 */
 
-void initialize(size_t num_threads);
+// num_threads is the total number of threads including the main thread, 0 means one per physical core.
+// If pin_threads is set, each worker thread is bound to a logical processor, distinct physical cores are handed out before SMT siblings.
+void initialize(size_t num_threads, bool pin_threads = false);
 void shutdown();
 
+// Restarts the pool with a new thread count. This fails (returns false) if any pool task is running.
+// Per-thread data which is sized by pool_num_threads() must not be held across this call.
+bool reinitialize(size_t num_threads, bool pin_threads = false);
+
+// Processor topology of the system, num_physical_cores falls back to the number of logical processors if it cannot be determined
+size_t num_physical_cores();
+size_t num_logical_processors();
+bool   pool_threads_pinned();
+
 // Call once per frame at some approriate time, if there are items in the main queue, the main thread will be stalled.
 // Pool tasks will not stall the main thread.
 //void execute_queued_tasks();
@@ -752,6 +752,8 @@ struct ApplicationState {
     struct {
         bool keep_representations = false;
         bool prefetch_frames = true;
+        int  num_threads = 0;       // Total number of threads in the task pool, 0 means one per physical core
+        bool pin_threads = false;
     } settings;
 
     struct {
@@ -823,22 +825,13 @@ struct ApplicationState {
         // Performance metrics
         double steps_per_second = 0.0;
         double last_update_time = 0.0;
-        
-        // Trajectory frame storage for real-time analysis
-        struct {
-            md_array(float*) stored_x = nullptr;  // Array of x coordinate arrays for each frame
-            md_array(float*) stored_y = nullptr;  // Array of y coordinate arrays for each frame  
-            md_array(float*) stored_z = nullptr;  // Array of z coordinate arrays for each frame
-            md_array(double) frame_times = nullptr;  // Time for each stored frame
-            size_t atom_count = 0;  // Number of atoms per frame
-            int max_frames = 1000;  // Maximum frames to store
-            bool enabled = true;    // Whether to capture frames
-        } trajectory_capture;
+        double upload_time = 0.0;   // s, last position upload to GPU buffers
     } simulation;
 #endif
 
     bool show_script_window = true;
     bool show_debug_window = false;
+    bool show_memory_window = false;
     bool show_property_export_window = false;
 };
 
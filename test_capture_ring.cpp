@@ -0,0 +1,164 @@
+#include <components/openmm/capture_ring.h>
+#include <core/md_allocator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Test for reading an attached simulation trajectory while the simulation keeps capturing
+// The capture ring overwrites its oldest slot and advances its head once it is full, so a view
+// reading the ring directly sees frames shift under it. The view must read from a snapshot
+// taken when it was attached, which stays valid however many frames are captured afterwards.
+// Also checks the attach / detach order: refreshing the view closes the old one before the new snapshot
+// is taken, and a view closed by VIAMD is no longer reported as attached.
+//
+// Build with src on the include path (and mdlib), preferably with -fsanitize=thread or -fsanitize=address
+
+// Fills a frame where every coordinate equals the frame number, so torn or shifted frames are detected
+static void capture(InternalTrajectoryStorage* ring, std::vector<float>& buf, int frame) {
+    for (float& v : buf) v = (float)frame;
+    capture_ring_push(ring, buf.data(), buf.data(), buf.data(), (double)frame);
+}
+
+// Loads frame idx through the md_trajectory_i interface, returns false if it is torn or does not match its timestamp
+static bool load_and_validate(const md_trajectory_i& view, int64_t idx, float* x, float* y, float* z, size_t atom_count) {
+    md_trajectory_frame_header_t header;
+    if (!view.load_frame(view.inst, idx, &header, x, y, z)) {
+        return false;
+    }
+    const float expected = (float)header.timestamp;
+    for (size_t i = 0; i < atom_count; ++i) {
+        if (x[i] != expected || y[i] != expected || z[i] != expected) {
+            return false;
+        }
+    }
+    return header.index == idx;
+}
+
+int main() {
+    printf("Testing reads from an attached trajectory while frames are captured...\n");
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    const size_t atom_count = 4096;
+    const size_t capacity   = 64;
+    const int    num_readers = 4;
+    const int    frames_after_attach = 2000;
+    bool success = true;
+
+    InternalTrajectoryStorage ring;
+    capture_ring_allocate(&ring, atom_count, capacity, alloc);
+    std::vector<float> frame_buf(atom_count);
+
+    // Stands in for VIAMD: the view it holds, which is closed (and the snapshot released through the loader) when asked to
+    md_trajectory_i viamd_view = {};
+    int num_closed = 0;
+    auto close_view = [&]() {
+        capture_traj_destroy(&viamd_view);
+        viamd_view = {};
+        num_closed += 1;
+    };
+
+    // Fill the ring past capacity so the head has already moved when the view is attached
+    int frame = 0;
+    for (; frame < (int)capacity + (int)capacity / 2; ++frame) {
+        capture(&ring, frame_buf, frame);
+    }
+
+    if (!capture_ring_attach(&ring, alloc, close_view) || num_closed != 0) {
+        printf("✗ Attaching the first view failed\n");
+        return 1;
+    }
+    viamd_view = ring.view;
+
+    md_trajectory_header_t traj_header;
+    viamd_view.get_header(viamd_view.inst, &traj_header);
+    const int64_t num_frames = traj_header.num_frames;
+    const double first_time = traj_header.frame_times[0];
+
+    std::atomic_bool done = false;
+    std::atomic_int  errors = 0;
+    std::atomic_int  reads = 0;
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&, r]() {
+            std::vector<float> x(atom_count), y(atom_count), z(atom_count);
+            do {
+                for (int64_t i = 0; i < num_frames; ++i) {
+                    const int64_t idx = (i + r) % num_frames;
+                    // Index i must keep referring to the same frame for as long as the view is attached
+                    if (traj_header.frame_times[idx] != first_time + (double)idx ||
+                        !load_and_validate(viamd_view, idx, x.data(), y.data(), z.data(), atom_count)) {
+                        errors += 1;
+                    }
+                    reads += 1;
+                }
+            } while (!done.load());
+        });
+    }
+
+    // The simulation keeps capturing, overwriting every slot of the ring many times over
+    for (int i = 0; i < frames_after_attach; ++i, ++frame) {
+        capture(&ring, frame_buf, frame);
+    }
+    done = true;
+
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    if (num_frames != (int64_t)capacity) {
+        printf("✗ Snapshot holds %lld frames, expected %zu\n", (long long)num_frames, capacity);
+        success = false;
+    }
+    if (errors.load() != 0) {
+        printf("✗ %d of %d frame reads were inconsistent\n", errors.load(), reads.load());
+        success = false;
+    }
+    if (ring.frame_time(0) != (double)(frame - (int)capacity)) {
+        printf("✗ Ring does not hold the most recent frames after capturing\n");
+        success = false;
+    }
+
+    // Refreshing closes the old view first, the new snapshot must survive that and hold the latest frames
+    capture_ring_attach(&ring, alloc, close_view);
+    viamd_view = ring.view;
+    viamd_view.get_header(viamd_view.inst, &traj_header);
+    if (num_closed != 1 || !ring.view_attached() || traj_header.num_frames != (int64_t)capacity ||
+        traj_header.frame_times[0] != (double)(frame - (int)capacity)) {
+        printf("✗ Refreshing the view did not replace the old snapshot with the latest frames\n");
+        success = false;
+    }
+    {
+        std::vector<float> x(atom_count), y(atom_count), z(atom_count);
+        if (!load_and_validate(viamd_view, capacity - 1, x.data(), y.data(), z.data(), atom_count) || x[0] != (float)(frame - 1)) {
+            printf("✗ The refreshed view does not end with the most recent frame\n");
+            success = false;
+        }
+    }
+
+    // VIAMD closes the view on its own (e.g. another trajectory is loaded)
+    capture_traj_destroy(&viamd_view);
+    if (ring.view_attached()) {
+        printf("✗ The view is still reported as attached after VIAMD closed it\n");
+        success = false;
+    }
+    capture_ring_detach(&ring, close_view);
+    if (num_closed != 1) {
+        printf("✗ A view which was already closed was closed again\n");
+        success = false;
+    }
+
+    printf("%d frame reads while capturing %d frames\n", reads.load(), frames_after_attach);
+
+    capture_ring_free(&ring, alloc);
+
+    if (success) {
+        printf("✓ Attached trajectory frames stay consistent while the simulation captures\n");
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,124 @@
+#include <components/correlation/correlation_stats.h>
+#include <core/md_allocator.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+
+// Checks for the correlation statistics with non-finite samples
+// Property series can contain NaN and Inf (e.g. undefined dihedrals), which must neither poison the coefficients
+// nor reach std::sort inside the rank computation. The statistics of a series with such samples must match those of
+// the same series with the samples removed.
+//
+// Build with src on the include path (and mdlib), preferably with -fsanitize=address,undefined
+
+static bool near(double a, double b, double eps = 1.0e-5) {
+    return fabs(a - b) <= eps;
+}
+
+int main() {
+    printf("Testing correlation statistics with non-finite samples...\n");
+
+    md_allocator_i* alloc = md_get_heap_allocator();
+    bool success = true;
+
+    const size_t n = 4096;
+    std::vector<float> x(n), y(n);
+    std::vector<float> ref_x, ref_y;
+    size_t num_bad = 0;
+    for (size_t i = 0; i < n; ++i) {
+        // Monotonic but nonlinear relation, so Pearson < 1 while Spearman == 1
+        x[i] = (float)i * 0.01f;
+        y[i] = x[i] * x[i] * x[i];
+        if (i % 7 == 3) {
+            x[i] = NAN;
+        } else if (i % 11 == 5) {
+            y[i] = INFINITY;
+        } else if (i % 13 == 6) {
+            x[i] = -INFINITY;
+        }
+        if (isfinite(x[i]) && isfinite(y[i])) {
+            ref_x.push_back(x[i]);
+            ref_y.push_back(y[i]);
+        } else {
+            num_bad += 1;
+        }
+    }
+
+    std::vector<float> pairs(2 * n);
+    const size_t count = compact_finite_pairs(pairs.data(), pairs.data() + n, x.data(), y.data(), n);
+    if (count != ref_x.size() || count + num_bad != n) {
+        printf("✗ Compaction kept %zu pairs, expected %zu\n", count, ref_x.size());
+        success = false;
+    }
+
+    const double pearson     = pearson_correlation(pairs.data(), pairs.data() + n, count);
+    const double pearson_ref = pearson_correlation(ref_x.data(), ref_y.data(), ref_x.size());
+    if (!isfinite(pearson) || !near(pearson, pearson_ref) || pearson >= 1.0) {
+        printf("✗ Pearson %f, expected %f\n", pearson, pearson_ref);
+        success = false;
+    }
+
+    const double spearman = spearman_correlation(pairs.data(), pairs.data() + n, count, alloc);
+    if (!near(spearman, 1.0)) {
+        printf("✗ Spearman %f, expected 1\n", spearman);
+        success = false;
+    }
+
+    // Ranks of the compacted values must be a permutation of 1..count
+    {
+        std::vector<float> ranks(count);
+        std::vector<uint32_t> tmp(count);
+        compute_ranks(ranks.data(), pairs.data(), tmp.data(), count);
+        std::vector<int> seen(count + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            const int r = (int)ranks[i];
+            if (r < 1 || r > (int)count || (float)r != ranks[i] || seen[r]++) {
+                printf("✗ Invalid rank %f at %zu\n", ranks[i], i);
+                success = false;
+                break;
+            }
+        }
+    }
+
+    // Cross-correlation of a series with itself peaks at lag 0 with a value of 1, missing frames must not shift the lags
+    {
+        const size_t max_lag = 32;
+        std::vector<float> lag(2 * max_lag + 1);
+        cross_correlation_fft(lag.data(), x.data(), x.data(), n, max_lag, alloc);
+        for (size_t i = 0; i < lag.size(); ++i) {
+            if (!isfinite(lag[i]) || lag[i] > lag[max_lag] + 1.0e-5f) {
+                printf("✗ Cross-correlation at lag %d is %f, peak is %f\n", (int)i - (int)max_lag, lag[i], lag[max_lag]);
+                success = false;
+                break;
+            }
+        }
+        if (!near(lag[max_lag], 1.0, 1.0e-4)) {
+            printf("✗ Cross-correlation at lag 0 is %f, expected 1\n", lag[max_lag]);
+            success = false;
+        }
+    }
+
+    // Series without any finite pair yield zeros rather than NaN
+    {
+        std::vector<float> bad(n, NAN);
+        const size_t c = compact_finite_pairs(pairs.data(), pairs.data() + n, bad.data(), y.data(), n);
+        std::vector<float> lag(9, -1.0f);
+        cross_correlation_fft(lag.data(), bad.data(), y.data(), n, 4, alloc);
+        bool zero = true;
+        for (float v : lag) zero &= (v == 0.0f);
+        if (c != 0 || pearson_correlation(pairs.data(), pairs.data() + n, c) != 0.0 || spearman_correlation(pairs.data(), pairs.data() + n, c, alloc) != 0.0 || !zero) {
+            printf("✗ All non-finite series did not yield zero statistics\n");
+            success = false;
+        }
+    }
+
+    printf("%zu of %zu samples non-finite, Pearson %.4f, Spearman %.4f\n", num_bad, n, pearson, spearman);
+
+    if (success) {
+        printf("✓ Non-finite samples are excluded from the correlation statistics\n");
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,125 @@
+#include <event.h>
+#include <core/md_os.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// Checks for type-subscribed event dispatch
+// Handlers subscribed to a list of types must only see those types, handlers registered without types see everything,
+// and events arrive in the order they were sent. Also measures broadcast cost with many uninterested handlers.
+//
+// Build together with src/event.cpp (and mdlib, atomic_queue on the include path)
+
+static const viamd::EventType EventType_TestA = HASH_STR_LIT("Test Dispatch A");
+static const viamd::EventType EventType_TestB = HASH_STR_LIT("Test Dispatch B");
+static const viamd::EventType EventType_TestC = HASH_STR_LIT("Test Dispatch C");	// Never subscribed to explicitly
+
+struct RecordingHandler : viamd::EventHandler {
+    std::vector<viamd::EventType> types;
+    std::vector<uintptr_t> ids;
+
+    void process_events(const viamd::Event* events, size_t num_events) final {
+        for (size_t i = 0; i < num_events; ++i) {
+            types.push_back(events[i].type);
+            ids.push_back((uintptr_t)events[i].payload);
+        }
+    }
+};
+
+static bool only_contains(const RecordingHandler& h, viamd::EventType type) {
+    for (viamd::EventType t : h.types) {
+        if (t != type) return false;
+    }
+    return true;
+}
+
+static bool in_order(const RecordingHandler& h) {
+    for (size_t i = 1; i < h.ids.size(); ++i) {
+        if (h.ids[i] <= h.ids[i - 1]) return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    RecordingHandler handler_a, handler_b, handler_ab, handler_all;
+    viamd::event_system_register_handler(handler_a,  {EventType_TestA}, "A");
+    viamd::event_system_register_handler(handler_b,  {EventType_TestB}, "B");
+    viamd::event_system_register_handler(handler_ab, {EventType_TestA, EventType_TestB, EventType_TestA}, "AB");
+    viamd::event_system_register_handler(handler_all);
+
+    const size_t num_events = 300;
+    for (size_t i = 0; i < num_events; ++i) {
+        const viamd::EventType type = (i % 3 == 0) ? EventType_TestA : (i % 3 == 1) ? EventType_TestB : EventType_TestC;
+        viamd::event_system_enqueue_event(type, viamd::EventPayloadType_Undefined, (const void*)(uintptr_t)i);
+    }
+    viamd::event_system_process_event_queue();
+    viamd::event_system_broadcast_event(EventType_TestA, viamd::EventPayloadType_Undefined, (const void*)(uintptr_t)num_events);
+
+    if (handler_a.types.size() != num_events / 3 + 1 || !only_contains(handler_a, EventType_TestA) || !in_order(handler_a)) {
+        printf("✗ Handler subscribed to A received %zu events\n", handler_a.types.size());
+        ok = false;
+    }
+    if (handler_b.types.size() != num_events / 3 || !only_contains(handler_b, EventType_TestB) || !in_order(handler_b)) {
+        printf("✗ Handler subscribed to B received %zu events\n", handler_b.types.size());
+        ok = false;
+    }
+    if (handler_ab.types.size() != 2 * num_events / 3 + 1 || !in_order(handler_ab)) {
+        printf("✗ Handler subscribed to A and B received %zu events (duplicate subscriptions must not duplicate events)\n", handler_ab.types.size());
+        ok = false;
+    }
+    if (handler_all.types.size() != num_events + 1 || !in_order(handler_all)) {
+        printf("✗ Handler subscribed to all types received %zu events\n", handler_all.types.size());
+        ok = false;
+    }
+
+    viamd::EventHandlerStats stats[8];
+    size_t num_handlers = viamd::event_system_handler_stats(stats, 8);
+    if (num_handlers != 4 || stats[0].num_subscribed_types != 1 || stats[2].num_subscribed_types != 2 || stats[3].num_subscribed_types != 0 ||
+        stats[0].num_calls != 2 || stats[0].num_events != num_events / 3 + 1 || stats[3].num_events != num_events + 1) {
+        printf("✗ Handler statistics do not match the dispatched events\n");
+        ok = false;
+    }
+
+    // Broadcast cost with many handlers which are not interested in the event
+    static RecordingHandler others[256];
+    static const viamd::EventType EventType_TestOther = HASH_STR_LIT("Test Dispatch Other");
+    for (size_t i = 0; i < 256; ++i) {
+        viamd::event_system_register_handler(others[i], {EventType_TestOther}, "Other");
+    }
+    RecordingHandler* subscribed_b[] = {&handler_b, &handler_ab, &handler_all};
+    const size_t num_subscribed_b = sizeof(subscribed_b) / sizeof(subscribed_b[0]);
+    const size_t num_total_handlers = 4 + 256;
+    size_t received_before = 0;
+    for (const RecordingHandler* h : subscribed_b) received_before += h->types.size();
+
+    const size_t num_broadcasts = 100000;
+    md_timestamp_t t0 = md_time_current();
+    for (size_t i = 0; i < num_broadcasts; ++i) {
+        viamd::event_system_broadcast_event(EventType_TestB);
+    }
+    md_timestamp_t t1 = md_time_current();
+    printf("Broadcast with %zu of %zu handlers subscribed: %.3f us\n", num_subscribed_b, num_total_handlers, md_time_as_seconds(t1 - t0) * 1.0e6 / num_broadcasts);
+
+    size_t received_after = 0;
+    for (const RecordingHandler* h : subscribed_b) received_after += h->types.size();
+    if (received_after - received_before != num_subscribed_b * num_broadcasts) {
+        printf("✗ Subscribed handlers received %zu of %zu broadcasts\n", received_after - received_before, num_subscribed_b * num_broadcasts);
+        ok = false;
+    }
+
+    size_t received_others = 0;
+    for (const RecordingHandler& h : others) received_others += h.types.size();
+    if (received_others != 0) {
+        printf("✗ Unsubscribed handlers received %zu broadcasts\n", received_others);
+        ok = false;
+    }
+
+    if (ok) {
+        printf("✓ Events are only dispatched to subscribed handlers\n");
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,78 @@
+#include <event.h>
+#include <task_system.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Stress test for the multi-producer event queue
+// Every pool thread enqueues events concurrently while the main thread keeps processing the queue.
+// The total number of events exceeds the capacity of the lock-free queue, so the overflow path is exercised as well.
+// Each event carries a unique (producer, sequence) id as payload, which must be delivered exactly once.
+//
+// Build together with src/event.cpp and src/task_system.cpp (and mdlib, enkiTS, atomic_queue on the include path)
+
+static const viamd::EventType EventType_Test = HASH_STR_LIT("Test Event Queue Stress");
+
+static const uint32_t NUM_EVENTS_PER_PRODUCER = 20000;
+
+struct CountingHandler : viamd::EventHandler {
+    std::vector<uint8_t> seen;
+    size_t received = 0;
+    size_t duplicates = 0;
+
+    void process_events(const viamd::Event* events, size_t num_events) final {
+        for (size_t i = 0; i < num_events; ++i) {
+            if (events[i].type != EventType_Test) continue;
+            const uintptr_t id = (uintptr_t)events[i].payload;
+            if (id >= seen.size()) continue;
+            if (seen[id]) duplicates += 1;
+            seen[id] = 1;
+            received += 1;
+        }
+    }
+};
+
+int main() {
+    task_system::initialize(0);
+    const uint32_t num_producers = (uint32_t)task_system::pool_num_threads();
+    const size_t total = (size_t)num_producers * NUM_EVENTS_PER_PRODUCER;
+
+    CountingHandler handler;
+    handler.seen.resize(total, 0);
+    viamd::event_system_register_handler(handler);
+
+    printf("Enqueueing %zu events from %u pool threads...\n", total, num_producers);
+
+    task_system::ID id = task_system::create_pool_task(STR_LIT("Event Producers"), num_producers, [](uint32_t beg, uint32_t end, uint32_t) {
+        for (uint32_t p = beg; p < end; ++p) {
+            for (uint32_t i = 0; i < NUM_EVENTS_PER_PRODUCER; ++i) {
+                const uintptr_t id = (uintptr_t)p * NUM_EVENTS_PER_PRODUCER + i;
+                viamd::event_system_enqueue_event(EventType_Test, viamd::EventPayloadType_Undefined, (const void*)id);
+            }
+        }
+    });
+    task_system::enqueue_task(id);
+
+    // Consume concurrently with the producers
+    while (task_system::task_is_running(id)) {
+        viamd::event_system_process_event_queue();
+    }
+    viamd::event_system_process_event_queue();
+
+    task_system::shutdown();
+
+    size_t missing = 0;
+    for (size_t i = 0; i < total; ++i) {
+        missing += handler.seen[i] ? 0 : 1;
+    }
+
+    if (handler.received == total && missing == 0 && handler.duplicates == 0) {
+        printf("✓ All %zu events delivered exactly once\n", total);
+        return 0;
+    }
+
+    printf("✗ Received %zu of %zu events (%zu missing, %zu duplicates)\n", handler.received, total, missing, handler.duplicates);
+    return 1;
+}
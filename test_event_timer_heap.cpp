@@ -0,0 +1,147 @@
+#include <event.h>
+#include <core/md_os.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Benchmark and ordering checks for delayed events in the event queue
+// 10k delayed events are kept pending while the queue is processed every "frame".
+// The cost per frame is compared against the previous approach, which sorted the whole queue on every call.
+//
+// Build together with src/event.cpp (and mdlib, atomic_queue on the include path)
+
+static const viamd::EventType EventType_TestDelayed = HASH_STR_LIT("Test Delayed Event");
+static const viamd::EventType EventType_TestNow     = HASH_STR_LIT("Test Immediate Event");
+
+static const size_t NUM_PENDING_EVENTS = 10000;
+static const size_t NUM_FRAMES = 1000;
+
+struct RecordingHandler : viamd::EventHandler {
+    std::vector<uintptr_t> ids;
+    size_t delayed = 0;
+
+    void process_events(const viamd::Event* events, size_t num_events) final {
+        for (size_t i = 0; i < num_events; ++i) {
+            if (events[i].type == EventType_TestNow) {
+                ids.push_back((uintptr_t)events[i].payload);
+            } else if (events[i].type == EventType_TestDelayed) {
+                delayed += 1;
+            }
+        }
+    }
+};
+
+// The previous implementation: sort the whole queue, scan for due events and compact the remainder
+static size_t reference_sort_per_frame(std::vector<viamd::Event>& queue, uint64_t time_now) {
+    std::sort(queue.begin(), queue.end(), [](const viamd::Event& a, const viamd::Event& b) {
+        return a.timestamp < b.timestamp;
+    });
+    size_t num_due = 0;
+    while (num_due < queue.size() && queue[num_due].timestamp <= time_now) {
+        num_due += 1;
+    }
+    queue.erase(queue.begin(), queue.begin() + num_due);
+    return num_due;
+}
+
+int main() {
+    RecordingHandler handler;
+    viamd::event_system_register_handler(handler);
+
+    bool ok = true;
+
+    // Delays spread between 10 and 60 minutes, none of them will be due while the benchmark runs
+    for (size_t i = 0; i < NUM_PENDING_EVENTS; ++i) {
+        const uint64_t delay_in_ms = 600000 + (i * 7919) % 3000000;
+        viamd::event_system_enqueue_event(EventType_TestDelayed, viamd::EventPayloadType_Undefined, (const void*)(uintptr_t)i, delay_in_ms);
+    }
+
+    // First call moves the events into the heap
+    md_timestamp_t t0 = md_time_current();
+    viamd::event_system_process_event_queue();
+    md_timestamp_t t1 = md_time_current();
+    printf("Inserted %zu delayed events: %.3f ms\n", NUM_PENDING_EVENTS, md_time_as_seconds(t1 - t0) * 1000.0);
+
+    if (viamd::event_system_num_pending_events() != NUM_PENDING_EVENTS || handler.delayed != 0) {
+        printf("✗ Delayed events were dispatched early (%zu pending, %zu dispatched)\n", viamd::event_system_num_pending_events(), handler.delayed);
+        ok = false;
+    }
+
+    // Idle frames with 10k pending events
+    t0 = md_time_current();
+    for (size_t i = 0; i < NUM_FRAMES; ++i) {
+        viamd::event_system_process_event_queue();
+    }
+    t1 = md_time_current();
+    const double heap_us = md_time_as_seconds(t1 - t0) * 1.0e6 / NUM_FRAMES;
+
+    std::vector<viamd::Event> reference;
+    const uint64_t now = (uint64_t)md_time_current();
+    for (size_t i = 0; i < NUM_PENDING_EVENTS; ++i) {
+        reference.push_back({EventType_TestDelayed, viamd::EventPayloadType_Undefined, now + 1000000000000ULL + (i * 7919) % NUM_PENDING_EVENTS, (const void*)(uintptr_t)i});
+    }
+    // Shuffle the order each frame, as new events arriving would do
+    t0 = md_time_current();
+    size_t ref_due = 0;
+    for (size_t i = 0; i < NUM_FRAMES; ++i) {
+        std::swap(reference[i % reference.size()], reference[(i * 104729) % reference.size()]);
+        ref_due += reference_sort_per_frame(reference, (uint64_t)md_time_current());
+    }
+    t1 = md_time_current();
+    const double sort_us = md_time_as_seconds(t1 - t0) * 1.0e6 / NUM_FRAMES;
+
+    printf("Idle frame with %zu pending events: heap %.3f us, sort per frame %.3f us\n", NUM_PENDING_EVENTS, heap_us, sort_us);
+
+    if (ref_due != 0) {
+        printf("✗ Reference queue dispatched events early\n");
+        ok = false;
+    }
+
+    // Immediate events are dispatched on the next call, in the order they were enqueued, while the delayed ones stay pending
+    const size_t num_immediate = 1000;
+    for (size_t i = 0; i < num_immediate; ++i) {
+        viamd::event_system_enqueue_event(EventType_TestNow, viamd::EventPayloadType_Undefined, (const void*)(uintptr_t)i);
+    }
+    t0 = md_time_current();
+    viamd::event_system_process_event_queue();
+    t1 = md_time_current();
+    printf("Dispatched %zu due events among %zu pending: %.3f ms\n", num_immediate, NUM_PENDING_EVENTS, md_time_as_seconds(t1 - t0) * 1000.0);
+
+    bool in_order = handler.ids.size() == num_immediate;
+    for (size_t i = 0; in_order && i < num_immediate; ++i) {
+        in_order = handler.ids[i] == i;
+    }
+    if (!in_order) {
+        printf("✗ Immediate events were not dispatched in enqueue order (%zu received)\n", handler.ids.size());
+        ok = false;
+    }
+    if (viamd::event_system_num_pending_events() != NUM_PENDING_EVENTS || handler.delayed != 0) {
+        printf("✗ Delayed events were affected by processing due events\n");
+        ok = false;
+    }
+
+    // A short delay must be honored in milliseconds, not in raw timer ticks
+    viamd::event_system_enqueue_event(EventType_TestNow, viamd::EventPayloadType_Undefined, (const void*)(uintptr_t)num_immediate, 50);
+    t0 = md_time_current();
+    viamd::event_system_process_event_queue();
+    if (handler.ids.size() != num_immediate) {
+        printf("✗ Event with a 50 ms delay was dispatched immediately\n");
+        ok = false;
+    }
+    while (handler.ids.size() == num_immediate && md_time_as_seconds(md_time_current() - t0) < 1.0) {
+        viamd::event_system_process_event_queue();
+    }
+    const double waited_ms = md_time_as_seconds(md_time_current() - t0) * 1000.0;
+    if (handler.ids.size() != num_immediate + 1 || waited_ms < 50.0) {
+        printf("✗ Event with a 50 ms delay was dispatched after %.3f ms\n", waited_ms);
+        ok = false;
+    }
+
+    if (ok) {
+        printf("✓ Delayed events are scheduled correctly\n");
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,187 @@
+#include <large_pages.h>
+#include <core/md_allocator.h>
+#include <core/md_os.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+// Checks and throughput measurement for the large page allocator
+// Verifies that blocks keep their contents when reallocated across the size threshold and that the mapped byte count returns to zero.
+// Then a frame cache sized slab is filled and read back, once with the regular heap and once per large page configuration:
+//   fill:       every frame is written once, as when decoding into the cache, this is where page faults occur
+//   playback:   frames are copied out in a random order, as when scrubbing the timeline
+//   evaluation: a scattered selection of atoms is gathered from every frame, as when evaluating a property
+//
+// Build together with src/large_pages.cpp and src/task_system.cpp (and mdlib, enkiTS, atomic_queue on the include path)
+// The slab size in MB can be given as the first argument (default 1024)
+
+static const size_t NUM_ATOMS = 100000;
+static const size_t FRAME_FLOATS = NUM_ATOMS * 3;
+
+static bool check_realloc(md_allocator_i* alloc) {
+    bool ok = true;
+    const size_t small = 1024;
+    const size_t large = 8 * 1024 * 1024;
+
+    // Grow from the backing allocator into a mapped block and back again
+    uint32_t* ptr = (uint32_t*)md_alloc(alloc, small);
+    for (size_t i = 0; i < small / sizeof(uint32_t); ++i) ptr[i] = (uint32_t)i;
+    ptr = (uint32_t*)alloc->realloc(alloc->inst, ptr, small, large, __FILE__, __LINE__);
+    for (size_t i = 0; i < small / sizeof(uint32_t); ++i) {
+        if (ptr[i] != (uint32_t)i) { ok = false; break; }
+    }
+    // The block header sits at the start of the mapping, which has to be 2 MB aligned to be backed by huge pages
+    const uintptr_t huge_page = 2 * 1024 * 1024;
+    if (((uintptr_t)ptr & (huge_page - 1)) > 64) {
+        printf("✗ Mapped block at %p is not 2 MB aligned\n", (void*)ptr);
+        ok = false;
+    }
+    for (size_t i = 0; i < large / sizeof(uint32_t); ++i) ptr[i] = (uint32_t)i;
+    ptr = (uint32_t*)alloc->realloc(alloc->inst, ptr, large, 2 * large, __FILE__, __LINE__);
+    for (size_t i = 0; i < large / sizeof(uint32_t); ++i) {
+        if (ptr[i] != (uint32_t)i) { ok = false; break; }
+    }
+    ptr = (uint32_t*)alloc->realloc(alloc->inst, ptr, 2 * large, small, __FILE__, __LINE__);
+    for (size_t i = 0; i < small / sizeof(uint32_t); ++i) {
+        if (ptr[i] != (uint32_t)i) { ok = false; break; }
+    }
+    if (!ok) printf("✗ Contents were not preserved when reallocating across the threshold\n");
+
+    if (large_pages::stats().mapped_blocks != 0) {
+        printf("✗ A small block is still mapped after shrinking\n");
+        ok = false;
+    }
+    md_free(alloc, ptr, small);
+
+    // Mapped blocks are identified by their pointer, so callers which do not pass the old size still reach the mapped path
+    ptr = (uint32_t*)md_alloc(alloc, large);
+    for (size_t i = 0; i < large / sizeof(uint32_t); ++i) ptr[i] = (uint32_t)i;
+    ptr = (uint32_t*)alloc->realloc(alloc->inst, ptr, 0, 2 * large, __FILE__, __LINE__);
+    for (size_t i = 0; i < large / sizeof(uint32_t); ++i) {
+        if (ptr[i] != (uint32_t)i) {
+            printf("✗ Contents were not preserved when reallocating a mapped block without its size\n");
+            ok = false;
+            break;
+        }
+    }
+    if (large_pages::stats().mapped_blocks != 1) {
+        printf("✗ %lld blocks mapped after reallocating a mapped block without its size, expected 1\n", (long long)large_pages::stats().mapped_blocks);
+        ok = false;
+    }
+    md_free(alloc, ptr, 0);
+    if (large_pages::stats().mapped_blocks != 0 || large_pages::stats().mapped_bytes != 0) {
+        printf("✗ A mapped block freed without its size was not unmapped\n");
+        ok = false;
+    }
+    return ok;
+}
+
+static double seconds_since(md_timestamp_t t0) {
+    return md_time_as_seconds(md_time_current() - t0);
+}
+
+struct Result {
+    double alloc_s;
+    double fill_s;
+    double playback_s;
+    double eval_s;
+};
+
+static Result measure(md_allocator_i* alloc, size_t slab_bytes) {
+    Result res = {};
+    const size_t num_frames = slab_bytes / (FRAME_FLOATS * sizeof(float));
+    const size_t bytes = num_frames * FRAME_FLOATS * sizeof(float);
+
+    md_timestamp_t t0 = md_time_current();
+    float* slab = (float*)md_alloc(alloc, bytes);
+    res.alloc_s = seconds_since(t0);
+
+    // Decoding frames into the cache, this is where page faults occur unless the slab was prefaulted
+    t0 = md_time_current();
+    for (size_t i = 0; i < num_frames * FRAME_FLOATS; ++i) {
+        slab[i] = (float)(i & 1023);
+    }
+    res.fill_s = seconds_since(t0);
+
+    float* out = (float*)malloc(FRAME_FLOATS * sizeof(float));
+    const size_t num_reads = 4 * num_frames;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    double sum = 0;
+    t0 = md_time_current();
+    for (size_t i = 0; i < num_reads; ++i) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        const size_t frame = (size_t)(rng % num_frames);
+        memcpy(out, slab + frame * FRAME_FLOATS, FRAME_FLOATS * sizeof(float));
+        sum += out[rng % FRAME_FLOATS];
+    }
+    res.playback_s = seconds_since(t0) / 4;
+
+    // A selection of 10% of the atoms scattered over the system is gathered from every frame
+    const size_t num_sel = NUM_ATOMS / 10;
+    uint32_t* sel = (uint32_t*)malloc(num_sel * sizeof(uint32_t));
+    for (size_t i = 0; i < num_sel; ++i) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        sel[i] = (uint32_t)(rng % NUM_ATOMS);
+    }
+    t0 = md_time_current();
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+        const float* x = slab + frame * FRAME_FLOATS;
+        const float* y = x + NUM_ATOMS;
+        const float* z = y + NUM_ATOMS;
+        for (size_t i = 0; i < num_sel; ++i) {
+            sum += x[sel[i]] + y[sel[i]] + z[sel[i]];
+        }
+    }
+    res.eval_s = seconds_since(t0) * (double)NUM_ATOMS / (double)num_sel;  // Normalized to the full frame size
+
+    free(sel);
+    free(out);
+    md_free(alloc, slab, bytes);
+    if (sum == 1.0) printf(" ");  // Keep the reduction alive
+    return res;
+}
+
+static void print_result(const char* label, const Result& res, size_t slab_bytes) {
+    const double gb = (double)slab_bytes / (1024.0 * 1024.0 * 1024.0);
+    printf("%-28s alloc %6.3f s | fill %6.2f GB/s | playback %6.2f GB/s | evaluation %6.2f GB/s\n", label,
+        res.alloc_s, gb / res.fill_s, gb / res.playback_s, gb / res.eval_s);
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    const size_t slab_bytes = (size_t)(argc > 1 ? atoi(argv[1]) : 1024) * 1024 * 1024;
+
+    // The configuration is global, so every mode is measured with all blocks of the previous mode freed
+    large_pages::Config config = {};
+    config.mode = large_pages::Mode_Transparent;
+    large_pages::configure(config);
+    md_allocator_i* alloc = large_pages::create_allocator(md_get_heap_allocator());
+    ok &= check_realloc(alloc);
+
+    printf("Slab of %zu MB, frames of %zu atoms\n", slab_bytes / (1024 * 1024), NUM_ATOMS);
+    print_result("Heap", measure(md_get_heap_allocator(), slab_bytes), slab_bytes);
+
+    print_result("Transparent huge pages", measure(alloc, slab_bytes), slab_bytes);
+
+    config.prefault = true;
+    large_pages::configure(config);
+    print_result("Transparent + prefault", measure(alloc, slab_bytes), slab_bytes);
+
+    config.mode = large_pages::Mode_Explicit;
+    config.numa_interleave = true;
+    large_pages::configure(config);
+    print_result("Explicit + NUMA interleave", measure(alloc, slab_bytes), slab_bytes);
+
+    if (large_pages::stats().mapped_bytes != 0) {
+        printf("✗ %lld bytes are still mapped\n", (long long)large_pages::stats().mapped_bytes);
+        ok = false;
+    }
+
+    if (ok) {
+        printf("✓ Large page allocations keep their contents and are released\n");
+        return 0;
+    }
+    return 1;
+}